@@ -0,0 +1,6 @@
+// per-draw data, streamed through a ring buffer (see stream_buffer.h)
+layout (std140) uniform PerDraw
+{
+    mat4 model;
+    vec4 uvRect;    // where this draw's image sits in the atlas: scale xy, offset zw
+};
@@ -3,16 +3,25 @@ out vec4 FragColor;
 
 in vec3 ourColor;
 in vec2 TexCoord;
+in vec2 AtlasCoord;
+flat in float Layer;
 
 uniform float mixValue;
 
 // texture samplers
-uniform sampler2D texture1;
-uniform sampler2D texture2;
+uniform sampler2DArray texture1;    // box textures, one per layer
+uniform sampler2D texture2;         // atlas page
+
+// NO_STICKERS: the box textures only, without the atlas image on top
+#pragma keywords NO_STICKERS
 
 void main()
 {
+#ifdef NO_STICKERS
+    FragColor = texture(texture1, vec3(TexCoord, Layer));
+#else
     // Results in 80% of texture1 and 20% texture2 mixed
-    FragColor = mix(texture(texture1, TexCoord), 
-            texture(texture2, vec2(1.0 - TexCoord.x, TexCoord.y)), mixValue);
+    FragColor = mix(texture(texture1, vec3(TexCoord, Layer)), 
+            texture(texture2, AtlasCoord), mixValue);
+#endif
 }
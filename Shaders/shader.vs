@@ -1,10 +1,13 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoord;
+layout (location = 2) in float aLayer;     // texture array layer, per instance or per draw
 
 out vec2 TexCoord;
+out vec2 AtlasCoord;
+flat out float Layer;
 
-uniform mat4 model;
+#include "per_draw.glsl"
 uniform mat4 view;
 uniform mat4 projection;
 
@@ -12,4 +15,6 @@ void main()
 {
     gl_Position = projection * view * model * vec4(aPos, 1.0f);
     TexCoord = vec2(aTexCoord.x, aTexCoord.y);
+    Layer = aLayer;
+    AtlasCoord = vec2(1.0 - aTexCoord.x, aTexCoord.y) * uvRect.xy + uvRect.zw;
 }
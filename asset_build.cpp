@@ -0,0 +1,454 @@
+// Incremental asset build: converts what changed under the input directories
+// into build/ and packs the results into one archive for pak.h.
+//
+//      ./asset_build                       Assets and Shaders -> build/ -> assets.pak
+//      ./asset_build -j 4 --force          4 threads, convert everything
+//      ./asset_build --out other.pak Textures
+//
+// An input is converted again only when its contents, its settings file or
+// its converter's version changed since the last run, or one of its outputs
+// in build/ is missing. What was built from what is kept in
+// build/manifest.txt. Conversions run in parallel on the job pool.
+//
+// Converters:
+//      texture     .png .jpg .jpeg .bmp .tga   the image as is, plus its mip chain baked to "<name>.tex" (baked_texture.h)
+//      shader      .vs .fs .gs .glsl ...       comments and trailing blanks stripped, line numbers kept
+//      copy        anything else
+// Per-input settings go in "<name>.import" next to it, "key value" per line:
+//      wrap repeat|clamp|mirror    filter box|kaiser    srgb 0|1    premultiply 0|1    mipmaps 0|1
+// They have to match the TextureParams the game loads the texture with, or
+// the baked chain is ignored and the image decoded as before.
+// Build with `make asset_build`, or `make assets.pak` to build and pack.
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "job_pool.h"
+#include "mipmap.h"
+#include "baked_texture.h"
+#include "pak.h"
+#include "hash.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// bump when a change here changes any output, rebuilds everything
+static const int TOOL_VERSION = 1;
+
+struct Input
+{
+    std::string path;                               // as found, e.g. "Assets/wall.jpeg"
+    std::vector<uint8_t> bytes;
+    std::map<std::string, std::string> settings;    // from the .import file
+};
+
+struct Output
+{
+    std::string name;
+    std::vector<uint8_t> bytes;
+};
+
+struct Converter
+{
+    const char* name;
+    int version;                // bump when this converter's output changes
+    const char* extensions;     // " .png .jpg ", empty matches everything
+    bool (*convert)(const Input& input, std::vector<Output>& outputs, std::string& error);
+};
+
+static std::string setting(const Input& input, const char* key, const char* fallback)
+{
+    auto found = input.settings.find(key);
+    return found != input.settings.end() ? found->second : fallback;
+}
+
+static bool convertTexture(const Input& input, std::vector<Output>& outputs, std::string& error)
+{
+    int width, height, channels;
+    if (!stbi_info_from_memory(input.bytes.data(), (int)input.bytes.size(), &width, &height, &channels))
+    {
+        error = stbi_failure_reason();
+        return false;
+    }
+    // the same rules as TextureLoader::probeInfo() and mipOptions()
+    int uploadChannels = channels == 3 ? 4 : channels;
+    MipOptions options;
+    options.filter = setting(input, "filter", "box") == "kaiser" ? MIP_FILTER_KAISER : MIP_FILTER_BOX;
+    options.srgb = setting(input, "srgb", "1") != "0";
+    options.premultiply = setting(input, "premultiply", "1") != "0";
+    std::string wrap = setting(input, "wrap", "repeat");
+    options.wrap = wrap == "repeat" || wrap == "mirror";
+    int levels = 1;
+    if (setting(input, "mipmaps", "1") != "0")
+        for (int size = std::max(width, height); size > 1; size >>= 1)
+            levels++;
+
+    unsigned char* pixels = stbi_load_from_memory(input.bytes.data(), (int)input.bytes.size(), &width, &height, &channels, uploadChannels);
+    if (!pixels)
+    {
+        error = stbi_failure_reason();
+        return false;
+    }
+    std::vector<std::vector<uint8_t>> levelPixels(levels);
+    std::vector<MipLevel> mips(levels);
+    mips[0] = { pixels, width, height, (size_t)width * uploadChannels };
+    for (int level = 1; level < levels; level++)
+    {
+        int w = std::max(1, width >> level), h = std::max(1, height >> level);
+        levelPixels[level].resize((size_t)w * h * uploadChannels);
+        mips[level] = { levelPixels[level].data(), w, h, (size_t)w * uploadChannels };
+    }
+    generateMipChain(mips.data(), levels, uploadChannels, options);
+
+    outputs.push_back({ input.path, input.bytes });     // the atlas and GL-mipmapped loads still decode it
+    outputs.push_back({ bakedTexturePath(input.path), {} });
+    bakeTexture(mips.data(), levels, uploadChannels, options, outputs.back().bytes);
+    stbi_image_free(pixels);
+    return true;
+}
+
+static bool convertShader(const Input& input, std::vector<Output>& outputs, std::string&)
+{
+    const std::vector<uint8_t>& src = input.bytes;
+    std::string out, line;
+    bool blockComment = false;
+    for (size_t i = 0; i <= src.size(); i++)
+    {
+        char c = i < src.size() ? (char)src[i] : '\n';
+        char next = i + 1 < src.size() ? (char)src[i + 1] : 0;
+        if (blockComment)
+        {
+            if (c == '*' && next == '/')
+            {
+                blockComment = false;
+                i++;
+            }
+            else if (c == '\n')
+                out += '\n';    // keep line numbers for compile errors
+            continue;
+        }
+        if (c == '/' && next == '*')
+        {
+            blockComment = true;
+            i++;
+            continue;
+        }
+        if (c == '/' && next == '/')
+        {
+            while (i + 1 < src.size() && src[i + 1] != '\n')
+                i++;
+            continue;
+        }
+        if (c != '\n')
+        {
+            line += c;
+            continue;
+        }
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        out += line;
+        out += '\n';
+        line.clear();
+    }
+    // no trailing empty lines
+    while (out.size() > 1 && out[out.size() - 1] == '\n' && out[out.size() - 2] == '\n')
+        out.pop_back();
+    outputs.push_back({ input.path, std::vector<uint8_t>(out.begin(), out.end()) });
+    return true;
+}
+
+static bool convertCopy(const Input& input, std::vector<Output>& outputs, std::string&)
+{
+    outputs.push_back({ input.path, input.bytes });
+    return true;
+}
+
+static const Converter converters[] =
+{
+    { "texture", 1, " .png .jpg .jpeg .bmp .tga ", convertTexture },
+    { "shader", 1, " .vs .fs .gs .vert .frag .geom .comp .glsl ", convertShader },
+    { "copy", 1, "", convertCopy },
+};
+
+static const Converter& converterFor(const std::string& path)
+{
+    std::string extension = fs::path(path).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    for (const Converter& converter : converters)
+        if (!*converter.extensions || (!extension.empty() && strstr(converter.extensions, (" " + extension + " ").c_str())))
+            return converter;
+    return converters[sizeof(converters) / sizeof(converters[0]) - 1];
+}
+
+static bool readFile(const std::string& path, std::vector<uint8_t>& bytes)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+    bytes.clear();
+    uint8_t chunk[64 * 1024];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        bytes.insert(bytes.end(), chunk, chunk + read);
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+static bool writeFile(const fs::path& path, const std::vector<uint8_t>& bytes)
+{
+    std::error_code error;
+    fs::create_directories(path.parent_path(), error);    // may race with another job, that's fine
+    FILE* file = fopen(path.string().c_str(), "wb");
+    if (!file)
+        return false;
+    bool ok = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    return fclose(file) == 0 && ok;
+}
+
+// What the last run built from one input
+struct Record
+{
+    uint64_t key = 0;           // hash of contents and settings
+    std::string converter;
+    int version = 0;
+    std::vector<std::pair<std::string, uint64_t>> outputs;     // name, size
+};
+
+// "asset_build <tool version>", then per input:
+// path \t key \t converter \t version { \t output \t size }
+static std::map<std::string, Record> readManifest(const fs::path& path)
+{
+    std::map<std::string, Record> manifest;
+    std::ifstream file(path);
+    std::string line;
+    if (!std::getline(file, line) || line != "asset_build " + std::to_string(TOOL_VERSION))
+        return manifest;    // missing or from another tool version: everything is rebuilt
+    while (std::getline(file, line))
+    {
+        std::vector<std::string> fields;
+        std::stringstream stream(line);
+        std::string field;
+        while (std::getline(stream, field, '\t'))
+            fields.push_back(field);
+        if (fields.size() < 4 || fields.size() % 2)
+            continue;
+        Record& record = manifest[fields[0]];
+        record.key = std::strtoull(fields[1].c_str(), NULL, 16);
+        record.converter = fields[2];
+        record.version = std::atoi(fields[3].c_str());
+        for (size_t i = 4; i < fields.size(); i += 2)
+            record.outputs.push_back({ fields[i], std::strtoull(fields[i + 1].c_str(), NULL, 10) });
+    }
+    return manifest;
+}
+
+static bool writeManifest(const fs::path& path, const std::map<std::string, Record>& manifest)
+{
+    std::ofstream file(path);
+    file << "asset_build " << TOOL_VERSION << "\n";
+    for (const auto& entry : manifest)
+    {
+        char key[17];
+        std::snprintf(key, sizeof(key), "%016llx", (unsigned long long)entry.second.key);
+        file << entry.first << '\t' << key << '\t' << entry.second.converter << '\t' << entry.second.version;
+        for (const auto& output : entry.second.outputs)
+            file << '\t' << output.first << '\t' << output.second;
+        file << '\n';
+    }
+    return (bool)file;
+}
+
+int main(int argc, char** argv)
+{
+    int threads = -1;
+    bool force = false;
+    std::string pakPath = "assets.pak";
+    fs::path buildDir = "build";
+    std::vector<std::string> roots;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "-j" && i + 1 < argc)
+            threads = std::atoi(argv[++i]);
+        else if (arg == "--force")
+            force = true;
+        else if (arg == "--out" && i + 1 < argc)
+            pakPath = argv[++i];
+        else if (arg == "--build" && i + 1 < argc)
+            buildDir = argv[++i];
+        else if (arg[0] == '-')
+        {
+            std::printf("usage: %s [-j threads] [--force] [--out assets.pak] [--build dir] [input directories...]\n", argv[0]);
+            return 1;
+        }
+        else
+            roots.push_back(arg);
+    }
+    if (roots.empty())
+        roots = { "Assets", "Shaders" };
+    auto start = std::chrono::steady_clock::now();
+    stbi_set_flip_vertically_on_load(true);     // baked like the game loads them
+
+    // inputs, sorted so the archive comes out the same every time
+    std::vector<std::string> paths;
+    for (const std::string& root : roots)
+    {
+        std::error_code error;
+        for (fs::recursive_directory_iterator it(root, error), end; it != end; it.increment(error))
+        {
+            std::string name = it->path().filename().string();
+            if (it->is_regular_file(error) && name[0] != '.' && it->path().extension() != ".import")
+                paths.push_back(it->path().generic_string());
+        }
+        if (error)
+            std::printf("ERROR::ASSET_BUILD::INPUT %s: %s\n", root.c_str(), error.message().c_str());
+    }
+    std::sort(paths.begin(), paths.end());
+
+    fs::path manifestPath = buildDir / "manifest.txt";
+    std::map<std::string, Record> previous = force ? std::map<std::string, Record>() : readManifest(manifestPath);
+
+    // hash everything, then decide what needs converting
+    std::vector<Input> inputs(paths.size());
+    std::vector<uint64_t> keys(paths.size(), 0);
+    std::vector<char> readable(paths.size(), 0);
+    JobPool pool(threads > 0 ? threads - 1 : -1);
+    pool.parallelFor((int)paths.size(), [&](int i)
+    {
+        Input& input = inputs[i];
+        input.path = paths[i];
+        readable[i] = (char)readFile(input.path, input.bytes);
+        std::vector<uint8_t> settings;
+        readFile(input.path + ".import", settings);
+        keys[i] = xxhash64(settings.data(), settings.size(), xxhash64(input.bytes.data(), input.bytes.size()));
+        std::stringstream lines(std::string(settings.begin(), settings.end()));
+        std::string key, value;
+        while (lines >> key)
+        {
+            if (key[0] == '#')
+                std::getline(lines, value);
+            else if (lines >> value)
+                input.settings[key] = value;
+        }
+    });
+
+    std::vector<int> dirty;
+    std::map<std::string, Record> manifest;
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        if (!readable[i])
+        {
+            std::printf("ERROR::ASSET_BUILD::READ_FAILED %s\n", paths[i].c_str());
+            return 1;
+        }
+        const Converter& converter = converterFor(paths[i]);
+        auto found = previous.find(paths[i]);
+        bool upToDate = found != previous.end() && found->second.key == keys[i] &&
+                        found->second.converter == converter.name && found->second.version == converter.version;
+        if (upToDate)
+            for (const auto& output : found->second.outputs)
+            {
+                std::error_code error;
+                if (fs::file_size(buildDir / output.first, error) != output.second || error)
+                    upToDate = false;
+            }
+        if (upToDate)
+            manifest[paths[i]] = found->second;
+        else
+            dirty.push_back((int)i);
+    }
+
+    // outputs of inputs that are gone
+    size_t removed = 0;
+    for (const auto& entry : previous)
+        if (!std::binary_search(paths.begin(), paths.end(), entry.first))
+        {
+            for (const auto& output : entry.second.outputs)
+            {
+                std::error_code error;
+                fs::remove(buildDir / output.first, error);
+            }
+            removed++;
+        }
+
+    // the conversions themselves, in parallel
+    std::vector<std::vector<Output>> results(dirty.size());
+    std::vector<std::string> errors(dirty.size());
+    std::vector<char> converted(dirty.size(), 0);
+    pool.parallelFor((int)dirty.size(), [&](int d)
+    {
+        const Input& input = inputs[dirty[d]];
+        if (!converterFor(input.path).convert(input, results[d], errors[d]))
+            return;
+        for (const Output& output : results[d])
+            if (!writeFile(buildDir / output.name, output.bytes))
+            {
+                errors[d] = "can't write " + (buildDir / output.name).string();
+                return;
+            }
+        converted[d] = 1;
+    });
+
+    bool ok = true;
+    for (size_t d = 0; d < dirty.size(); d++)
+    {
+        const std::string& path = paths[dirty[d]];
+        if (!converted[d])
+        {
+            std::printf("ERROR::ASSET_BUILD::CONVERT_FAILED %s: %s\n", path.c_str(), errors[d].c_str());
+            ok = false;
+            continue;
+        }
+        const Converter& converter = converterFor(path);
+        Record& record = manifest[path];
+        record.key = keys[dirty[d]];
+        record.converter = converter.name;
+        record.version = converter.version;
+        for (const Output& output : results[d])
+            record.outputs.push_back({ output.name, output.bytes.size() });
+        std::printf("%-8s %s\n", converter.name, path.c_str());
+    }
+    inputs.clear();
+    results.clear();
+    fs::create_directories(buildDir);
+    if (!writeManifest(manifestPath, manifest))
+    {
+        std::printf("ERROR::ASSET_BUILD::MANIFEST_WRITE_FAILED %s\n", manifestPath.string().c_str());
+        return 1;
+    }
+
+    // repack when anything changed
+    std::error_code error;
+    bool repack = !dirty.empty() || removed || !fs::exists(pakPath, error);
+    if (ok && repack)
+    {
+        PakWriter writer;
+        std::vector<uint8_t> bytes;
+        for (const auto& entry : manifest)
+            for (const auto& output : entry.second.outputs)
+                if (!readFile((buildDir / output.first).string(), bytes) || !writer.add(output.first, bytes.data(), bytes.size()))
+                {
+                    std::printf("ERROR::ASSET_BUILD::PACK_FAILED %s\n", output.first.c_str());
+                    return 1;
+                }
+        if (!writer.write(pakPath))
+        {
+            std::printf("ERROR::ASSET_BUILD::PACK_FAILED %s\n", pakPath.c_str());
+            return 1;
+        }
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::printf("%zu converted, %zu up to date, %zu removed%s, %.0f ms\n", dirty.size(), paths.size() - dirty.size(), removed,
+                repack && ok ? (", packed " + pakPath).c_str() : "", ms);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,542 @@
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+
+// Whole-file reads in the background, many at once:
+//
+//      AsyncIO& io = AsyncIO::shared();
+//      io.read("assets/wall.jpeg", [](bool ok, std::vector<uint8_t>& bytes) { ... }, IO_PRIORITY_HIGH);
+//      io.read(...);
+//      io.submit();        // hands the batch over, highest priority first
+//      ...
+//      io.poll();          // runs the callbacks of finished reads, on this thread
+//      io.wait();          // or: until everything is done
+//      io.wait(remaining); // or: until a batch's own callbacks counted it down to 0
+//
+// On Linux the reads go through io_uring (opens and reads queued in the
+// kernel, up to 'queueDepth' files in flight, one syscall per batch), set up
+// with raw syscalls so there is no liburing dependency. Where io_uring isn't
+// available (macOS, old kernels, seccomp) a few blocking I/O threads do the
+// same. These are separate from the JobPool, whose threads are for CPU work.
+// All functions can be called from any thread; callbacks run on whichever
+// thread calls poll(), wait() or readFile().
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__) && !defined(ASYNC_IO_NO_URING)
+#define ASYNC_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#define __NR_io_uring_enter 426
+#define __NR_io_uring_register 427
+#endif
+#endif
+
+enum IOPriority
+{
+    IO_PRIORITY_HIGH,       // needed right now, e.g. something the frame waits on
+    IO_PRIORITY_NORMAL,
+    IO_PRIORITY_LOW,        // prefetching, streaming
+    IO_PRIORITY_COUNT
+};
+
+class AsyncIO
+{
+public:
+    // ok is false if the file couldn't be opened or read. The bytes may be moved out.
+    typedef std::function<void(bool ok, std::vector<uint8_t>& bytes)> Callback;
+
+    explicit AsyncIO(int queueDepth = 64, int fallbackThreads = 4)
+        : depth(queueDepth)
+    {
+#ifdef ASYNC_IO_URING
+        uring = setupRing();
+        if (uring)
+        {
+            slots.resize(depth);
+            for (int i = depth - 1; i >= 0; i--)
+                freeSlots.push_back(i);
+            return;
+        }
+#endif
+        for (int i = 0; i < std::max(fallbackThreads, 1); i++)
+            workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~AsyncIO()
+    {
+        wait();
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+#ifdef ASYNC_IO_URING
+        if (uring)
+        {
+            munmap(sqRing, sqRingSize);
+            if (cqRing != sqRing)
+                munmap(cqRing, cqRingSize);
+            munmap(sqes, sqEntries * sizeof(io_uring_sqe));
+            close(ringFd);
+        }
+#endif
+    }
+
+    AsyncIO(const AsyncIO&) = delete;
+    AsyncIO& operator=(const AsyncIO&) = delete;
+
+    // Process-wide instance, created on first use
+    static AsyncIO& shared()
+    {
+        static AsyncIO io;
+        return io;
+    }
+
+    bool usingIoUring() const { return uring; }
+
+    // Queues a read of the whole file, it starts at the next submit()
+    void read(const std::string& path, Callback done, IOPriority priority = IO_PRIORITY_NORMAL)
+    {
+        Request request;
+        request.path = path;
+        request.done = std::move(done);
+        std::lock_guard<std::mutex> guard(lock);
+        queued[priority].push_back(std::move(request));
+    }
+
+    // Starts everything read() queued since the last call
+    void submit()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            for (int p = 0; p < IO_PRIORITY_COUNT; p++)
+            {
+                for (Request& request : queued[p])
+                    pending[p].push_back(std::move(request));
+                queued[p].clear();
+            }
+#ifdef ASYNC_IO_URING
+            if (uring)
+            {
+                fillRing();
+                enter(0);
+            }
+#endif
+        }
+        wake.notify_all();
+    }
+
+    // Runs the callbacks of the reads that finished, returns how many
+    size_t poll()
+    {
+        std::vector<Request> done;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+#ifdef ASYNC_IO_URING
+            if (uring)
+            {
+                reap();
+                fillRing();
+                enter(0);
+            }
+#endif
+            done.swap(completed);
+        }
+        for (Request& request : done)
+            request.done(request.ok, request.bytes);
+        return done.size();
+    }
+
+    // Submits and runs callbacks until nothing is queued or in flight,
+    // including reads the callbacks themselves start
+    void wait()
+    {
+        waitUntil([this] { return idle(); });
+    }
+
+    // Submits and runs callbacks until 'remaining' is 0, for a batch whose
+    // callbacks count themselves down; unlike wait() it doesn't also wait for
+    // everyone else's reads, e.g. the streamer's low priority ones
+    void wait(const std::atomic<int>& remaining)
+    {
+        waitUntil([&remaining] { return remaining.load() == 0; });
+    }
+
+    // Reads one file now (high priority, other reads keep going)
+    bool readFile(const std::string& path, std::vector<uint8_t>& bytes)
+    {
+        std::shared_ptr<std::atomic<int>> state = std::make_shared<std::atomic<int>>(0);
+        read(path, [&bytes, state](bool ok, std::vector<uint8_t>& data)
+        {
+            bytes.swap(data);
+            state->store(ok ? 1 : 2);
+        }, IO_PRIORITY_HIGH);
+        waitUntil([&state] { return state->load() != 0; });
+        return state->load() == 1;
+    }
+
+private:
+    struct Request
+    {
+        std::string path;
+        Callback done;
+        std::vector<uint8_t> bytes;
+        int fd = -1;
+        size_t filled = 0;
+        bool ok = false;
+    };
+
+    int depth;
+    bool uring = false;
+    std::mutex lock;
+    std::condition_variable wake, finished;
+    std::deque<Request> queued[IO_PRIORITY_COUNT];     // not submitted yet
+    std::deque<Request> pending[IO_PRIORITY_COUNT];    // submitted, waiting for a slot or thread
+    std::vector<Request> completed;                    // waiting for their callbacks
+    int inFlight = 0;
+    std::vector<std::thread> workers;
+    bool stopping = false;
+
+    bool idle()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for (int p = 0; p < IO_PRIORITY_COUNT; p++)
+            if (!queued[p].empty())
+                return false;
+        return !busy() && completed.empty();
+    }
+
+    bool busy() const
+    {
+        for (int p = 0; p < IO_PRIORITY_COUNT; p++)
+            if (!pending[p].empty())
+                return true;
+        return inFlight > 0;
+    }
+
+    // one callback may be what 'done' is waiting for, so check after every poll
+    template <typename Done>
+    void waitUntil(Done done)
+    {
+        submit();
+        while (true)
+        {
+            poll();
+            if (done())
+                return;
+            submit();   // callbacks may have queued more
+            std::unique_lock<std::mutex> guard(lock);
+            if (!completed.empty())
+                continue;
+#ifdef ASYNC_IO_URING
+            if (uring)
+            {
+                if (!inFlight)
+                    continue;
+                // sleeps in the kernel until something completes, without the
+                // lock so other threads can read() and poll() meanwhile. one
+                // of them reaping what this waits for sends a wake-up (reap())
+                sleepers++;
+                guard.unlock();
+                syscall(__NR_io_uring_enter, ringFd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+                guard.lock();
+                sleepers--;
+                continue;
+            }
+#endif
+            finished.wait(guard, [this] { return !completed.empty() || !busy(); });
+        }
+    }
+
+    bool takeNext(Request& request)
+    {
+        for (int p = 0; p < IO_PRIORITY_COUNT; p++)
+            if (!pending[p].empty())
+            {
+                request = std::move(pending[p].front());
+                pending[p].pop_front();
+                return true;
+            }
+        return false;
+    }
+
+    // Thread fallback: plain blocking reads
+
+    void workerLoop()
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        while (true)
+        {
+            Request request;
+            wake.wait(guard, [&] { return stopping || takeNext(request); });
+            if (stopping && request.path.empty())
+                return;
+            inFlight++;
+            guard.unlock();
+            request.ok = readWhole(request.path, request.bytes);
+            guard.lock();
+            inFlight--;
+            completed.push_back(std::move(request));
+            finished.notify_all();
+        }
+    }
+
+    static bool readWhole(const std::string& path, std::vector<uint8_t>& bytes)
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        bool ok = fstat(fd, &st) == 0;
+        if (ok)
+        {
+            bytes.resize((size_t)st.st_size);
+            size_t filled = 0;
+            while (ok && filled < bytes.size())
+            {
+                ssize_t got = pread(fd, bytes.data() + filled, bytes.size() - filled, (off_t)filled);
+                if (got > 0)
+                    filled += (size_t)got;
+                else if (got == 0 || errno != EINTR)
+                    ok = false;
+            }
+        }
+        close(fd);
+        return ok;
+    }
+
+#ifdef ASYNC_IO_URING
+    // io_uring: every request goes open -> read (-> read for the rest if short),
+    // with fstat and close done inline when the open completes / the read finishes
+    int ringFd = -1;
+    void* sqRing = NULL;
+    void* cqRing = NULL;
+    size_t sqRingSize = 0, cqRingSize = 0;
+    unsigned sqEntries = 0;
+    unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+    unsigned *cqHead, *cqTail, *cqMask;
+    io_uring_sqe* sqes = NULL;
+    io_uring_cqe* cqes = NULL;
+    unsigned unsubmitted = 0;
+    std::vector<Request> slots;        // one per request in the ring, index is the user_data
+    std::vector<int> freeSlots;
+    int sleepers = 0;                  // threads waiting in io_uring_enter without the lock
+    bool waking = false;               // a wake-up nop is in the ring, at most one is
+    static const uint64_t WAKE = ~(uint64_t)0;     // user_data of the nop that wakes them
+
+    bool setupRing()
+    {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        // one entry more than the requests in flight, for the wake-up nop
+        int fd = (int)syscall(__NR_io_uring_setup, (unsigned)depth + 1, &params);
+        if (fd < 0)
+            return false;
+
+        // OPENAT and READ came in 5.6, ask instead of finding out per request
+        std::vector<uint8_t> probeMemory(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+        io_uring_probe* probe = (io_uring_probe*)probeMemory.data();
+        if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) < 0 ||
+            probe->last_op < IORING_OP_READ || !(probe->ops[IORING_OP_OPENAT].flags & IO_URING_OP_SUPPORTED) ||
+            !(probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED))
+        {
+            close(fd);
+            return false;
+        }
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single)
+            sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+        sqRing = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        cqRing = single ? sqRing : mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        sqEntries = params.sq_entries;
+        void* sqeMemory = mmap(NULL, sqEntries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqeMemory == MAP_FAILED)
+        {
+            if (sqRing != MAP_FAILED)
+                munmap(sqRing, sqRingSize);
+            if (!single && cqRing != MAP_FAILED)
+                munmap(cqRing, cqRingSize);
+            if (sqeMemory != MAP_FAILED)
+                munmap(sqeMemory, sqEntries * sizeof(io_uring_sqe));
+            close(fd);
+            return false;
+        }
+
+        char* sq = (char*)sqRing;
+        char* cq = (char*)cqRing;
+        sqHead = (unsigned*)(sq + params.sq_off.head);
+        sqTail = (unsigned*)(sq + params.sq_off.tail);
+        sqMask = (unsigned*)(sq + params.sq_off.ring_mask);
+        sqArray = (unsigned*)(sq + params.sq_off.array);
+        cqHead = (unsigned*)(cq + params.cq_off.head);
+        cqTail = (unsigned*)(cq + params.cq_off.tail);
+        cqMask = (unsigned*)(cq + params.cq_off.ring_mask);
+        cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+        sqes = (io_uring_sqe*)sqeMemory;
+        ringFd = fd;
+        if ((unsigned)depth >= sqEntries)
+            depth = (int)sqEntries - 1;
+        return true;
+    }
+
+    // every slot has at most one entry in the ring, plus the one wake-up, so
+    // there is always room
+    io_uring_sqe& nextSqe(uint64_t slot)
+    {
+        unsigned tail = *sqTail;
+        unsigned index = tail & *sqMask;
+        io_uring_sqe& sqe = sqes[index];
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.user_data = slot;
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        unsubmitted++;
+        return sqe;
+    }
+
+    void queueOpen(int slot)
+    {
+        io_uring_sqe& sqe = nextSqe(slot);
+        sqe.opcode = IORING_OP_OPENAT;
+        sqe.fd = AT_FDCWD;
+        sqe.addr = (uint64_t)(uintptr_t)slots[slot].path.c_str();
+        sqe.open_flags = O_RDONLY | O_CLOEXEC;
+    }
+
+    void queueRead(int slot)
+    {
+        Request& request = slots[slot];
+        size_t remaining = request.bytes.size() - request.filled;
+        io_uring_sqe& sqe = nextSqe(slot);
+        sqe.opcode = IORING_OP_READ;
+        sqe.fd = request.fd;
+        sqe.addr = (uint64_t)(uintptr_t)(request.bytes.data() + request.filled);
+        sqe.len = (unsigned)std::min(remaining, (size_t)1 << 30);
+        sqe.off = request.filled;
+    }
+
+    void fillRing()
+    {
+        Request request;
+        while (!freeSlots.empty() && takeNext(request))
+        {
+            int slot = freeSlots.back();
+            freeSlots.pop_back();
+            slots[slot] = std::move(request);
+            inFlight++;
+            queueOpen(slot);
+        }
+    }
+
+    // submits what's in the ring, waiting for 'minComplete' completions
+    void enter(unsigned minComplete)
+    {
+        if (!unsubmitted && !minComplete)
+            return;
+        long submitted = syscall(__NR_io_uring_enter, ringFd, unsubmitted, minComplete,
+                                 minComplete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (submitted > 0)
+            unsubmitted -= (unsigned)std::min<long>(submitted, unsubmitted);
+    }
+
+    void reap()
+    {
+        unsigned head = *cqHead;
+        unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        bool reaped = false;
+        for (; head != tail; head++)
+        {
+            const io_uring_cqe& cqe = cqes[head & *cqMask];
+            if (cqe.user_data == WAKE)
+            {
+                waking = false;
+                continue;
+            }
+            reaped = true;
+            int slot = (int)cqe.user_data;
+            Request& request = slots[slot];
+            if (request.fd < 0)
+            {
+                // the open finished
+                struct stat st;
+                if (cqe.res < 0)
+                    finish(slot, false);
+                else if ((request.fd = cqe.res, fstat(request.fd, &st) != 0))
+                    finish(slot, false);
+                else
+                {
+                    request.bytes.resize((size_t)st.st_size);
+                    if (request.bytes.empty())
+                        finish(slot, true);
+                    else
+                        queueRead(slot);
+                }
+            }
+            else if (cqe.res <= 0)
+            {
+                if (cqe.res == -EINTR || cqe.res == -EAGAIN)
+                    queueRead(slot);
+                else
+                    finish(slot, false);    // error, or the file got shorter
+            }
+            else
+            {
+                request.filled += (size_t)cqe.res;
+                if (request.filled < request.bytes.size())
+                    queueRead(slot);
+                else
+                    finish(slot, true);
+            }
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        // a thread asleep in waitUntil() may have been waiting for what was
+        // just taken off the ring, and nothing else may ever complete: wake it
+        // with a nop (the caller's enter() submits it)
+        if (reaped && sleepers && !waking)
+        {
+            nextSqe(WAKE).opcode = IORING_OP_NOP;
+            waking = true;
+        }
+    }
+
+    void finish(int slot, bool ok)
+    {
+        Request& request = slots[slot];
+        if (request.fd >= 0)
+            close(request.fd);
+        request.ok = ok;
+        if (!ok)
+            request.bytes.clear();
+        completed.push_back(std::move(request));
+        slots[slot] = Request();
+        freeSlots.push_back(slot);
+        inFlight--;
+    }
+#endif
+};
+
+#endif
@@ -0,0 +1,416 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include <glad/glad.h>
+
+#include "gl_ext.h"
+#include "job_pool.h"
+#include "mipmap.h"
+#include "texture.h"
+#ifndef STBI_INCLUDE_STB_IMAGE_H
+#include "stb_image.h"
+#endif
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+
+// Packs many small images into a few large RGBA textures (pages), so draws
+// using different images can share one binding:
+//
+//      AtlasBuilder atlas;
+//      int face = atlas.add("assets/awesomeface.png");
+//      atlas.build();          // decode on the job pool, pack, copy + bleed edges
+//      atlas.upload();         // one GL texture per page, with mips
+//      const AtlasEntry& e = atlas.entry(face);
+//      glBindTexture(GL_TEXTURE_2D, atlas.id(e.page));
+//      // in the shader: uv = uv * e.uvRect.xy + e.uvRect.zw
+//
+// Every image gets 'padding' texels of its own edge colour around it, and
+// positions are aligned so the first mipLevels() levels never mix
+// neighbouring images. That assumes 2x2 box filtered mips, so upload() always
+// builds those. Only 0..1 texture coordinates work, there is no wrap.
+
+// Bottom-left skyline bin packing: the top edge of everything placed so far is
+// kept as a list of horizontal segments, each rectangle goes where its top ends
+// up lowest.
+class SkylinePacker
+{
+public:
+    SkylinePacker(int width, int height)
+        : width(width), height(height)
+    {
+        skyline.push_back({ 0, 0, width });
+    }
+
+    bool insert(int w, int h, int& x, int& y)
+    {
+        int best = -1, bestX = 0, bestY = 0, bestTop = height + 1;
+        for (size_t i = 0; i < skyline.size(); i++)
+        {
+            int top;
+            if (fits(i, w, h, top) && top + h < bestTop)
+            {
+                best = (int)i;
+                bestX = skyline[i].x;
+                bestY = top;
+                bestTop = top + h;
+            }
+        }
+        if (best < 0)
+            return false;
+        place(best, bestX, bestY, w, h);
+        x = bestX;
+        y = bestY;
+        usedW = std::max(usedW, bestX + w);
+        usedH = std::max(usedH, bestY + h);
+        return true;
+    }
+
+    // bounding box of everything placed
+    int usedWidth() const { return usedW; }
+    int usedHeight() const { return usedH; }
+
+private:
+    struct Segment
+    {
+        int x, y, width;
+    };
+    int width, height;
+    int usedW = 0, usedH = 0;
+    std::vector<Segment> skyline;
+
+    // can a w x h rectangle start at segment i, and at what height
+    bool fits(size_t i, int w, int h, int& top) const
+    {
+        if (skyline[i].x + w > width)
+            return false;
+        top = 0;
+        for (int remaining = w; remaining > 0; i++)
+        {
+            top = std::max(top, skyline[i].y);
+            if (top + h > height)
+                return false;
+            remaining -= skyline[i].width;
+        }
+        return true;
+    }
+
+    void place(int i, int x, int y, int w, int h)
+    {
+        skyline.insert(skyline.begin() + i, { x, y + h, w });
+        // cut away what the new segment covers
+        for (size_t j = i + 1; j < skyline.size(); )
+        {
+            Segment& s = skyline[j];
+            int overlap = x + w - s.x;
+            if (overlap <= 0)
+                break;
+            if (overlap < s.width)
+            {
+                s.x += overlap;
+                s.width -= overlap;
+                break;
+            }
+            skyline.erase(skyline.begin() + j);
+        }
+        // merge neighbours at the same height
+        for (size_t j = 0; j + 1 < skyline.size(); )
+        {
+            if (skyline[j].y == skyline[j + 1].y)
+            {
+                skyline[j].width += skyline[j + 1].width;
+                skyline.erase(skyline.begin() + j + 1);
+            }
+            else
+                j++;
+        }
+    }
+};
+
+struct AtlasEntry
+{
+    int page = -1;
+    int x = 0, y = 0;               // texel position in the page, without padding
+    int width = 0, height = 0;
+    float uvRect[4] = { 1.0f, 1.0f, 0.0f, 0.0f };   // page uv = uv * (uvRect[0], uvRect[1]) + (uvRect[2], uvRect[3])
+};
+
+struct AtlasPage
+{
+    int width = 0, height = 0;
+    std::vector<unsigned char> pixels;  // RGBA, rows in the order images were loaded (stb flip applies)
+};
+
+class AtlasBuilder
+{
+public:
+    explicit AtlasBuilder(int pageSize = 2048, int padding = 16)
+        : pageSize(pageSize), padding(padding)
+    {
+    }
+
+    int add(const std::string& path)
+    {
+        Source source;
+        source.path = path;
+        sources.push_back(source);
+        return (int)sources.size() - 1;
+    }
+
+    // Already decoded RGBA pixels, copied
+    int add(const unsigned char* rgba, int width, int height)
+    {
+        Source source;
+        source.width = width;
+        source.height = height;
+        source.pixels.assign(rgba, rgba + (size_t)width * height * 4);
+        sources.push_back(source);
+        return (int)sources.size() - 1;
+    }
+
+    // Decodes the files, packs everything into pages and fills them. Returns
+    // false if an image failed to load or doesn't fit a page, the others are
+    // still packed.
+    bool build(JobPool& pool = JobPool::shared())
+    {
+        std::vector<char> loaded(sources.size(), 1);
+        std::vector<std::string> paths(sources.size());
+        for (size_t i = 0; i < sources.size(); i++)
+            if (sources[i].pixels.empty())
+                paths[i] = sources[i].path;
+        std::vector<std::vector<uint8_t>> files;
+        TextureLoader::readLooseFiles(paths, files);
+        pool.parallelFor((int)sources.size(), [&](int i)
+        {
+            Source& source = sources[i];
+            if (source.path.empty() || !source.pixels.empty())
+                return;
+            // straight into the source's pixels, from the file read above or a mounted pak
+            PakSpan file = { files[i].data(), files[i].size() };
+            const PakSpan* encoded = files[i].empty() ? NULL : &file;
+            int channels;
+            if (!TextureLoader::imageInfo(source.path, source.width, source.height, channels, encoded))
+            {
+                loaded[i] = 0;
+                return;
+            }
+            source.pixels.resize((size_t)source.width * source.height * 4);
+            if (!TextureLoader::imageLoadInto(source.path, source.pixels.data(), source.width * 4, source.width, source.height, 4, encoded))
+            {
+                source.pixels.clear();
+                loaded[i] = 0;
+            }
+        });
+
+        // big ones first packs tighter
+        std::vector<int> order;
+        bool ok = true;
+        for (size_t i = 0; i < sources.size(); i++)
+        {
+            if (!loaded[i])
+            {
+                std::cout << "ERROR::ATLAS::LOAD_FAILED " << sources[i].path << std::endl;
+                ok = false;
+            }
+            else
+                order.push_back((int)i);
+        }
+        std::stable_sort(order.begin(), order.end(), [this](int a, int b)
+        {
+            return sources[a].height != sources[b].height ? sources[a].height > sources[b].height : sources[a].width > sources[b].width;
+        });
+
+        entries.assign(sources.size(), AtlasEntry());
+        std::vector<SkylinePacker> packers;
+        int align = alignment();
+        for (int i : order)
+        {
+            const Source& source = sources[i];
+            int slotWidth = alignUp(source.width + 2 * padding, align);
+            int slotHeight = alignUp(source.height + 2 * padding, align);
+            if (slotWidth > pageSize || slotHeight > pageSize)
+            {
+                std::cout << "ERROR::ATLAS::IMAGE_TOO_LARGE " << source.path << " (" << source.width << "x" << source.height << ")" << std::endl;
+                ok = false;
+                continue;
+            }
+            AtlasEntry& entry = entries[i];
+            for (size_t p = 0; p <= packers.size(); p++)
+            {
+                if (p == packers.size())
+                    packers.emplace_back(pageSize, pageSize);
+                if (packers[p].insert(slotWidth, slotHeight, entry.x, entry.y))
+                {
+                    entry.page = (int)p;
+                    break;
+                }
+            }
+            entry.x += padding;
+            entry.y += padding;
+            entry.width = source.width;
+            entry.height = source.height;
+        }
+
+        // pages shrink to what was used
+        pages.assign(packers.size(), AtlasPage());
+        for (size_t p = 0; p < packers.size(); p++)
+        {
+            pages[p].width = packers[p].usedWidth();
+            pages[p].height = packers[p].usedHeight();
+            pages[p].pixels.assign((size_t)pages[p].width * pages[p].height * 4, 0);
+        }
+        pool.parallelFor((int)sources.size(), [this](int i)
+        {
+            if (entries[i].page >= 0)
+                blit(sources[i], entries[i], pages[entries[i].page]);
+        });
+        for (AtlasEntry& entry : entries)
+            if (entry.page >= 0)
+            {
+                const AtlasPage& page = pages[entry.page];
+                entry.uvRect[0] = (float)entry.width / page.width;
+                entry.uvRect[1] = (float)entry.height / page.height;
+                entry.uvRect[2] = (float)entry.x / page.width;
+                entry.uvRect[3] = (float)entry.y / page.height;
+            }
+        // sources are in the pages now
+        for (Source& source : sources)
+            std::vector<unsigned char>().swap(source.pixels);
+        return ok;
+    }
+
+    // Creates one texture per page with mipLevels() levels built on the CPU.
+    // mipOptions.filter and wrap are ignored: a wider filter (Kaiser) or
+    // wrapping would reach past the padding into the neighbours
+    void upload(GLenum minFilter = GL_LINEAR_MIPMAP_LINEAR, GLenum magFilter = GL_LINEAR, const MipOptions& mipOptions = MipOptions())
+    {
+        MipOptions options = mipOptions;
+        options.filter = MIP_FILTER_BOX;
+        options.wrap = false;
+        destroy();
+        ids.assign(pages.size(), 0);
+        int levelCount = mipLevels();
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        for (size_t p = 0; p < pages.size(); p++)
+        {
+            AtlasPage& page = pages[p];
+            int levels = std::min(levelCount, mipmapLevelsFor(page.width, page.height));
+            std::vector<std::vector<unsigned char>> levelPixels(levels);
+            std::vector<MipLevel> mips(levels);
+            mips[0] = { page.pixels.data(), page.width, page.height, (size_t)page.width * 4 };
+            for (int level = 1; level < levels; level++)
+            {
+                int w = std::max(1, page.width >> level), h = std::max(1, page.height >> level);
+                levelPixels[level].resize((size_t)w * h * 4);
+                mips[level] = { levelPixels[level].data(), w, h, (size_t)w * 4 };
+            }
+            generateMipChain(mips.data(), levels, 4, options);
+
+            glGenTextures(1, &ids[p]);
+            glBindTexture(GL_TEXTURE_2D, ids[p]);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+            if (glExt().textureStorage)
+                glExt().TexStorage2D(GL_TEXTURE_2D, levels, GL_RGBA8, page.width, page.height);
+            for (int level = 0; level < levels; level++)
+            {
+                const MipLevel& mip = mips[level];
+                if (glExt().textureStorage)
+                    glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, mip.width, mip.height, GL_RGBA, GL_UNSIGNED_BYTE, mip.pixels);
+                else
+                    glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, mip.width, mip.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, mip.pixels);
+            }
+        }
+    }
+
+    void destroy()
+    {
+        for (GLuint& id : ids)
+            if (id)
+            {
+                glDeleteTextures(1, &id);
+                id = 0;
+            }
+    }
+
+    // Levels that stay clean: a texel of the smallest one, plus its bilinear
+    // neighbour, still only covers padding
+    int mipLevels() const
+    {
+        int levels = 0;
+        while ((2 << levels) <= padding + 1)
+            levels++;
+        return std::max(levels, 1);
+    }
+
+    const AtlasEntry& entry(int handle) const { return entries[handle]; }
+    int pageCount() const { return (int)pages.size(); }
+    const AtlasPage& page(int index) const { return pages[index]; }
+    GLuint id(int page) const { return ids[page]; }
+
+private:
+    struct Source
+    {
+        std::string path;
+        int width = 0, height = 0;
+        std::vector<unsigned char> pixels;
+    };
+
+    int pageSize, padding;
+    std::vector<Source> sources;
+    std::vector<AtlasEntry> entries;
+    std::vector<AtlasPage> pages;
+    std::vector<GLuint> ids;
+
+    // slots start on multiples of the footprint of the smallest clean level
+    int alignment() const
+    {
+        return 1 << (mipLevels() - 1);
+    }
+
+    static int alignUp(int value, int align)
+    {
+        return (value + align - 1) / align * align;
+    }
+
+    static int mipmapLevelsFor(int width, int height)
+    {
+        int levels = 1;
+        for (int size = std::max(width, height); size > 1; size >>= 1)
+            levels++;
+        return levels;
+    }
+
+    // copies the image and repeats its edge texels over the padding around it
+    void blit(const Source& source, const AtlasEntry& entry, AtlasPage& page) const
+    {
+        size_t pageRow = (size_t)page.width * 4;
+        size_t imageRow = (size_t)source.width * 4;
+        for (int y = 0; y < source.height; y++)
+        {
+            unsigned char* row = page.pixels.data() + pageRow * (entry.y + y) + (size_t)entry.x * 4;
+            memcpy(row, source.pixels.data() + imageRow * y, imageRow);
+            for (int x = 1; x <= padding; x++)
+            {
+                memcpy(row - x * 4, row, 4);
+                memcpy(row + imageRow + (x - 1) * 4, row + imageRow - 4, 4);
+            }
+        }
+        size_t paddedRow = (size_t)(source.width + 2 * padding) * 4;
+        unsigned char* first = page.pixels.data() + pageRow * entry.y + (size_t)(entry.x - padding) * 4;
+        unsigned char* last = first + pageRow * (source.height - 1);
+        for (int y = 1; y <= padding; y++)
+        {
+            memcpy(first - pageRow * y, first, paddedRow);
+            memcpy(last + pageRow * y, last, paddedRow);
+        }
+    }
+};
+
+#endif
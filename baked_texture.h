@@ -0,0 +1,97 @@
+#ifndef BAKED_TEXTURE_H
+#define BAKED_TEXTURE_H
+
+#include "mipmap.h"
+#include "pak.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Texture with its whole mip chain already built, written by asset_build as
+// "<image path>.tex" and packed next to the image. Loaders that find one in
+// a mounted pak copy the levels instead of decoding and filtering.
+//
+// Layout: BakedTextureHeader, then every level tightly packed, largest first,
+// rows bottom to top like the flipped stb loads.
+
+const uint32_t BAKED_TEXTURE_MAGIC = 0x31584554;    // "TEX1"
+const uint32_t BAKED_TEXTURE_VERSION = 1;
+
+struct BakedTextureHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width, height;
+    uint32_t channels;          // as uploaded, RGB images are baked as RGBA
+    uint32_t levels;
+    uint32_t filter;            // MipFilter
+    uint32_t flags;             // bakedMipFlags()
+};
+
+inline std::string bakedTexturePath(const std::string& imagePath)
+{
+    return imagePath + ".tex";
+}
+
+inline uint32_t bakedMipFlags(const MipOptions& options)
+{
+    return (options.srgb ? 1u : 0u) | (options.premultiply ? 2u : 0u) | (options.wrap ? 4u : 0u);
+}
+
+inline size_t bakedLevelBytes(uint32_t width, uint32_t height, uint32_t channels, uint32_t level)
+{
+    size_t w = width >> level, h = height >> level;
+    return (w ? w : 1) * (h ? h : 1) * channels;
+}
+
+// The baked chain for an image in the mounted paks, if there is one built the
+// way the caller would build it. 'levels' is what the caller needs: 1 means
+// any mip settings will do. On success 'pixels' points at level 0.
+inline bool findBakedTexture(const std::string& imagePath, int width, int height, int channels, int levels,
+                             const MipOptions& options, PakSpan& pixels, std::vector<uint8_t>& storage)
+{
+    PakSpan file;
+    if (!findAsset(bakedTexturePath(imagePath), file, storage) || file.size < sizeof(BakedTextureHeader))
+        return false;
+    BakedTextureHeader header;
+    memcpy(&header, file.data, sizeof(header));
+    if (header.magic != BAKED_TEXTURE_MAGIC || header.version != BAKED_TEXTURE_VERSION || header.width != (uint32_t)width ||
+        header.height != (uint32_t)height || header.channels != (uint32_t)channels || header.levels < (uint32_t)levels)
+        return false;
+    if (levels > 1 && (header.levels != (uint32_t)levels || header.filter != (uint32_t)options.filter ||
+                       header.flags != bakedMipFlags(options)))
+        return false;
+    size_t total = 0;
+    for (uint32_t level = 0; level < header.levels; level++)
+        total += bakedLevelBytes(header.width, header.height, header.channels, level);
+    if (file.size - sizeof(header) < total)
+        return false;
+    pixels.data = file.data + sizeof(header);
+    pixels.size = total;
+    return true;
+}
+
+// Header plus levels, ready to write out
+inline void bakeTexture(const MipLevel* levels, int count, int channels, const MipOptions& options, std::vector<uint8_t>& out)
+{
+    BakedTextureHeader header;
+    header.magic = BAKED_TEXTURE_MAGIC;
+    header.version = BAKED_TEXTURE_VERSION;
+    header.width = (uint32_t)levels[0].width;
+    header.height = (uint32_t)levels[0].height;
+    header.channels = (uint32_t)channels;
+    header.levels = (uint32_t)count;
+    header.filter = (uint32_t)options.filter;
+    header.flags = bakedMipFlags(options);
+    out.assign((const uint8_t*)&header, (const uint8_t*)(&header + 1));
+    for (int level = 0; level < count; level++)
+        for (int y = 0; y < levels[level].height; y++)
+        {
+            const uint8_t* row = levels[level].pixels + levels[level].stride * y;
+            out.insert(out.end(), row, row + (size_t)levels[level].width * channels);
+        }
+}
+
+#endif
@@ -0,0 +1,174 @@
+// Image decode throughput benchmark (JPEG and PNG) over the bundled assets.
+// Build with `make bench` and run from the project root: ./bench_decode [iterations]
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "job_pool.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+struct Asset
+{
+    std::string path;
+    std::vector<unsigned char> bytes;
+};
+
+static bool readFile(const std::string& path, std::vector<unsigned char>& bytes)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+static const char* levelName(int level)
+{
+    switch (level)
+    {
+    case STBI_SIMD_SCALAR: return "scalar";
+    case STBI_SIMD_SSE2:   return "sse2";
+    case STBI_SIMD_AVX2:   return "avx2";
+    }
+    return "?";
+}
+
+// Decodes the asset 'iterations' times, returns output megabytes per second
+static double decodeThroughput(const Asset& asset, int iterations, int desiredChannels)
+{
+    size_t outputBytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        int width, height, channels;
+        unsigned char* data = stbi_load_from_memory(asset.bytes.data(), (int)asset.bytes.size(), &width, &height, &channels, desiredChannels);
+        if (!data)
+        {
+            std::printf("failed to decode %s: %s\n", asset.path.c_str(), stbi_failure_reason());
+            return 0.0;
+        }
+        outputBytes += (size_t)width * height * (desiredChannels ? desiredChannels : channels);
+        stbi_image_free(data);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return outputBytes / seconds / (1024.0 * 1024.0);
+}
+
+// Decodes into rows padded past the image (like a sub-rectangle of an atlas
+// page) and checks every row matches a plain decode and no padding byte moved
+static bool checkDecodeInto(const Asset& asset, int desiredChannels, bool flip)
+{
+    int width, height, channels;
+    stbi_set_flip_vertically_on_load(flip);
+    unsigned char* plain = stbi_load_from_memory(asset.bytes.data(), (int)asset.bytes.size(), &width, &height, &channels, desiredChannels);
+    if (!plain)
+        return false;
+    size_t rowBytes = (size_t)width * desiredChannels, stride = rowBytes + 13;
+    const unsigned char guard = 0xCD;
+    std::vector<unsigned char> dest(stride * height, guard);
+    bool ok = stbi_load_from_memory_into(asset.bytes.data(), (int)asset.bytes.size(), dest.data(), (int)stride, width, height, desiredChannels) != 0;
+    for (int y = 0; ok && y < height; y++)
+    {
+        ok = std::memcmp(dest.data() + stride * y, plain + rowBytes * y, rowBytes) == 0;
+        for (size_t i = rowBytes; ok && i < stride; i++)
+            ok = dest[stride * y + i] == guard;
+    }
+    stbi_image_free(plain);
+    stbi_set_flip_vertically_on_load(0);
+    return ok;
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 20;
+    const char* jpegs[] = { "Assets/container.jpeg", "Assets/wall.jpeg" };
+
+    std::printf("best SIMD level on this CPU: %s, job pool threads: %d + caller\n\n",
+                levelName(stbi_get_simd_level()), JobPool::shared().threadCount());
+
+    std::printf("JPEG decode (MB/s of output pixels, %d iterations)\n", iterations);
+    std::printf("%-24s %8s %10s %10s %10s %10s\n", "asset", "channels", "scalar", "sse2", "avx2", "threaded");
+    for (const char* path : jpegs)
+    {
+        Asset asset = { path, {} };
+        if (!readFile(path, asset.bytes))
+        {
+            std::printf("%-24s missing (run from the project root)\n", path);
+            continue;
+        }
+        for (int desired : { 3, 4 })
+        {
+            std::printf("%-24s %8d", path, desired);
+            for (int level = STBI_SIMD_SCALAR; level <= STBI_SIMD_AVX2; level++)
+            {
+                stbi_set_simd_level(level);
+                if (stbi_get_simd_level() != level)
+                    std::printf(" %10s", "n/a");
+                else
+                    std::printf(" %10.1f", decodeThroughput(asset, iterations, desired));
+            }
+            // best level, spread over the job pool
+            stbi_set_simd_level(STBI_SIMD_AUTO);
+            stbi_set_parallel_for(jobPoolParallelFor, &JobPool::shared());
+            std::printf(" %10.1f", decodeThroughput(asset, iterations, desired));
+            stbi_set_parallel_for(NULL, NULL);
+            std::printf("\n");
+        }
+    }
+    stbi_set_simd_level(STBI_SIMD_AUTO);
+
+    // decoding into caller memory has to stay inside each row, serial and in strips
+    bool intoOk = true;
+    for (const char* path : jpegs)
+    {
+        Asset asset = { path, {} };
+        if (!readFile(path, asset.bytes))
+            continue;
+        for (int threaded = 0; threaded < 2; threaded++)
+        {
+            stbi_set_parallel_for(threaded ? jobPoolParallelFor : NULL, threaded ? &JobPool::shared() : NULL);
+            for (int desired : { 3, 4 })
+                for (bool flip : { false, true })
+                    if (!checkDecodeInto(asset, desired, flip))
+                    {
+                        std::printf("decode into padded rows FAILED: %s, %d channels, flip %d, threaded %d\n", path, desired, flip, threaded);
+                        intoOk = false;
+                    }
+        }
+        stbi_set_parallel_for(NULL, NULL);
+    }
+    if (intoOk)
+        std::printf("decode into padded rows: ok\n");
+
+    // PNG: inflate is the same at every level, the SIMD level picks the unfilter kernels
+    const char* pngs[] = { "Assets/mario.png", "Assets/awesomeface.png" };
+    std::printf("\nPNG decode (MB/s of output pixels, %d iterations)\n", iterations);
+    std::printf("%-24s %8s %10s %10s %10s\n", "asset", "channels", "scalar", "sse2", "avx2");
+    for (const char* path : pngs)
+    {
+        Asset asset = { path, {} };
+        if (!readFile(path, asset.bytes))
+        {
+            std::printf("%-24s missing (run from the project root)\n", path);
+            continue;
+        }
+        std::printf("%-24s %8d", path, 0);
+        for (int level = STBI_SIMD_SCALAR; level <= STBI_SIMD_AVX2; level++)
+        {
+            stbi_set_simd_level(level);
+            if (stbi_get_simd_level() != level)
+                std::printf(" %10s", "n/a");
+            else
+                std::printf(" %10.1f", decodeThroughput(asset, iterations, 0));
+        }
+        std::printf("\n");
+    }
+    stbi_set_simd_level(STBI_SIMD_AUTO);
+    return intoOk ? 0 : 1;
+}
@@ -0,0 +1,146 @@
+// Throughput of the image_kernels.h pixel loops at every SIMD level, on a
+// synthetic 2048x2048 image. Each level's output is checked against scalar.
+// Also times a full mip chain (mipmap.h) for that image.
+// Build with `make bench_kernels` and run: ./bench_kernels [iterations]
+#include "image_kernels.h"
+#include "mipmap.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+static const size_t PIXELS = 2048 * 2048;
+
+static const char* levelName(int level)
+{
+    switch (level)
+    {
+    case IMAGE_KERNELS_SCALAR: return "scalar";
+    case IMAGE_KERNELS_SSSE3:  return "ssse3";
+    case IMAGE_KERNELS_AVX2:   return "avx2";
+    }
+    return "?";
+}
+
+// Runs the kernel 'iterations' times, returns megabytes per second of 'bytes' (input + output)
+static double throughput(const std::function<void()>& kernel, size_t bytes, int iterations)
+{
+    kernel();   // warm up, builds the lookup tables
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+        kernel();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return (double)bytes * iterations / seconds / (1024.0 * 1024.0);
+}
+
+struct Kernel
+{
+    const char* name;
+    size_t bytes;                       // moved per run
+    std::function<void()> run;
+    std::function<void()> reset;        // restores the input for in-place kernels
+    std::function<std::vector<unsigned char>()> result;
+};
+
+int main(int argc, char** argv)
+{
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 20;
+    int best = imageKernelLevel();
+
+    std::vector<uint8_t> rgb(PIXELS * 3), rgba(PIXELS * 4), source(PIXELS * 4), out3(PIXELS * 3), out4(PIXELS * 4);
+    std::vector<float> linear(PIXELS * 4);
+    unsigned int seed = 1;
+    for (uint8_t& v : source)
+    {
+        seed = seed * 1103515245u + 12345u;
+        v = (uint8_t)(seed >> 16);
+    }
+    for (size_t i = 0; i < rgb.size(); i++)
+        rgb[i] = source[i];
+    srgbToLinear(source.data(), linear.data(), PIXELS, 4);
+    const int bgra[4] = { 2, 1, 0, 3 };
+
+    auto bytesOf = [](const std::vector<uint8_t>& v) { return v; };
+    auto floatBytes = [&linear] { return std::vector<unsigned char>((unsigned char*)linear.data(), (unsigned char*)(linear.data() + linear.size())); };
+    Kernel kernels[] =
+    {
+        { "rgb -> rgba", PIXELS * 7, [&] { expandRGBToRGBA(rgb.data(), out4.data(), PIXELS); }, {}, [&] { return bytesOf(out4); } },
+        { "rgba -> rgb", PIXELS * 7, [&] { packRGBAToRGB(source.data(), out3.data(), PIXELS); }, {}, [&] { return bytesOf(out3); } },
+        { "swizzle bgra", PIXELS * 8, [&] { swizzleRGBA(source.data(), out4.data(), PIXELS, bgra); }, {}, [&] { return bytesOf(out4); } },
+        { "premultiply", PIXELS * 8, [&] { premultiplyAlpha(rgba.data(), PIXELS); }, [&] { rgba = source; }, [&] { return bytesOf(rgba); } },
+        { "srgb -> linear", PIXELS * 20, [&] { srgbToLinear(source.data(), linear.data(), PIXELS, 4); }, {}, floatBytes },
+        { "linear -> srgb", PIXELS * 20, [&] { linearToSrgb(linear.data(), out4.data(), PIXELS, 4); }, {}, [&] { return bytesOf(out4); } },
+        { "flip rows", PIXELS * 8, [&] { flipRows(rgba.data(), 2048 * 4, 2048); }, [&] { rgba = source; }, [&] { return bytesOf(rgba); } },
+    };
+
+    std::printf("best level on this CPU: %s\n\n", levelName(best));
+    std::printf("MB/s moved (input + output), %d iterations\n", iterations);
+    std::printf("%-16s %10s %10s %10s\n", "kernel", "scalar", "ssse3", "avx2");
+    for (Kernel& kernel : kernels)
+    {
+        std::printf("%-16s", kernel.name);
+        std::vector<unsigned char> expected;
+        for (int level = IMAGE_KERNELS_SCALAR; level <= IMAGE_KERNELS_AVX2; level++)
+        {
+            if (level > best)
+            {
+                std::printf(" %10s", "n/a");
+                continue;
+            }
+            setImageKernelLevel(level);
+            if (kernel.reset)
+                kernel.reset();
+            kernel.run();
+            std::vector<unsigned char> result = kernel.result();
+            if (level == IMAGE_KERNELS_SCALAR)
+                expected = result;
+            else if (result != expected)
+            {
+                std::printf(" %10s", "MISMATCH");
+                continue;
+            }
+            std::printf(" %10.1f", throughput(kernel.run, kernel.bytes, iterations));
+        }
+        std::printf("\n");
+    }
+
+    // mip chain for the RGBA image, single threaded and on the job pool
+    std::vector<MipLevel> levels(1, MipLevel{ source.data(), 2048, 2048, 2048 * 4 });
+    std::vector<std::vector<uint8_t>> levelPixels;
+    for (int size = 1024; size >= 1; size /= 2)
+    {
+        levelPixels.emplace_back((size_t)size * size * 4);
+        levels.push_back({ levelPixels.back().data(), size, size, (size_t)size * 4 });
+    }
+    JobPool serial(0);
+    std::printf("\nmip chain from 2048x2048 RGBA (ms), %d iterations\n", iterations);
+    std::printf("%-16s %10s %10s %10s %10s\n", "filter", "scalar", "ssse3", "avx2", "pooled");
+    for (MipFilter filter : { MIP_FILTER_BOX, MIP_FILTER_KAISER })
+    {
+        MipOptions options;
+        options.filter = filter;
+        std::printf("%-16s", filter == MIP_FILTER_BOX ? "box" : "kaiser");
+        auto timeChain = [&](JobPool& pool)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < iterations; i++)
+                generateMipChain(levels.data(), (int)levels.size(), 4, options, pool);
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+        };
+        for (int level = IMAGE_KERNELS_SCALAR; level <= IMAGE_KERNELS_AVX2; level++)
+        {
+            if (level > best)
+            {
+                std::printf(" %10s", "n/a");
+                continue;
+            }
+            setImageKernelLevel(level);
+            std::printf(" %10.2f", timeChain(serial));
+        }
+        setImageKernelLevel(best);
+        std::printf(" %10.2f\n", timeChain(JobPool::shared()));
+    }
+    return 0;
+}
@@ -0,0 +1,160 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+// Tells which of a set of files changed on disk since the last poll():
+//
+//      FileWatcher watcher;
+//      watcher.watch("./Shaders/shader.fs");
+//      ...every frame:
+//      watcher.poll(changed);      // never blocks, paths as given to watch()
+//
+// On Linux this is inotify on the files' directories, for files closed after
+// writing and files renamed into place (how most editors save), so a file is
+// only reported once it's complete. Elsewhere, or if inotify is unavailable,
+// the files' modification time and size are checked every 'interval' seconds.
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__) && !defined(FILE_WATCHER_NO_INOTIFY)
+#define FILE_WATCHER_INOTIFY
+#include <sys/inotify.h>
+#endif
+
+class FileWatcher
+{
+public:
+    explicit FileWatcher(float interval = 0.25f)
+        : interval(interval)
+    {
+#ifdef FILE_WATCHER_INOTIFY
+        inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+    }
+
+    ~FileWatcher()
+    {
+#ifdef FILE_WATCHER_INOTIFY
+        if (inotifyFd >= 0)
+            close(inotifyFd);
+#endif
+    }
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    void watch(const std::string& path)
+    {
+        for (const File& file : files)
+            if (file.path == path)
+                return;
+        File file;
+        file.path = path;
+        size_t slash = path.find_last_of('/');
+        file.directory = slash == std::string::npos ? "." : path.substr(0, slash ? slash : 1);
+        file.name = slash == std::string::npos ? path : path.substr(slash + 1);
+        stamp(file.path, file.modified, file.size);
+#ifdef FILE_WATCHER_INOTIFY
+        if (inotifyFd >= 0)
+            file.watch = inotify_add_watch(inotifyFd, file.directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+#endif
+        files.push_back(file);
+    }
+
+    // Adds the files that changed to 'changed', once each. Returns how many.
+    size_t poll(std::vector<std::string>& changed)
+    {
+        size_t before = changed.size();
+#ifdef FILE_WATCHER_INOTIFY
+        if (inotifyFd >= 0)
+        {
+            // aligned for the inotify_event structs
+            alignas(inotify_event) char buffer[4096];
+            ssize_t length;
+            while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0)
+            {
+                for (char* p = buffer; p < buffer + length; p += sizeof(inotify_event) + ((inotify_event*)p)->len)
+                {
+                    const inotify_event* event = (const inotify_event*)p;
+                    if (!event->len)
+                        continue;
+                    for (const File& file : files)
+                        if (file.watch == event->wd && file.name == event->name)
+                            report(file.path, changed, before);
+                }
+            }
+            return changed.size() - before;
+        }
+#endif
+        // no inotify: poll the files every now and then
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (std::chrono::duration<float>(now - lastCheck).count() < interval)
+            return 0;
+        lastCheck = now;
+        for (File& file : files)
+        {
+            long long modified, size;
+            if (stamp(file.path, modified, size) && (modified != file.modified || size != file.size))
+            {
+                file.modified = modified;
+                file.size = size;
+                report(file.path, changed, before);
+            }
+        }
+        return changed.size() - before;
+    }
+
+    // whether inotify is doing the watching, otherwise it's polling
+    bool notified() const
+    {
+#ifdef FILE_WATCHER_INOTIFY
+        return inotifyFd >= 0;
+#else
+        return false;
+#endif
+    }
+
+private:
+    struct File
+    {
+        std::string path, directory, name;
+        int watch = -1;
+        long long modified = 0, size = 0;
+    };
+
+    std::vector<File> files;
+    float interval;
+    std::chrono::steady_clock::time_point lastCheck;
+#ifdef FILE_WATCHER_INOTIFY
+    int inotifyFd = -1;
+#endif
+
+    static bool stamp(const std::string& path, long long& modified, long long& size)
+    {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+            return false;
+#if defined(__APPLE__)
+        modified = (long long)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#elif defined(__linux__)
+        modified = (long long)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#else
+        modified = (long long)st.st_mtime;
+#endif
+        size = (long long)st.st_size;
+        return true;
+    }
+
+    static void report(const std::string& path, std::vector<std::string>& changed, size_t from)
+    {
+        if (std::find(changed.begin() + from, changed.end(), path) == changed.end())
+            changed.push_back(path);
+    }
+};
+
+#endif
@@ -0,0 +1,230 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+// Frame-scoped linear (bump) allocator for transient CPU data.
+//
+// Everything allocated from frameArena() lives until resetFrameArenas() is
+// called at the end of the frame, there is no per-allocation free. Every
+// thread gets its own arena so jobs can allocate without locking.
+//
+// Optional heap tracking: in exactly one .cpp file do
+//      #define FRAME_ARENA_TRACK_HEAP
+//      #define FRAME_ARENA_IMPLEMENTATION
+//      #include "frame_arena.h"
+// to replace the global operator new/delete with counting versions, then
+// heapAllocationCount() tells how many heap allocations happened so far
+// (e.g. compare it across a frame to check steady state allocates nothing).
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+
+class LinearArena
+{
+public:
+    explicit LinearArena(size_t capacity = 256 * 1024)
+    {
+        grow(capacity);
+    }
+    ~LinearArena()
+    {
+        for (Block& block : blocks)
+            free(block.data);
+    }
+    LinearArena(const LinearArena&) = delete;
+    LinearArena& operator=(const LinearArena&) = delete;
+
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+    {
+        Block* block = &blocks.back();
+        size_t start = (block->used + alignment - 1) & ~(alignment - 1);
+        if (start + size > block->capacity)
+        {
+            // out of space this frame: chain another block, reset() merges them
+            grow(std::max(block->capacity * 2, size + alignment));
+            block = &blocks.back();
+            start = 0;
+        }
+        block->used = start + size;
+        used += size;
+        return block->data + start;
+    }
+
+    template <typename T>
+    T* allocateArray(size_t count)
+    {
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    // Forget everything allocated. If the frame overflowed into extra blocks,
+    // replace them with one block big enough, so the next frame won't overflow.
+    void reset()
+    {
+        peak = std::max(peak, used);
+        if (blocks.size() > 1)
+        {
+            size_t total = 0;
+            for (Block& block : blocks)
+            {
+                total += block.capacity;
+                free(block.data);
+            }
+            blocks.clear();
+            grow(total);
+        }
+        blocks.back().used = 0;
+        used = 0;
+    }
+
+    size_t bytesUsed() const { return used; }
+    size_t peakBytes() const { return std::max(peak, used); }
+    size_t capacity() const
+    {
+        size_t total = 0;
+        for (const Block& block : blocks)
+            total += block.capacity;
+        return total;
+    }
+
+private:
+    struct Block
+    {
+        unsigned char* data;
+        size_t capacity;
+        size_t used;
+    };
+    std::vector<Block> blocks;
+    size_t used = 0;
+    size_t peak = 0;
+
+    void grow(size_t capacity)
+    {
+        blocks.reserve(blocks.size() + 1);
+        blocks.push_back({ (unsigned char*)malloc(capacity), capacity, 0 });
+    }
+};
+
+namespace frame_arena_detail
+{
+    struct Registry
+    {
+        std::mutex lock;
+        std::vector<LinearArena*> arenas;
+    };
+    inline Registry& registry()
+    {
+        static Registry instance;
+        return instance;
+    }
+
+    // owns one thread's arena and keeps it registered while the thread lives
+    struct ThreadArena
+    {
+        LinearArena arena;
+        ThreadArena()
+        {
+            std::lock_guard<std::mutex> guard(registry().lock);
+            registry().arenas.push_back(&arena);
+        }
+        ~ThreadArena()
+        {
+            std::lock_guard<std::mutex> guard(registry().lock);
+            std::vector<LinearArena*>& arenas = registry().arenas;
+            arenas.erase(std::remove(arenas.begin(), arenas.end(), &arena), arenas.end());
+        }
+    };
+}
+
+// The calling thread's arena (created on first use)
+inline LinearArena& frameArena()
+{
+    thread_local frame_arena_detail::ThreadArena threadArena;
+    return threadArena.arena;
+}
+
+// Call once at the end of a frame, when no job is still using frame memory
+inline void resetFrameArenas()
+{
+    frame_arena_detail::Registry& reg = frame_arena_detail::registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    for (LinearArena* arena : reg.arenas)
+        arena->reset();
+}
+
+// STL adapter, e.g. std::vector<int, ArenaAllocator<int>> list(ArenaAllocator<int>(frameArena()));
+// deallocate() is a no-op, memory comes back when the arena resets
+template <typename T>
+struct ArenaAllocator
+{
+    typedef T value_type;
+    LinearArena* arena;
+
+    explicit ArenaAllocator(LinearArena& arena) : arena(&arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t n) { return arena->allocateArray<T>(n); }
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+};
+
+// Heap allocation counters (only count when FRAME_ARENA_TRACK_HEAP is enabled)
+struct HeapCounters
+{
+    std::atomic<uint64_t> allocations{ 0 };
+    std::atomic<uint64_t> frees{ 0 };
+    std::atomic<uint64_t> bytes{ 0 };
+};
+inline HeapCounters& heapCounters()
+{
+    static HeapCounters counters;
+    return counters;
+}
+inline uint64_t heapAllocationCount()
+{
+    return heapCounters().allocations.load(std::memory_order_relaxed);
+}
+
+#if defined(FRAME_ARENA_IMPLEMENTATION) && defined(FRAME_ARENA_TRACK_HEAP)
+void* operator new(size_t size)
+{
+    heapCounters().allocations.fetch_add(1, std::memory_order_relaxed);
+    heapCounters().bytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+void operator delete(void* p) noexcept
+{
+    if (p)
+        heapCounters().frees.fetch_add(1, std::memory_order_relaxed);
+    free(p);
+}
+void operator delete[](void* p) noexcept
+{
+    operator delete(p);
+}
+void operator delete(void* p, size_t) noexcept
+{
+    operator delete(p);
+}
+void operator delete[](void* p, size_t) noexcept
+{
+    operator delete(p);
+}
+#endif
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef GL_EXT_H
+#define GL_EXT_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+
+// glad was generated for plain GL 3.3 core without extensions, so the few
+// optional extensions we take advantage of are loaded here by hand.
+// Call loadGLExtensions() once after gladLoadGLLoader().
+
+// ARB_buffer_storage (core in 4.4)
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+#endif
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC_EXT)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+// ARB_texture_storage (core in 4.2)
+typedef void (APIENTRYP PFNGLTEXSTORAGE2DPROC_EXT)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height);
+typedef void (APIENTRYP PFNGLTEXSTORAGE3DPROC_EXT)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth);
+
+// EXT_texture_filter_anisotropic (core in 4.6), only enums
+#ifndef GL_TEXTURE_MAX_ANISOTROPY_EXT
+#define GL_TEXTURE_MAX_ANISOTROPY_EXT 0x84FE
+#define GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT 0x84FF
+#endif
+
+// KHR_parallel_shader_compile / ARB_parallel_shader_compile
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC_EXT)(GLuint count);
+
+struct GLExtensions
+{
+    bool bufferStorage = false;
+    PFNGLBUFFERSTORAGEPROC_EXT BufferStorage = NULL;
+    bool textureStorage = false;
+    PFNGLTEXSTORAGE2DPROC_EXT TexStorage2D = NULL;
+    PFNGLTEXSTORAGE3DPROC_EXT TexStorage3D = NULL;      // also used for 2D array textures
+    bool anisotropic = false;
+    float maxAnisotropy = 1.0f;
+    bool parallelShaderCompile = false;     // GL_COMPLETION_STATUS_KHR can be polled
+    PFNGLMAXSHADERCOMPILERTHREADSKHRPROC_EXT MaxShaderCompilerThreads = NULL;
+};
+
+inline GLExtensions& glExt()
+{
+    static GLExtensions extensions;
+    return extensions;
+}
+
+// GL3 core has no single extension string, walk the indexed list instead
+inline bool hasGLExtension(const char* name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++)
+    {
+        const char* ext = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if (ext && strcmp(ext, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+inline void loadGLExtensions(GLADloadproc load)
+{
+    GLExtensions& ext = glExt();
+    if (hasGLExtension("GL_ARB_buffer_storage"))
+    {
+        ext.BufferStorage = (PFNGLBUFFERSTORAGEPROC_EXT)load("glBufferStorage");
+        ext.bufferStorage = ext.BufferStorage != NULL;
+    }
+    if (hasGLExtension("GL_ARB_texture_storage"))
+    {
+        ext.TexStorage2D = (PFNGLTEXSTORAGE2DPROC_EXT)load("glTexStorage2D");
+        ext.TexStorage3D = (PFNGLTEXSTORAGE3DPROC_EXT)load("glTexStorage3D");
+        ext.textureStorage = ext.TexStorage2D != NULL && ext.TexStorage3D != NULL;
+    }
+    if (hasGLExtension("GL_EXT_texture_filter_anisotropic") || hasGLExtension("GL_ARB_texture_filter_anisotropic"))
+    {
+        glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &ext.maxAnisotropy);
+        ext.anisotropic = ext.maxAnisotropy > 1.0f;
+    }
+    if (hasGLExtension("GL_KHR_parallel_shader_compile") || hasGLExtension("GL_ARB_parallel_shader_compile"))
+    {
+        ext.MaxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC_EXT)load("glMaxShaderCompilerThreadsKHR");
+        if (!ext.MaxShaderCompilerThreads)
+            ext.MaxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC_EXT)load("glMaxShaderCompilerThreadsARB");
+        if (ext.MaxShaderCompilerThreads)
+            ext.MaxShaderCompilerThreads(0xFFFFFFFF);   // as many compiler threads as the driver likes
+        ext.parallelShaderCompile = true;
+    }
+}
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef GL_STATE_CACHE_H
+#define GL_STATE_CACHE_H
+
+#include <glad/glad.h>
+
+// Remembers what is bound so redundant binds never reach the driver. Only
+// calls made through it are tracked: after code that binds textures, samplers,
+// programs or VAOs itself (the texture loaders do), call invalidate() so the
+// next bind of each goes through again.
+//
+//      glState().bindTexture(0, GL_TEXTURE_2D, id);
+//      glState().bindSampler(0, samplers.get(desc));
+
+class GLStateCache
+{
+public:
+    static const int MAX_UNITS = 32;
+
+    struct Stats
+    {
+        size_t binds = 0;           // calls that changed something
+        size_t skipped = 0;         // calls that were already the current state
+    };
+
+    GLStateCache()
+    {
+        invalidate();
+    }
+
+    void useProgram(GLuint program)
+    {
+        if (changed(currentProgram, program))
+            glUseProgram(program);
+    }
+
+    void bindVertexArray(GLuint vao)
+    {
+        if (changed(currentVertexArray, vao))
+            glBindVertexArray(vao);
+    }
+
+    void bindTexture(int unit, GLenum target, GLuint id)
+    {
+        int t = targetIndex(target);
+        if (t < 0 || unit < 0 || unit >= MAX_UNITS)
+        {
+            // not a target or unit we track, always bind
+            activeTexture(unit);
+            glBindTexture(target, id);
+            return;
+        }
+        if (!changed(textures[unit][t], id))
+            return;
+        activeTexture(unit);
+        glBindTexture(target, id);
+    }
+
+    void bindSampler(int unit, GLuint sampler)
+    {
+        if (unit < 0 || unit >= MAX_UNITS)
+            glBindSampler(unit, sampler);   // past the units we track, always bind
+        else if (changed(samplers[unit], sampler))
+            glBindSampler(unit, sampler);
+    }
+
+    // Forget everything, the next call of each kind binds for real
+    void invalidate()
+    {
+        currentProgram = UNKNOWN;
+        currentVertexArray = UNKNOWN;
+        currentUnit = -1;
+        for (int unit = 0; unit < MAX_UNITS; unit++)
+        {
+            for (int t = 0; t < TARGET_COUNT; t++)
+                textures[unit][t] = UNKNOWN;
+            samplers[unit] = UNKNOWN;
+        }
+    }
+
+    // Objects about to be deleted, so a new one reusing the name still gets bound
+    void forgetTexture(GLuint id)
+    {
+        for (int unit = 0; unit < MAX_UNITS; unit++)
+            for (int t = 0; t < TARGET_COUNT; t++)
+                if (textures[unit][t] == id)
+                    textures[unit][t] = UNKNOWN;
+    }
+
+    void forgetSampler(GLuint sampler)
+    {
+        for (int unit = 0; unit < MAX_UNITS; unit++)
+            if (samplers[unit] == sampler)
+                samplers[unit] = UNKNOWN;
+    }
+
+    const Stats& stats() const { return counters; }
+
+private:
+    static const GLuint UNKNOWN = 0xFFFFFFFFu;    // never a valid GL name
+    enum { TARGET_2D, TARGET_2D_ARRAY, TARGET_3D, TARGET_CUBE_MAP, TARGET_COUNT };
+
+    GLuint currentProgram, currentVertexArray;
+    GLuint textures[MAX_UNITS][TARGET_COUNT];
+    GLuint samplers[MAX_UNITS];
+    int currentUnit;
+    Stats counters;
+
+    bool changed(GLuint& current, GLuint value)
+    {
+        if (current == value)
+        {
+            counters.skipped++;
+            return false;
+        }
+        current = value;
+        counters.binds++;
+        return true;
+    }
+
+    void activeTexture(int unit)
+    {
+        if (unit != currentUnit)
+        {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            currentUnit = unit;
+        }
+    }
+
+    static int targetIndex(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_TEXTURE_2D:       return TARGET_2D;
+        case GL_TEXTURE_2D_ARRAY: return TARGET_2D_ARRAY;
+        case GL_TEXTURE_3D:       return TARGET_3D;
+        case GL_TEXTURE_CUBE_MAP: return TARGET_CUBE_MAP;
+        }
+        return -1;
+    }
+};
+
+// The one for the (single) GL context
+inline GLStateCache& glState()
+{
+    static GLStateCache state;
+    return state;
+}
+
+#endif
@@ -0,0 +1,517 @@
+#ifndef IMAGE_KERNELS_H
+#define IMAGE_KERNELS_H
+
+// Pixel loops that run over every loaded byte: RGB <-> RGBA, channel swizzle,
+// alpha premultiplication, sRGB <-> linear and row flipping.
+//
+// Every kernel has a scalar version and x86 SIMD versions (SSSE3 and AVX2,
+// compiled with per-function target attributes so no -m flags are needed).
+// The best level the CPU supports is picked at runtime; setImageKernelLevel()
+// forces a lower one, e.g. for benchmarks. All levels give identical results.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define IMAGE_KERNELS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define IMAGE_KERNELS_TARGET(isa)
+#else
+#define IMAGE_KERNELS_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+enum ImageKernelLevel
+{
+    IMAGE_KERNELS_SCALAR = 0,
+    IMAGE_KERNELS_SSSE3 = 1,
+    IMAGE_KERNELS_AVX2 = 2
+};
+
+namespace image_kernels_detail
+{
+    inline int detectLevel()
+    {
+#ifdef IMAGE_KERNELS_X86
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 1);
+        bool ssse3 = (info[2] >> 9) & 1;
+        bool osxsave = (info[2] >> 27) & 1;
+        if (!ssse3)
+            return IMAGE_KERNELS_SCALAR;
+        if (!osxsave || (_xgetbv(0) & 6) != 6)
+            return IMAGE_KERNELS_SSSE3;
+        __cpuidex(info, 7, 0);
+        return ((info[1] >> 5) & 1) ? IMAGE_KERNELS_AVX2 : IMAGE_KERNELS_SSSE3;
+#else
+        if (__builtin_cpu_supports("avx2"))
+            return IMAGE_KERNELS_AVX2;
+        if (__builtin_cpu_supports("ssse3"))
+            return IMAGE_KERNELS_SSSE3;
+#endif
+#endif
+        return IMAGE_KERNELS_SCALAR;
+    }
+
+    inline int& levelSetting()
+    {
+        static int level = detectLevel();
+        return level;
+    }
+
+    // sRGB 8-bit -> linear float
+    inline const float* srgbToLinearTable()
+    {
+        struct Table
+        {
+            float values[512];      // 256 sRGB entries, then 256 linear (alpha) entries
+            Table()
+            {
+                for (int i = 0; i < 256; i++)
+                {
+                    float c = i / 255.0f;
+                    values[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+                    values[256 + i] = c;
+                }
+            }
+        };
+        static Table table;
+        return table.values;
+    }
+
+    // linear float quantized to 12 bits -> sRGB 8-bit
+    const int LINEAR_BITS = 12;
+    const int LINEAR_STEPS = (1 << LINEAR_BITS) - 1;
+    inline const int32_t* linearToSrgbTable()
+    {
+        struct Table
+        {
+            int32_t values[2 << LINEAR_BITS];   // sRGB encode, then plain (alpha) entries
+            Table()
+            {
+                for (int i = 0; i <= LINEAR_STEPS; i++)
+                {
+                    float l = (float)i / LINEAR_STEPS;
+                    float s = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+                    values[i] = (int32_t)(s * 255.0f + 0.5f);
+                    values[(1 << LINEAR_BITS) + i] = (int32_t)(l * 255.0f + 0.5f);
+                }
+            }
+        };
+        static Table table;
+        return table.values;
+    }
+
+    inline int linearIndex(float x)
+    {
+        // written so NaN ends up as 0, same as the SIMD max/min
+        x = x > 0.0f ? x : 0.0f;
+        x = x < 1.0f ? x : 1.0f;
+        return (int)(x * (float)LINEAR_STEPS + 0.5f);
+    }
+
+    // index of the channel that is alpha (stays linear), -1 if none
+    inline int alphaChannel(int channels)
+    {
+        return channels == 2 || channels == 4 ? channels - 1 : -1;
+    }
+
+#ifdef IMAGE_KERNELS_X86
+    IMAGE_KERNELS_TARGET("ssse3")
+    inline size_t expandRGBToRGBA_ssse3(const uint8_t* src, uint8_t* dst, size_t pixels, uint8_t alpha)
+    {
+        const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m128i fill = _mm_set1_epi32((int)((uint32_t)alpha << 24));
+        size_t i = 0;
+        // reads 16 bytes for 4 pixels, stay clear of the end
+        for (; i + 6 <= pixels; i += 4)
+        {
+            __m128i rgb = _mm_loadu_si128((const __m128i*)(src + i * 3));
+            _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), fill));
+        }
+        return i;
+    }
+
+    IMAGE_KERNELS_TARGET("avx2")
+    inline size_t expandRGBToRGBA_avx2(const uint8_t* src, uint8_t* dst, size_t pixels, uint8_t alpha)
+    {
+        const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                                 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m256i fill = _mm256_set1_epi32((int)((uint32_t)alpha << 24));
+        size_t i = 0;
+        for (; i + 10 <= pixels; i += 8)
+        {
+            // 4 pixels into each 128-bit lane
+            __m128i lo = _mm_loadu_si128((const __m128i*)(src + i * 3));
+            __m128i hi = _mm_loadu_si128((const __m128i*)(src + i * 3 + 12));
+            __m256i rgb = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+            _mm256_storeu_si256((__m256i*)(dst + i * 4), _mm256_or_si256(_mm256_shuffle_epi8(rgb, shuffle), fill));
+        }
+        return i;
+    }
+
+    IMAGE_KERNELS_TARGET("ssse3")
+    inline size_t packRGBAToRGB_ssse3(const uint8_t* src, uint8_t* dst, size_t pixels)
+    {
+        const __m128i shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+        size_t i = 0;
+        // writes 16 bytes for 4 pixels, stay clear of the end
+        for (; i + 6 <= pixels; i += 4)
+        {
+            __m128i rgba = _mm_loadu_si128((const __m128i*)(src + i * 4));
+            _mm_storeu_si128((__m128i*)(dst + i * 3), _mm_shuffle_epi8(rgba, shuffle));
+        }
+        return i;
+    }
+
+    IMAGE_KERNELS_TARGET("avx2")
+    inline size_t packRGBAToRGB_avx2(const uint8_t* src, uint8_t* dst, size_t pixels)
+    {
+        const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                                 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+        size_t i = 0;
+        for (; i + 10 <= pixels; i += 8)
+        {
+            __m256i rgb = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(src + i * 4)), shuffle);
+            // low lane first, the high lane then overwrites its 4 padding bytes
+            _mm_storeu_si128((__m128i*)(dst + i * 3), _mm256_castsi256_si128(rgb));
+            _mm_storeu_si128((__m128i*)(dst + i * 3 + 12), _mm256_extracti128_si256(rgb, 1));
+        }
+        return i;
+    }
+
+    IMAGE_KERNELS_TARGET("ssse3")
+    inline size_t swizzleRGBA_ssse3(const uint8_t* src, uint8_t* dst, size_t pixels, const int order[4])
+    {
+        alignas(16) int8_t mask[16];
+        for (int p = 0; p < 4; p++)
+            for (int c = 0; c < 4; c++)
+                mask[p * 4 + c] = (int8_t)(p * 4 + order[c]);
+        const __m128i shuffle = _mm_load_si128((const __m128i*)mask);
+        size_t i = 0;
+        for (; i + 4 <= pixels; i += 4)
+            _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(src + i * 4)), shuffle));
+        return i;
+    }
+
+    IMAGE_KERNELS_TARGET("avx2")
+    inline size_t swizzleRGBA_avx2(const uint8_t* src, uint8_t* dst, size_t pixels, const int order[4])
+    {
+        alignas(16) int8_t mask[16];
+        for (int p = 0; p < 4; p++)
+            for (int c = 0; c < 4; c++)
+                mask[p * 4 + c] = (int8_t)(p * 4 + order[c]);
+        const __m256i shuffle = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)mask));
+        size_t i = 0;
+        for (; i + 8 <= pixels; i += 8)
+            _mm256_storeu_si256((__m256i*)(dst + i * 4), _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(src + i * 4)), shuffle));
+        return i;
+    }
+
+    // c * a / 255 rounded, the same formula as the scalar loop: t = c*a + 128, (t + (t >> 8)) >> 8
+    IMAGE_KERNELS_TARGET("ssse3")
+    inline __m128i premultiply4_ssse3(__m128i px)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i bias = _mm_set1_epi16(128);
+        const __m128i alphaShuffle = _mm_setr_epi8(6, 7, 6, 7, 6, 7, 6, 7, 14, 15, 14, 15, 14, 15, 14, 15);
+        __m128i lo = _mm_unpacklo_epi8(px, zero);
+        __m128i hi = _mm_unpackhi_epi8(px, zero);
+        __m128i tlo = _mm_add_epi16(_mm_mullo_epi16(lo, _mm_shuffle_epi8(lo, alphaShuffle)), bias);
+        __m128i thi = _mm_add_epi16(_mm_mullo_epi16(hi, _mm_shuffle_epi8(hi, alphaShuffle)), bias);
+        tlo = _mm_srli_epi16(_mm_add_epi16(tlo, _mm_srli_epi16(tlo, 8)), 8);
+        thi = _mm_srli_epi16(_mm_add_epi16(thi, _mm_srli_epi16(thi, 8)), 8);
+        return _mm_packus_epi16(tlo, thi);
+    }
+
+    IMAGE_KERNELS_TARGET("ssse3")
+    inline size_t premultiplyAlpha_ssse3(uint8_t* rgba, size_t pixels)
+    {
+        const __m128i alphaMask = _mm_set1_epi32((int)0xff000000);
+        size_t i = 0;
+        for (; i + 4 <= pixels; i += 4)
+        {
+            __m128i px = _mm_loadu_si128((const __m128i*)(rgba + i * 4));
+            __m128i result = _mm_or_si128(_mm_andnot_si128(alphaMask, premultiply4_ssse3(px)), _mm_and_si128(alphaMask, px));
+            _mm_storeu_si128((__m128i*)(rgba + i * 4), result);
+        }
+        return i;
+    }
+
+    IMAGE_KERNELS_TARGET("avx2")
+    inline size_t premultiplyAlpha_avx2(uint8_t* rgba, size_t pixels)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i bias = _mm256_set1_epi16(128);
+        const __m256i alphaMask = _mm256_set1_epi32((int)0xff000000);
+        const __m256i alphaShuffle = _mm256_setr_epi8(6, 7, 6, 7, 6, 7, 6, 7, 14, 15, 14, 15, 14, 15, 14, 15,
+                                                      6, 7, 6, 7, 6, 7, 6, 7, 14, 15, 14, 15, 14, 15, 14, 15);
+        size_t i = 0;
+        for (; i + 8 <= pixels; i += 8)
+        {
+            __m256i px = _mm256_loadu_si256((const __m256i*)(rgba + i * 4));
+            __m256i lo = _mm256_unpacklo_epi8(px, zero);
+            __m256i hi = _mm256_unpackhi_epi8(px, zero);
+            __m256i tlo = _mm256_add_epi16(_mm256_mullo_epi16(lo, _mm256_shuffle_epi8(lo, alphaShuffle)), bias);
+            __m256i thi = _mm256_add_epi16(_mm256_mullo_epi16(hi, _mm256_shuffle_epi8(hi, alphaShuffle)), bias);
+            tlo = _mm256_srli_epi16(_mm256_add_epi16(tlo, _mm256_srli_epi16(tlo, 8)), 8);
+            thi = _mm256_srli_epi16(_mm256_add_epi16(thi, _mm256_srli_epi16(thi, 8)), 8);
+            // unpack/pack work per lane, so the pixel order comes back as it was
+            __m256i result = _mm256_packus_epi16(tlo, thi);
+            result = _mm256_or_si256(_mm256_andnot_si256(alphaMask, result), _mm256_and_si256(alphaMask, px));
+            _mm256_storeu_si256((__m256i*)(rgba + i * 4), result);
+        }
+        return i;
+    }
+
+    // 8 values per step through a gather; the alpha lanes index the linear half of the table
+    IMAGE_KERNELS_TARGET("avx2")
+    inline size_t srgbToLinear_avx2(const uint8_t* src, float* dst, size_t count, int channels)
+    {
+        if (channels == 3)
+            return 0;   // the alpha pattern doesn't repeat every 8 values
+        const float* table = srgbToLinearTable();
+        int alpha = alphaChannel(channels);
+        alignas(32) int32_t offsets[8];
+        for (int k = 0; k < 8; k++)
+            offsets[k] = alpha >= 0 && k % channels == alpha ? 256 : 0;
+        const __m256i offset = _mm256_load_si256((const __m256i*)offsets);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i)));
+            _mm256_storeu_ps(dst + i, _mm256_i32gather_ps(table, _mm256_add_epi32(index, offset), 4));
+        }
+        return i;
+    }
+
+    IMAGE_KERNELS_TARGET("avx2")
+    inline size_t linearToSrgb_avx2(const float* src, uint8_t* dst, size_t count, int channels)
+    {
+        if (channels == 3)
+            return 0;
+        const int32_t* table = linearToSrgbTable();
+        int alpha = alphaChannel(channels);
+        alignas(32) int32_t offsets[8];
+        for (int k = 0; k < 8; k++)
+            offsets[k] = alpha >= 0 && k % channels == alpha ? (1 << LINEAR_BITS) : 0;
+        const __m256i offset = _mm256_load_si256((const __m256i*)offsets);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 scale = _mm256_set1_ps((float)LINEAR_STEPS);
+        const __m256 half = _mm256_set1_ps(0.5f);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            // max first so NaN becomes 0
+            __m256 x = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i), zero), one);
+            __m256i index = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(x, scale), half));
+            __m256i value = _mm256_i32gather_epi32((const int*)table, _mm256_add_epi32(index, offset), 4);
+            __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(value), _mm256_extracti128_si256(value, 1));
+            _mm_storel_epi64((__m128i*)(dst + i), _mm_packus_epi16(packed, packed));
+        }
+        return i;
+    }
+
+    IMAGE_KERNELS_TARGET("ssse3")
+    inline void swapRows_ssse3(uint8_t* a, uint8_t* b, size_t bytes)
+    {
+        size_t k = 0;
+        for (; k + 16 <= bytes; k += 16)
+        {
+            __m128i x = _mm_loadu_si128((const __m128i*)(a + k));
+            __m128i y = _mm_loadu_si128((const __m128i*)(b + k));
+            _mm_storeu_si128((__m128i*)(a + k), y);
+            _mm_storeu_si128((__m128i*)(b + k), x);
+        }
+        for (; k < bytes; k++)
+        {
+            uint8_t t = a[k];
+            a[k] = b[k];
+            b[k] = t;
+        }
+    }
+
+    IMAGE_KERNELS_TARGET("avx2")
+    inline void swapRows_avx2(uint8_t* a, uint8_t* b, size_t bytes)
+    {
+        size_t k = 0;
+        for (; k + 32 <= bytes; k += 32)
+        {
+            __m256i x = _mm256_loadu_si256((const __m256i*)(a + k));
+            __m256i y = _mm256_loadu_si256((const __m256i*)(b + k));
+            _mm256_storeu_si256((__m256i*)(a + k), y);
+            _mm256_storeu_si256((__m256i*)(b + k), x);
+        }
+        for (; k < bytes; k++)
+        {
+            uint8_t t = a[k];
+            a[k] = b[k];
+            b[k] = t;
+        }
+    }
+#endif
+
+    inline void swapRows_scalar(uint8_t* a, uint8_t* b, size_t bytes)
+    {
+        uint8_t temp[2048];
+        while (bytes)
+        {
+            size_t chunk = bytes < sizeof(temp) ? bytes : sizeof(temp);
+            memcpy(temp, a, chunk);
+            memcpy(a, b, chunk);
+            memcpy(b, temp, chunk);
+            a += chunk;
+            b += chunk;
+            bytes -= chunk;
+        }
+    }
+}
+
+// Best level the CPU supports, unless lowered with setImageKernelLevel()
+inline int imageKernelLevel()
+{
+    return image_kernels_detail::levelSetting();
+}
+
+// Levels above what the CPU supports are clamped
+inline void setImageKernelLevel(int level)
+{
+    int best = image_kernels_detail::detectLevel();
+    image_kernels_detail::levelSetting() = level < best ? level : best;
+}
+
+// dst gets 4 bytes per pixel with the given alpha
+inline void expandRGBToRGBA(const uint8_t* src, uint8_t* dst, size_t pixels, uint8_t alpha = 255)
+{
+    size_t i = 0;
+#ifdef IMAGE_KERNELS_X86
+    if (imageKernelLevel() >= IMAGE_KERNELS_AVX2)
+        i = image_kernels_detail::expandRGBToRGBA_avx2(src, dst, pixels, alpha);
+    else if (imageKernelLevel() >= IMAGE_KERNELS_SSSE3)
+        i = image_kernels_detail::expandRGBToRGBA_ssse3(src, dst, pixels, alpha);
+#endif
+    for (; i < pixels; i++)
+    {
+        dst[i * 4 + 0] = src[i * 3 + 0];
+        dst[i * 4 + 1] = src[i * 3 + 1];
+        dst[i * 4 + 2] = src[i * 3 + 2];
+        dst[i * 4 + 3] = alpha;
+    }
+}
+
+// Drops the alpha channel
+inline void packRGBAToRGB(const uint8_t* src, uint8_t* dst, size_t pixels)
+{
+    size_t i = 0;
+#ifdef IMAGE_KERNELS_X86
+    if (imageKernelLevel() >= IMAGE_KERNELS_AVX2)
+        i = image_kernels_detail::packRGBAToRGB_avx2(src, dst, pixels);
+    else if (imageKernelLevel() >= IMAGE_KERNELS_SSSE3)
+        i = image_kernels_detail::packRGBAToRGB_ssse3(src, dst, pixels);
+#endif
+    for (; i < pixels; i++)
+    {
+        dst[i * 3 + 0] = src[i * 4 + 0];
+        dst[i * 3 + 1] = src[i * 4 + 1];
+        dst[i * 3 + 2] = src[i * 4 + 2];
+    }
+}
+
+// dst channel c = src channel order[c], e.g. { 2, 1, 0, 3 } swaps RGBA <-> BGRA.
+// src and dst may be the same buffer.
+inline void swizzleRGBA(const uint8_t* src, uint8_t* dst, size_t pixels, const int order[4])
+{
+    size_t i = 0;
+#ifdef IMAGE_KERNELS_X86
+    if (imageKernelLevel() >= IMAGE_KERNELS_AVX2)
+        i = image_kernels_detail::swizzleRGBA_avx2(src, dst, pixels, order);
+    else if (imageKernelLevel() >= IMAGE_KERNELS_SSSE3)
+        i = image_kernels_detail::swizzleRGBA_ssse3(src, dst, pixels, order);
+#endif
+    for (; i < pixels; i++)
+    {
+        uint8_t px[4] = { src[i * 4 + 0], src[i * 4 + 1], src[i * 4 + 2], src[i * 4 + 3] };
+        for (int c = 0; c < 4; c++)
+            dst[i * 4 + c] = px[order[c]];
+    }
+}
+
+// RGB *= A / 255 in place, rounded
+inline void premultiplyAlpha(uint8_t* rgba, size_t pixels)
+{
+    size_t i = 0;
+#ifdef IMAGE_KERNELS_X86
+    if (imageKernelLevel() >= IMAGE_KERNELS_AVX2)
+        i = image_kernels_detail::premultiplyAlpha_avx2(rgba, pixels);
+    else if (imageKernelLevel() >= IMAGE_KERNELS_SSSE3)
+        i = image_kernels_detail::premultiplyAlpha_ssse3(rgba, pixels);
+#endif
+    for (; i < pixels; i++)
+    {
+        uint8_t* px = rgba + i * 4;
+        for (int c = 0; c < 3; c++)
+        {
+            unsigned int t = px[c] * px[3] + 128;
+            px[c] = (uint8_t)((t + (t >> 8)) >> 8);
+        }
+    }
+}
+
+// 8-bit sRGB to linear floats, pixels * channels values. With 2 or 4
+// channels the last one is alpha and is only scaled to 0..1.
+inline void srgbToLinear(const uint8_t* src, float* dst, size_t pixels, int channels)
+{
+    size_t count = pixels * channels, i = 0;
+#ifdef IMAGE_KERNELS_X86
+    if (imageKernelLevel() >= IMAGE_KERNELS_AVX2)
+        i = image_kernels_detail::srgbToLinear_avx2(src, dst, count, channels);
+#endif
+    const float* table = image_kernels_detail::srgbToLinearTable();
+    int alpha = image_kernels_detail::alphaChannel(channels);
+    for (; i < count; i++)
+        dst[i] = table[src[i] + ((int)(i % channels) == alpha ? 256 : 0)];
+}
+
+// Linear floats (clamped to 0..1) back to 8-bit sRGB, alpha as in srgbToLinear.
+// Goes through a 12-bit table, so results can be one step off exact rounding.
+inline void linearToSrgb(const float* src, uint8_t* dst, size_t pixels, int channels)
+{
+    size_t count = pixels * channels, i = 0;
+#ifdef IMAGE_KERNELS_X86
+    if (imageKernelLevel() >= IMAGE_KERNELS_AVX2)
+        i = image_kernels_detail::linearToSrgb_avx2(src, dst, count, channels);
+#endif
+    const int32_t* table = image_kernels_detail::linearToSrgbTable();
+    int alpha = image_kernels_detail::alphaChannel(channels);
+    for (; i < count; i++)
+    {
+        int offset = (int)(i % channels) == alpha ? (1 << image_kernels_detail::LINEAR_BITS) : 0;
+        dst[i] = (uint8_t)table[image_kernels_detail::linearIndex(src[i]) + offset];
+    }
+}
+
+// Flips an image upside down in place
+inline void flipRows(uint8_t* pixels, size_t rowBytes, int rows)
+{
+    for (int top = 0, bottom = rows - 1; top < bottom; top++, bottom--)
+    {
+        uint8_t* a = pixels + rowBytes * top;
+        uint8_t* b = pixels + rowBytes * bottom;
+#ifdef IMAGE_KERNELS_X86
+        if (imageKernelLevel() >= IMAGE_KERNELS_AVX2)
+            image_kernels_detail::swapRows_avx2(a, b, rowBytes);
+        else if (imageKernelLevel() >= IMAGE_KERNELS_SSSE3)
+            image_kernels_detail::swapRows_ssse3(a, b, rowBytes);
+        else
+#endif
+            image_kernels_detail::swapRows_scalar(a, b, rowBytes);
+    }
+}
+
+#endif
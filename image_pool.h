@@ -0,0 +1,193 @@
+#ifndef IMAGE_POOL_H
+#define IMAGE_POOL_H
+
+// Thread-local pooled allocator for image decode buffers.
+//
+// stb_image mallocs a fresh output buffer (plus scratch buffers) per image and
+// frees it right after upload. Routing STBI_MALLOC/REALLOC/FREE here keeps those
+// blocks in per-thread free lists bucketed by power-of-two size, so loading many
+// textures reuses the same few blocks and parallel decoders never contend on the
+// global allocator lock. Wire it up before including stb_image.h:
+//
+//      #include "image_pool.h"
+//      #define STBI_MALLOC(sz)        imagePoolAlloc(sz)
+//      #define STBI_REALLOC(p, newsz) imagePoolRealloc(p, newsz)
+//      #define STBI_FREE(p)           imagePoolFree(p)
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+namespace image_pool_detail
+{
+    const int MIN_SHIFT = 6;                        // 64 byte blocks
+    const int MAX_SHIFT = 28;                       // 256 MB, anything bigger goes straight to malloc
+    const int CLASS_COUNT = MAX_SHIFT - MIN_SHIFT + 1;
+    const size_t HEADER = 16;                       // keeps the returned pointer 16-byte aligned
+    const int UNPOOLED = 0xff;
+
+    // Stored in front of every block so free/realloc know the size class
+    struct Header
+    {
+        uint8_t sizeClass;
+        size_t size;                                // usable bytes
+    };
+    static_assert(sizeof(Header) <= HEADER, "image pool header too big");
+
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    struct ThreadPool
+    {
+        FreeBlock* freeLists[CLASS_COUNT] = {};
+        size_t retainedBytes = 0;
+        size_t retainLimit = 128u * 1024 * 1024;    // beyond this, freed blocks go back to the heap
+        size_t hits = 0, misses = 0;
+
+        ~ThreadPool()
+        {
+            for (int c = 0; c < CLASS_COUNT; c++)
+                while (freeLists[c])
+                {
+                    FreeBlock* block = freeLists[c];
+                    freeLists[c] = block->next;
+                    free((unsigned char*)block - HEADER);
+                }
+        }
+    };
+
+    inline ThreadPool& threadPool()
+    {
+        thread_local ThreadPool pool;
+        return pool;
+    }
+
+    inline int sizeClass(size_t size)
+    {
+        int shift = MIN_SHIFT;
+        while (shift <= MAX_SHIFT && ((size_t)1 << shift) < size)
+            shift++;
+        return shift > MAX_SHIFT ? UNPOOLED : shift - MIN_SHIFT;
+    }
+
+    inline Header* header(void* p)
+    {
+        return (Header*)((unsigned char*)p - HEADER);
+    }
+}
+
+inline void* imagePoolAlloc(size_t size)
+{
+    using namespace image_pool_detail;
+    ThreadPool& pool = threadPool();
+    int c = sizeClass(size);
+    if (c != UNPOOLED && pool.freeLists[c])
+    {
+        FreeBlock* block = pool.freeLists[c];
+        pool.freeLists[c] = block->next;
+        pool.retainedBytes -= (size_t)1 << (c + MIN_SHIFT);
+        pool.hits++;
+        return block;
+    }
+    pool.misses++;
+    size_t capacity = c == UNPOOLED ? size : (size_t)1 << (c + MIN_SHIFT);
+    unsigned char* raw = (unsigned char*)malloc(capacity + HEADER);
+    if (!raw)
+        return NULL;
+    Header* h = (Header*)raw;
+    h->sizeClass = (uint8_t)c;
+    h->size = capacity;
+    return raw + HEADER;
+}
+
+// Blocks may be freed on any thread, they join that thread's pool
+inline void imagePoolFree(void* p)
+{
+    using namespace image_pool_detail;
+    if (!p)
+        return;
+    Header* h = header(p);
+    ThreadPool& pool = threadPool();
+    size_t capacity = h->size;
+    if (h->sizeClass == UNPOOLED || pool.retainedBytes + capacity > pool.retainLimit)
+    {
+        free(h);
+        return;
+    }
+    FreeBlock* block = (FreeBlock*)p;
+    block->next = pool.freeLists[h->sizeClass];
+    pool.freeLists[h->sizeClass] = block;
+    pool.retainedBytes += capacity;
+}
+
+inline void* imagePoolRealloc(void* p, size_t size)
+{
+    using namespace image_pool_detail;
+    if (!p)
+        return imagePoolAlloc(size);
+    Header* h = header(p);
+    if (size <= h->size)
+        return p;           // still fits in the bucket
+    void* grown = imagePoolAlloc(size);
+    if (!grown)
+        return NULL;
+    memcpy(grown, p, h->size);
+    imagePoolFree(p);
+    return grown;
+}
+
+// Pre-fills the calling thread's pool with blocks for count images of the given
+// size, e.g. before a loader thread starts decoding a batch of textures. The pool
+// only keeps up to its retainLimit, so that caps count (and sizes over 256 MB
+// aren't pooled at all). Returns how many blocks of that size the pool holds
+// for it, fewer than count if the limit or the heap ran out
+inline int imagePoolReserve(int width, int height, int channels, int count)
+{
+    using namespace image_pool_detail;
+    size_t size = (size_t)width * height * channels;
+    if (size < sizeof(void*))
+        size = sizeof(void*);
+    int c = sizeClass(size);
+    if (c == UNPOOLED)
+        return 0;
+    // blocks already free in this class come back, the rest have to fit under the limit
+    ThreadPool& pool = threadPool();
+    size_t capacity = (size_t)1 << (c + MIN_SHIFT);
+    size_t fits = pool.retainedBytes < pool.retainLimit ? (pool.retainLimit - pool.retainedBytes) / capacity : 0;
+    for (FreeBlock* block = pool.freeLists[c]; block; block = block->next)
+        fits++;
+    if ((size_t)count > fits)
+        count = (int)fits;
+    // the blocks hold the list of themselves until they're all allocated
+    void* blocks = NULL;
+    int reserved = 0;
+    for (; reserved < count; reserved++)
+    {
+        void* block = imagePoolAlloc(size);
+        if (!block)
+            break;
+        *(void**)block = blocks;
+        blocks = block;
+    }
+    while (blocks)
+    {
+        void* next = *(void**)blocks;
+        imagePoolFree(blocks);
+        blocks = next;
+    }
+    return reserved;
+}
+
+// Calling thread's pool: blocks reused vs. fresh heap allocations
+inline void imagePoolStats(size_t* hits, size_t* misses, size_t* retainedBytes)
+{
+    image_pool_detail::ThreadPool& pool = image_pool_detail::threadPool();
+    if (hits) *hits = pool.hits;
+    if (misses) *misses = pool.misses;
+    if (retainedBytes) *retainedBytes = pool.retainedBytes;
+}
+
+#endif
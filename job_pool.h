@@ -0,0 +1,192 @@
+#ifndef JOB_POOL_H
+#define JOB_POOL_H
+
+// Small fixed-size thread pool for CPU work that splits into independent pieces
+// (image decoding, mip generation, ...).
+//
+// parallelFor(count, fn) runs fn(0) .. fn(count - 1) and returns when all of
+// them are done. The calling thread takes indices too, so it also works (just
+// serially) with zero worker threads and never deadlocks when called from
+// inside a job.
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <deque>
+#include <vector>
+#include <algorithm>
+
+class JobPool
+{
+public:
+    // threadCount workers besides the calling thread, default is one per extra core
+    explicit JobPool(int threadCount = -1)
+    {
+        if (threadCount < 0)
+        {
+            int cores = (int)std::thread::hardware_concurrency();
+            threadCount = cores > 1 ? cores - 1 : 0;
+        }
+        for (int i = 0; i < threadCount; i++)
+            workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~JobPool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    JobPool(const JobPool&) = delete;
+    JobPool& operator=(const JobPool&) = delete;
+
+    // Process-wide pool, created on first use
+    static JobPool& shared()
+    {
+        static JobPool pool;
+        return pool;
+    }
+
+    int threadCount() const { return (int)workers.size(); }
+
+    // Fire-and-forget job, use waitIdle() to wait for all of them
+    void submit(std::function<void()> job)
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            queue.push_back(std::move(job));
+            pending++;
+        }
+        wake.notify_one();
+    }
+
+    void waitIdle()
+    {
+        // help out instead of just sleeping
+        while (runOne())
+            ;
+        std::unique_lock<std::mutex> guard(lock);
+        idle.wait(guard, [this] { return pending == 0; });
+    }
+
+    template <typename Fn>
+    void parallelFor(int count, Fn&& fn)
+    {
+        if (count <= 0)
+            return;
+        if (count == 1 || workers.empty())
+        {
+            for (int i = 0; i < count; i++)
+                fn(i);
+            return;
+        }
+
+        // every helper grabs indices from a shared counter until none are left
+        struct Batch
+        {
+            std::atomic<int> next{ 0 };
+            int exited = 0;
+            std::mutex lock;
+            std::condition_variable finished;
+        } batch;
+        auto drain = [&batch, &fn, count]
+        {
+            for (int i = batch.next.fetch_add(1); i < count; i = batch.next.fetch_add(1))
+                fn(i);
+        };
+
+        int helpers = std::min((int)workers.size(), count - 1);
+        for (int i = 0; i < helpers; i++)
+            submit([&batch, &drain]
+            {
+                drain();
+                std::lock_guard<std::mutex> guard(batch.lock);
+                batch.exited++;
+                batch.finished.notify_all();
+            });
+        drain();
+
+        // the batch lives on this stack, so wait until every helper has left
+        // it, even ones still queued that will find no work. running queued
+        // jobs here keeps nested parallelFor calls from deadlocking
+        for (;;)
+        {
+            {
+                std::lock_guard<std::mutex> guard(batch.lock);
+                if (batch.exited == helpers)
+                    return;
+            }
+            if (!runOne())
+            {
+                std::unique_lock<std::mutex> guard(batch.lock);
+                batch.finished.wait(guard, [&batch, helpers] { return batch.exited == helpers; });
+                return;
+            }
+        }
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> queue;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    int pending = 0;            // queued + running jobs
+    bool stopping = false;
+
+    bool runOne()
+    {
+        std::function<void()> job;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (queue.empty())
+                return false;
+            job = std::move(queue.front());
+            queue.pop_front();
+        }
+        job();
+        finishJob();
+        return true;
+    }
+
+    void finishJob()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (--pending == 0)
+            idle.notify_all();
+    }
+
+    void workerLoop()
+    {
+        for (;;)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                wake.wait(guard, [this] { return stopping || !queue.empty(); });
+                if (queue.empty())
+                    return;
+                job = std::move(queue.front());
+                queue.pop_front();
+            }
+            job();
+            finishJob();
+        }
+    }
+};
+
+// Adapter for stb_image's parallel hook:
+//      stbi_set_parallel_for(jobPoolParallelFor, &JobPool::shared());
+inline void jobPoolParallelFor(void* user, int count, void (*task)(void*, int), void* arg)
+{
+    static_cast<JobPool*>(user)->parallelFor(count, [task, arg](int i) { task(arg, i); });
+}
+
+#endif
@@ -0,0 +1,178 @@
+#ifndef LZ4_BLOCK_H
+#define LZ4_BLOCK_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// LZ4 block format (no frame header or checksums), the output of
+// LZ4_compress_default and input of LZ4_decompress_safe. Greedy single-probe
+// matching: ratio is close to lz4's fast mode, decoding is what matters here.
+
+namespace lz4_detail
+{
+    const int MIN_MATCH = 4;
+    const size_t LAST_LITERALS = 5;     // a block always ends in at least this many literals
+    const size_t MF_LIMIT = 12;         // no match may start this close to the end
+    const size_t MAX_OFFSET = 65535;
+    const int HASH_BITS = 14;
+
+    inline uint32_t read32(const uint8_t* p) { uint32_t v; memcpy(&v, p, 4); return v; }
+
+    inline uint32_t hash4(uint32_t sequence)
+    {
+        return (sequence * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    // 15 in the token, then 255s, then the rest
+    inline void writeLength(std::vector<uint8_t>& out, size_t length)
+    {
+        for (length -= 15; length >= 255; length -= 255)
+            out.push_back(255);
+        out.push_back((uint8_t)length);
+    }
+
+    inline void writeSequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t literalCount, size_t offset, size_t matchLength)
+    {
+        size_t matchCode = matchLength ? matchLength - MIN_MATCH : 0;
+        out.push_back((uint8_t)(((literalCount < 15 ? literalCount : 15) << 4) | (matchCode < 15 ? matchCode : 15)));
+        if (literalCount >= 15)
+            writeLength(out, literalCount);
+        out.insert(out.end(), literals, literals + literalCount);
+        if (!matchLength)
+            return;     // the last sequence has no match
+        out.push_back((uint8_t)offset);
+        out.push_back((uint8_t)(offset >> 8));
+        if (matchCode >= 15)
+            writeLength(out, matchCode);
+    }
+}
+
+// Compresses 'size' bytes, replacing 'out'. Can come out bigger than the input
+// for data that doesn't compress (at most size + size / 255 + 16).
+inline void lz4Compress(const uint8_t* src, size_t size, std::vector<uint8_t>& out)
+{
+    using namespace lz4_detail;
+    out.clear();
+    out.reserve(size + size / 255 + 16);
+    size_t anchor = 0;
+    if (size > MF_LIMIT)
+    {
+        std::vector<uint32_t> table((size_t)1 << HASH_BITS, 0);    // position + 1, 0 is empty
+        size_t matchEnd = size - LAST_LITERALS;
+        size_t i = 0;
+        while (i < size - MF_LIMIT)
+        {
+            uint32_t sequence = read32(src + i);
+            uint32_t& slot = table[hash4(sequence)];
+            size_t candidate = slot;
+            slot = (uint32_t)(i + 1);
+            if (!candidate || i - (candidate - 1) > MAX_OFFSET || read32(src + candidate - 1) != sequence)
+            {
+                // skip faster through data that doesn't match
+                i += 1 + ((i - anchor) >> 6);
+                continue;
+            }
+            size_t ref = candidate - 1;
+            size_t length = MIN_MATCH;
+            while (i + length < matchEnd && src[ref + length] == src[i + length])
+                length++;
+            writeSequence(out, src + anchor, i - anchor, i - ref, length);
+            i += length;
+            anchor = i;
+            if (i < size - MF_LIMIT)
+                table[hash4(read32(src + i - 2))] = (uint32_t)(i - 2 + 1);
+        }
+    }
+    writeSequence(out, src + anchor, size - anchor, 0, 0);
+}
+
+// The most a 'srcSize' byte block can expand to: no sequence gives more than
+// 255 bytes per byte of input (a match length byte of 255)
+inline uint64_t lz4MaxDecompressedSize(uint64_t srcSize)
+{
+    return srcSize * 255;
+}
+
+// Decompresses a block that expands to exactly 'size' bytes into 'dest'.
+// Returns false on malformed input instead of reading or writing out of bounds.
+inline bool lz4Decompress(const uint8_t* src, size_t srcSize, uint8_t* dest, size_t size)
+{
+    const uint8_t* in = src;
+    const uint8_t* inEnd = src + srcSize;
+    size_t out = 0;
+    while (in < inEnd)
+    {
+        unsigned token = *in++;
+        size_t literals = token >> 4;
+        if (literals == 15)
+        {
+            uint8_t more;
+            do
+            {
+                if (in >= inEnd)
+                    return false;
+                more = *in++;
+                literals += more;
+            } while (more == 255);
+        }
+        if (literals > (size_t)(inEnd - in) || literals > size - out)
+            return false;
+        // short runs as one fixed 16 byte copy when both sides have the room,
+        // what's written past the run is overwritten next
+        if (literals <= 16 && inEnd - in >= 16 && size - out >= 16)
+            memcpy(dest + out, in, 16);
+        else if (literals)
+            memcpy(dest + out, in, literals);   // dest may be NULL for an empty block
+        in += literals;
+        out += literals;
+        if (in == inEnd)
+            break;      // last sequence, literals only
+
+        if (inEnd - in < 2)
+            return false;
+        size_t offset = in[0] | ((size_t)in[1] << 8);
+        in += 2;
+        size_t length = token & 15;
+        if (length == 15)
+        {
+            uint8_t more;
+            do
+            {
+                if (in >= inEnd)
+                    return false;
+                more = *in++;
+                length += more;
+            } while (more == 255);
+        }
+        length += lz4_detail::MIN_MATCH;
+        if (!offset || offset > out || length > size - out)
+            return false;
+        const uint8_t* from = dest + out - offset;
+        if (offset >= 16 && size - out >= length + 15)
+        {
+            // whole 16 byte chunks, each one's source was written before it
+            for (size_t done = 0; done < length; done += 16)
+                memcpy(dest + out + done, from + done, 16);
+        }
+        else if (offset >= length)
+            memcpy(dest + out, from, length);
+        else
+        {
+            // overlaps what it writes (runs, e.g. a repeated pixel): the pattern
+            // from 'from' doubles with every copy and never overlaps the next one
+            size_t done = 0, period = offset;
+            while (done < length)
+            {
+                size_t count = period < length - done ? period : length - done;
+                memcpy(dest + out + done, from, count);
+                done += count;
+                period = offset + done;
+            }
+        }
+        out += length;
+    }
+    return out == size;
+}
+
+#endif
@@ -4,10 +4,32 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+// route stb_image's decode buffers through the thread-local image pool
+#include "image_pool.h"
+#define STBI_MALLOC(sz) imagePoolAlloc(sz)
+#define STBI_REALLOC(p, newsz) imagePoolRealloc(p, newsz)
+#define STBI_FREE(p) imagePoolFree(p)
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
+#include "job_pool.h"
+#include "texture.h"
+#include "texture_array.h"
+#include "texture_streaming.h"
+#include "atlas.h"
 
 #include "shader_s.h"
+#include "shader_reload.h"
+#include "shader_cache.h"
+#include "shader_uniforms.h"
+#include "mesh_simplify.h"
+#include "meshlet.h"
+#include "gl_ext.h"
+#include "gl_state_cache.h"
+#include "sampler_cache.h"
+#include "stream_buffer.h"
+#define FRAME_ARENA_TRACK_HEAP
+#define FRAME_ARENA_IMPLEMENTATION
+#include "frame_arena.h"
 
 #include <iostream>
 
@@ -20,6 +42,9 @@ const unsigned int SCR_HEIGHT = 600;
 
 float mixValue = 0.2f;
 
+// the PerDraw block's std140 layout, generated from the shader (shader_uniforms.h)
+const GLsizeiptr PER_DRAW_SIZE = sizeof(PerDrawBlock);
+
 int main()
 {
     glfwInit();
@@ -56,8 +81,20 @@ int main()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    loadGLExtensions((GLADloadproc)glfwGetProcAddress);
+
+    // shaders and images come from assets.pak when there is one, mapped once, with
+    // the loose files as fallback; `make` repacks it, so edits don't start stale
+    PakArchive assets;
+    if (assets.open("assets.pak"))
+        mountPak(assets);
 
-    Shader ourShader("./Shaders/shader.vs", "./Shaders/shader.fs");
+    // one program per variant (ShaderDefines), "NO_STICKERS" would leave the atlas image out
+    ShaderCache shaders;
+    Shader& ourShader = shaders.get("./Shaders/shader.vs", "./Shaders/shader.fs");
+    // saving a shader source recompiles it in the background, the old program draws until the new one links
+    ShaderReloader shaderReloader;
+    shaderReloader.add(ourShader);
 
     // Enable depth buffering
     glEnable(GL_DEPTH_TEST);
@@ -120,6 +157,21 @@ int main()
 		glm::vec3(-1.3f,  1.0f, -1.5f)  
     };
 
+    // Weld the cube into an indexed mesh and build its LOD chain (levels share the vertex buffer)
+    Mesh cubeMesh = buildIndexedMesh(vertices, sizeof(vertices) / (5 * sizeof(float)), 5);
+    LodChain cubeLods = buildLodChain(cubeMesh);
+    // Split every LOD range into meshlets so clusters can be culled individually
+    // (lodFirstMeshlet[i]..lodFirstMeshlet[i + 1] are the meshlets of level i)
+    std::vector<Meshlet> cubeMeshlets;
+    std::vector<unsigned int> lodFirstMeshlet;
+    for (const LodLevel& level : cubeLods.levels)
+    {
+        lodFirstMeshlet.push_back((unsigned int)cubeMeshlets.size());
+        std::vector<Meshlet> levelMeshlets = buildMeshlets(cubeMesh, cubeLods.indices, level.indexOffset, level.indexCount);
+        cubeMeshlets.insert(cubeMeshlets.end(), levelMeshlets.begin(), levelMeshlets.end());
+    }
+    lodFirstMeshlet.push_back((unsigned int)cubeMeshlets.size());
+
     /** VERTEX BUFFER OBJECT AND VERTEX ARRAY OBJECT **/
     unsigned int VBO, VAO, EBO;   // Vertex buffer object
     glGenVertexArrays(1, &VAO);   // Give VAO unique buffer ID
@@ -132,7 +184,10 @@ int main()
     // Bind new buffer and make all buffer calls on GL_ARRAY_BUFFER apply to VBO)
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     // Copy prev. defined vertices data into VBO and choose gpu draw method
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, cubeMesh.vertices.size() * sizeof(float), cubeMesh.vertices.data(), GL_STATIC_DRAW);
+    // All LOD index ranges go into one element buffer (EBO binding is stored in the VAO)
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, cubeLods.indices.size() * sizeof(unsigned int), cubeLods.indices.data(), GL_STATIC_DRAW);
 
     /** LINKING VERTEX ATTRIBUTES **/
     // position attribute
@@ -144,72 +199,69 @@ int main()
 
 
     // LOAD TEXTURES:
-    // TEXTURE 1
-    unsigned int texture1, texture2;
-    glGenTextures(1, &texture1);
-    glBindTexture(GL_TEXTURE_2D, texture1);
-    // set texture wrapping/filtering options (on currently bound texture argument)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    // set texture filtering parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    // load image, create texture, and generate mipmaps
-    int width, height, nrChannels;
     stbi_set_flip_vertically_on_load(true); // tell stb_image.h to flip loaded texture's on y-axis
-    unsigned char *data = stbi_load(("assets/container.jpeg"), &width, &height, &nrChannels, 0);
-    if (data)
-    {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else
-        std::cout << "Failed to load texture 1" << std::endl;
-    stbi_image_free(data);
-
-    // TEXTURE 2
-    glGenTextures(1, &texture2);
-    glBindTexture(GL_TEXTURE_2D, texture2);
-    // texture wrapping/filtering options
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // texture filtering parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    data = stbi_load(("assets/mario.png"), &width, &height, &nrChannels, 0);
-    if (data)
-    {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else
-        std::cout << "Failed to load texture 2" << std::endl;
-    stbi_image_free(data);
+    stbi_set_parallel_for(jobPoolParallelFor, &JobPool::shared()); // decode JPEGs on all cores
+    // the box textures have the same size and format, so they become layers of one array
+    // texture and every box picks its layer with no rebinding. the array streams in while
+    // rendering: a grey placeholder first, then mip levels down to what the boxes on screen need
+    TextureStreamer textures;
+    TextureParams boxParams;
+    boxParams.wrap = GL_CLAMP_TO_EDGE;
+    int boxTextures = textures.addArray({ "assets/container.jpeg", "assets/wall.jpeg" }, boxParams);
+    if (!textures.start())
+        std::cout << "Failed to load textures" << std::endl;
+    // the images mixed on top share one atlas, every box picks one through its uv rect
+    AtlasBuilder atlas;
+    int stickers[] = { atlas.add("assets/mario.png"), atlas.add("assets/awesomeface.png") };
+    if (!atlas.build())
+        std::cout << "Failed to build texture atlas" << std::endl;
+    atlas.upload();
+    // filtering and wrapping come from sampler objects bound per unit, not from the textures
+    SamplerDesc boxSampling(GL_CLAMP_TO_EDGE, GL_LINEAR, GL_LINEAR);
+    SamplerDesc stickerSampling(GL_CLAMP_TO_EDGE);     // trilinear over the atlas mips
+    stickerSampling.anisotropy = 8.0f;
+    GLuint boxSampler = SamplerCache::shared().get(boxSampling);
+    GLuint stickerSampler = SamplerCache::shared().get(stickerSampling);
 
 
     /** DEBUG: WIREFRAME MODE **/
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
-    // tell OpenGL which texture unit each shader belongs to
-    ourShader.use();       
-    ourShader.setInt("texture1", 0);
-    ourShader.setInt("texture2", 1);
+    // the shader's uniforms as a struct generated from it, sent only when they change
+    BoxUniforms boxUniforms;
+    // tell OpenGL which texture unit each sampler belongs to
+    boxUniforms.setTexture1(0);
+    boxUniforms.setTexture2(1);
+
+    // visible index ranges of one object, reused every draw to avoid reallocating
+    MeshletDrawList drawList;
+
+    // per-draw transforms are streamed through a ring buffer bound as the PerDraw uniform block
+    GLint uniformAlignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+    StreamBuffer perDrawBuffer(GL_UNIFORM_BUFFER, 64 * 1024);
+    ourShader.setBlockBinding("PerDraw", 0);
+
+    const unsigned int cubeCount = sizeof(cubePositions) / sizeof(cubePositions[0]);
+    // steady state should not touch the heap, warn if a frame after warm-up does
+    unsigned int frameCount = 0;
+    uint64_t heapAllocations = heapAllocationCount();
 
     // RENDER LOOP (single buffer (use double buffer to avoid artifacting))
     while (!glfwWindowShouldClose(window))
     {
         // input
         processInput(window);
+        shaderReloader.update();
 
         // rendering commands
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);  // Clear color buffer
 
-        // bind textures
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture1);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, texture2);
+        // bind textures and samplers (atlas pages are bound per draw, the state cache drops repeats)
+        glState().bindTexture(0, GL_TEXTURE_2D_ARRAY, textures.id(boxTextures));
+        glState().bindSampler(0, boxSampler);
+        glState().bindSampler(1, stickerSampler);
 
         ourShader.use();
 
@@ -218,36 +270,103 @@ int main()
         glm::mat4 projection = glm::mat4(1.0f);
         glm::mat4 view = glm::mat4(1.0f);
         // create view/projection transformations
-        view = glm::translate(view, glm::vec3(0.0, 0.0f, -3.0f));
-        projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        // set projection matrix each frame (unneeded if static)
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
+        glm::vec3 cameraPos = glm::vec3(0.0f, 0.0f, 3.0f);
+        const float fov = glm::radians(45.0f);
+        view = glm::translate(view, -cameraPos);
+        projection = glm::perspective(fov, (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+        // pixels per world unit at distance 1 (used to project LOD errors to the screen)
+        const float projectionScale = (float)SCR_HEIGHT / (2.0f * tanf(fov * 0.5f));
+        Frustum frustum = extractFrustum(projection * view);
+        // projection and view only go to GL when they change
+        boxUniforms.setProjection(projection);
+        boxUniforms.setView(view);
 
         // mix value (opacity of image)
-        ourShader.setFloat("mixValue", mixValue);
+        boxUniforms.setMixValue(mixValue);
+        boxUniforms.upload(ourShader);
 
 
-        // render boxes
-        glBindVertexArray(VAO);
-        for (unsigned i = 0; i < 10; i++)
+        // write every box's transform into this frame's region of the ring buffer first,
+        // so the fallback (non-persistent) path only needs one upload per frame
+        perDrawBuffer.beginFrame();
+        // per-frame arrays come from the frame arena, they are gone after resetFrameArenas()
+        glm::mat4* models = frameArena().allocateArray<glm::mat4>(cubeCount);
+        GLintptr* perDrawOffsets = frameArena().allocateArray<GLintptr>(cubeCount);
+        for (unsigned i = 0; i < cubeCount; i++)
         {
             glm::mat4 model = glm::mat4(1.0f);
             model = glm::translate(model, cubePositions[i]);
             float angle = 20.0f * i + 20;
             model = glm::rotate(model, ((float)glfwGetTime() * glm::radians(angle)), glm::vec3(1.0f, 0.3f, 0.5f));
-            ourShader.setMat4("model", model);
+            models[i] = model;
+
+            // PerDraw block: model matrix, then the atlas uv rect
+            const AtlasEntry& sticker = atlas.entry(stickers[i % 2]);
+            StreamBuffer::Allocation perDraw = perDrawBuffer.allocate(PER_DRAW_SIZE, uniformAlignment);
+            if (!perDraw.ptr)
+            {
+                perDrawOffsets[i] = -1;     // the frame's region is full, this box isn't drawn
+                continue;
+            }
+            PerDrawBlock* block = (PerDrawBlock*)perDraw.ptr;
+            block->model = model;
+            block->uvRect = glm::vec4(sticker.uvRect[0], sticker.uvRect[1], sticker.uvRect[2], sticker.uvRect[3]);
+            perDrawOffsets[i] = perDraw.offset;
+        }
+        perDrawBuffer.flush();
 
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+        // render boxes
+        glState().bindVertexArray(VAO);
+        for (unsigned i = 0; i < cubeCount; i++)
+        {
+            if (perDrawOffsets[i] < 0)
+                continue;
+            glBindBufferRange(GL_UNIFORM_BUFFER, 0, perDrawBuffer.ID, perDrawOffsets[i], PER_DRAW_SIZE);
+            setDrawLayer(2, (i / 2) % 2);
+            int page = atlas.entry(stickers[i % 2]).page;
+            if (page >= 0)
+                glState().bindTexture(1, GL_TEXTURE_2D, atlas.id(page));
+
+            // pick the coarsest LOD that stays within a pixel of the full mesh
+            float distance = glm::length(cubePositions[i] + cubeLods.center - cameraPos);
+            unsigned int lod = selectLod(cubeLods, distance, projectionScale);
+
+            // drop off-screen and back-facing clusters, draw what's left in as few ranges as possible
+            drawList.clear();
+            cullMeshlets(cubeMeshlets, lodFirstMeshlet[lod], lodFirstMeshlet[lod + 1] - lodFirstMeshlet[lod],
+                         frustum, models[i], cameraPos, drawList);
+            if (!drawList.counts.empty())
+            {
+                glMultiDrawElements(GL_TRIANGLES, drawList.counts.data(), GL_UNSIGNED_INT, drawList.offsets.data(), (GLsizei)drawList.counts.size());
+                // a box face is one world unit across and shows the whole texture
+                textures.request(boxTextures, TextureStreamer::mipLevelFor(textures.info(boxTextures).width, 1.0f, distance, projectionScale));
+            }
         }
+        perDrawBuffer.endFrame();
+        // stream in the texture levels asked for above, within this frame's upload budget
+        textures.update();
+        glState().invalidate();     // update() binds the textures it uploads to
 
         glfwSwapBuffers(window);    // Swap color buffer to that's used to render and show it as output
         glfwPollEvents();           // Check if any events are triggered (inputs)
+
+        // end of frame: release transient memory and check for stray heap allocations
+        resetFrameArenas();
+        uint64_t allocations = heapAllocationCount();
+        if (++frameCount > 3 && !textures.busy() && allocations != heapAllocations)
+            std::cout << "WARNING::FRAME::HEAP_ALLOCATIONS " << (allocations - heapAllocations) << " in frame " << frameCount << std::endl;
+        heapAllocations = heapAllocationCount();
     }
 
     // De-allocate resources (optional but good practice)
     glDeleteVertexArrays(1, &VAO);
     glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    perDrawBuffer.destroy();
+    textures.destroy();
+    atlas.destroy();
+    SamplerCache::shared().destroy();
+    shaders.destroy();
 
     glfwTerminate(); // Deletes GLFW's resources that were allocated
     return 0;
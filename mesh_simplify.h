@@ -0,0 +1,347 @@
+#ifndef MESH_SIMPLIFY_H
+#define MESH_SIMPLIFY_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <map>
+#include <tuple>
+#include <cmath>
+#include <algorithm>
+
+// Interleaved vertex data (position xyz first, then any other float attributes
+// such as texture coords) plus an index buffer of triangles
+struct Mesh
+{
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    unsigned int stride = 0;    // floats per vertex
+
+    size_t vertexCount() const { return stride ? vertices.size() / stride : 0; }
+    glm::vec3 position(unsigned int v) const
+    {
+        return glm::vec3(vertices[v * stride + 0], vertices[v * stride + 1], vertices[v * stride + 2]);
+    }
+};
+
+// One level of detail: a range inside LodChain::indices
+struct LodLevel
+{
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    float error;                // object-space deviation from the full-detail mesh
+};
+
+// All levels share the vertex buffer of the source mesh, only the index ranges differ
+struct LodChain
+{
+    std::vector<unsigned int> indices;
+    std::vector<LodLevel> levels;
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;        // bounding sphere around all vertices
+};
+
+struct SimplifyOptions
+{
+    // how much one unit of attribute change (e.g. a texture coord moving by 1.0)
+    // counts against one unit of positional error
+    float attributeWeight = 1.0f;
+    // largest object-space error a collapse may introduce
+    float maxError = 1e30f;
+};
+
+// Welds identical vertices of a non-indexed vertex array (like the cube in main.cpp)
+inline Mesh buildIndexedMesh(const float* vertices, size_t vertexCount, unsigned int stride)
+{
+    Mesh mesh;
+    mesh.stride = stride;
+    std::map<std::vector<float>, unsigned int> unique;
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        std::vector<float> key(vertices + i * stride, vertices + (i + 1) * stride);
+        auto it = unique.find(key);
+        if (it == unique.end())
+        {
+            unsigned int index = (unsigned int)(mesh.vertices.size() / stride);
+            mesh.vertices.insert(mesh.vertices.end(), key.begin(), key.end());
+            it = unique.emplace(key, index).first;
+        }
+        mesh.indices.push_back(it->second);
+    }
+    return mesh;
+}
+
+namespace simplify_detail
+{
+    // Symmetric 4x4 plane quadric (Garland & Heckbert), w is the summed triangle area
+    // so evaluate() returns an area-averaged squared distance
+    struct Quadric
+    {
+        double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+        double a11 = 0, a12 = 0, a13 = 0;
+        double a22 = 0, a23 = 0;
+        double a33 = 0;
+        double w = 0;
+
+        void addPlane(const glm::vec3& n, double d, double weight)
+        {
+            a00 += weight * n.x * n.x; a01 += weight * n.x * n.y; a02 += weight * n.x * n.z; a03 += weight * n.x * d;
+            a11 += weight * n.y * n.y; a12 += weight * n.y * n.z; a13 += weight * n.y * d;
+            a22 += weight * n.z * n.z; a23 += weight * n.z * d;
+            a33 += weight * d * d;
+            w += weight;
+        }
+        void add(const Quadric& q)
+        {
+            a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+            a11 += q.a11; a12 += q.a12; a13 += q.a13;
+            a22 += q.a22; a23 += q.a23;
+            a33 += q.a33;
+            w += q.w;
+        }
+        double evaluate(const glm::vec3& p) const
+        {
+            double x = p.x, y = p.y, z = p.z;
+            double e = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x
+                     + a11 * y * y + 2 * a12 * y * z + 2 * a13 * y
+                     + a22 * z * z + 2 * a23 * z
+                     + a33;
+            return w > 0 ? std::fabs(e) / w : 0.0;
+        }
+    };
+
+    struct Collapse
+    {
+        unsigned int from, to;
+        double cost;
+        bool operator<(const Collapse& other) const { return cost < other.cost; }
+    };
+}
+
+// Quadric-error edge-collapse simplification. Uses half-edge collapses (a vertex moves
+// onto one of its neighbours) so the vertex buffer never changes and every LOD can share
+// it. Attribute seams (same position, different texture coords) and open borders are
+// locked so textures don't tear; inside a chart the attribute difference is added to
+// the collapse cost. Returns the new index buffer, *outError gets the object-space error.
+inline std::vector<unsigned int> simplifyMesh(const Mesh& mesh, const std::vector<unsigned int>& source,
+                                              size_t targetIndexCount, const SimplifyOptions& options = SimplifyOptions(),
+                                              float* outError = NULL)
+{
+    using namespace simplify_detail;
+
+    const size_t vertexCount = mesh.vertexCount();
+    std::vector<unsigned int> indices = source;
+
+    // 1. Group vertices that share a position (wedges of the same corner)
+    std::vector<unsigned int> posId(vertexCount);
+    std::vector<unsigned int> wedges(vertexCount, 0);
+    std::map<std::tuple<float, float, float>, unsigned int> positions;
+    for (unsigned int v = 0; v < vertexCount; v++)
+    {
+        glm::vec3 p = mesh.position(v);
+        auto it = positions.emplace(std::make_tuple(p.x, p.y, p.z), v).first;
+        posId[v] = it->second;
+        wedges[posId[v]]++;
+    }
+
+    // 2. Lock seam and border vertices (a border edge has no opposite half-edge)
+    std::map<std::pair<unsigned int, unsigned int>, int> halfEdges;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        for (int e = 0; e < 3; e++)
+            halfEdges[std::make_pair(posId[indices[i + e]], posId[indices[i + (e + 1) % 3]])]++;
+    std::vector<bool> locked(vertexCount, false);
+    for (const auto& edge : halfEdges)
+        if (halfEdges.find(std::make_pair(edge.first.second, edge.first.first)) == halfEdges.end())
+            locked[edge.first.first] = locked[edge.first.second] = true;
+    for (unsigned int v = 0; v < vertexCount; v++)
+        locked[v] = locked[posId[v]] || wedges[posId[v]] > 1;
+
+    // 3. Accumulate one quadric per position from its incident triangle planes
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        glm::vec3 p0 = mesh.position(indices[i]), p1 = mesh.position(indices[i + 1]), p2 = mesh.position(indices[i + 2]);
+        glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+        float area = glm::length(n);
+        if (area <= 0.0f)
+            continue;
+        n = n / area;
+        for (int c = 0; c < 3; c++)
+            quadrics[posId[indices[i + c]]].addPlane(n, -glm::dot(n, p0), area * 0.5);
+    }
+
+    auto attributeDistance = [&](unsigned int a, unsigned int b)
+    {
+        double sum = 0.0;
+        for (unsigned int k = 3; k < mesh.stride; k++)
+        {
+            double d = mesh.vertices[a * mesh.stride + k] - mesh.vertices[b * mesh.stride + k];
+            sum += d * d;
+        }
+        return sum;
+    };
+    // would moving 'from' onto 'to' flip any triangle that survives the collapse?
+    auto flips = [&](const std::vector<unsigned int>& triangles, unsigned int from, unsigned int to)
+    {
+        for (unsigned int t : triangles)
+        {
+            unsigned int c[3] = { indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2] };
+            if (posId[c[0]] == posId[to] || posId[c[1]] == posId[to] || posId[c[2]] == posId[to])
+                continue;
+            glm::vec3 before[3], after[3];
+            for (int k = 0; k < 3; k++)
+            {
+                before[k] = mesh.position(c[k]);
+                after[k] = c[k] == from ? mesh.position(to) : before[k];
+            }
+            glm::vec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+            glm::vec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+            if (glm::dot(n0, n1) <= 0.0f)
+                return true;
+        }
+        return false;
+    };
+
+    const double maxCost = (double)options.maxError * options.maxError;
+    double worstCost = 0.0;
+    while (indices.size() > targetIndexCount)
+    {
+        // vertex -> triangle adjacency of the current index buffer
+        std::vector<std::vector<unsigned int>> adjacency(vertexCount);
+        for (size_t i = 0; i < indices.size(); i += 3)
+            for (int c = 0; c < 3; c++)
+                adjacency[indices[i + c]].push_back((unsigned int)(i / 3));
+
+        // cheapest direction of every unique edge
+        std::vector<Collapse> collapses;
+        for (size_t i = 0; i < indices.size(); i += 3)
+            for (int e = 0; e < 3; e++)
+            {
+                unsigned int a = indices[i + e], b = indices[i + (e + 1) % 3];
+                if (a > b)
+                    continue;       // visit every edge once
+                Collapse best = { a, b, 1e300 };
+                for (int dir = 0; dir < 2; dir++)
+                {
+                    unsigned int from = dir ? b : a, to = dir ? a : b;
+                    if (locked[from])
+                        continue;
+                    Quadric q = quadrics[posId[from]];
+                    q.add(quadrics[posId[to]]);
+                    double cost = q.evaluate(mesh.position(to)) + options.attributeWeight * attributeDistance(from, to);
+                    if (cost < best.cost)
+                        best = { from, to, cost };
+                }
+                if (best.cost <= maxCost)
+                    collapses.push_back(best);
+            }
+        std::sort(collapses.begin(), collapses.end());
+
+        // apply as many independent collapses as fit in this pass
+        std::vector<unsigned int> remap(vertexCount);
+        for (unsigned int v = 0; v < vertexCount; v++)
+            remap[v] = v;
+        std::vector<bool> touched(vertexCount, false);
+        size_t removedIndices = 0, applied = 0;
+        for (const Collapse& c : collapses)
+        {
+            if (indices.size() - removedIndices <= targetIndexCount)
+                break;
+            if (touched[c.from] || touched[c.to] || flips(adjacency[c.from], c.from, c.to))
+                continue;
+
+            remap[c.from] = c.to;
+            quadrics[posId[c.to]].add(quadrics[posId[c.from]]);
+            worstCost = std::max(worstCost, c.cost);
+            applied++;
+            for (unsigned int t : adjacency[c.from])
+            {
+                bool shared = false;
+                for (int k = 0; k < 3; k++)
+                {
+                    touched[indices[t * 3 + k]] = true;
+                    shared = shared || posId[indices[t * 3 + k]] == posId[c.to];
+                }
+                if (shared)
+                    removedIndices += 3;
+            }
+        }
+        if (applied == 0)
+            break;
+
+        // rewrite the index buffer and drop triangles that became degenerate
+        std::vector<unsigned int> next;
+        next.reserve(indices.size());
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            unsigned int a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+            if (posId[a] == posId[b] || posId[b] == posId[c] || posId[a] == posId[c])
+                continue;
+            next.push_back(a);
+            next.push_back(b);
+            next.push_back(c);
+        }
+        indices.swap(next);
+    }
+
+    if (outError)
+        *outError = (float)std::sqrt(worstCost);
+    return indices;
+}
+
+// Builds up to maxLevels LODs, each targeting 'reduction' of the previous triangle count.
+// Stops early once a level fails to get meaningfully smaller.
+inline LodChain buildLodChain(const Mesh& mesh, unsigned int maxLevels = 6, float reduction = 0.5f,
+                              const SimplifyOptions& options = SimplifyOptions())
+{
+    LodChain chain;
+
+    glm::vec3 minP(1e30f), maxP(-1e30f);
+    for (unsigned int v = 0; v < mesh.vertexCount(); v++)
+    {
+        minP = glm::min(minP, mesh.position(v));
+        maxP = glm::max(maxP, mesh.position(v));
+    }
+    chain.center = (minP + maxP) * 0.5f;
+    for (unsigned int v = 0; v < mesh.vertexCount(); v++)
+        chain.radius = std::max(chain.radius, glm::length(mesh.position(v) - chain.center));
+
+    std::vector<unsigned int> current = mesh.indices;
+    float error = 0.0f;
+    for (unsigned int level = 0; level < maxLevels && !current.empty(); level++)
+    {
+        chain.levels.push_back({ (unsigned int)chain.indices.size(), (unsigned int)current.size(), error });
+        chain.indices.insert(chain.indices.end(), current.begin(), current.end());
+
+        size_t target = (size_t)(current.size() / 3 * reduction) * 3;
+        float levelError = 0.0f;
+        // simplify from the previous level, errors add up along the chain
+        std::vector<unsigned int> next = simplifyMesh(mesh, current, target, options, &levelError);
+        if (next.size() > current.size() * 0.95f)
+            break;
+        error += levelError;
+        current.swap(next);
+    }
+    return chain;
+}
+
+// Picks the coarsest level whose error, projected to the screen, stays below
+// pixelThreshold. projectionScale is viewportHeight / (2 * tan(fovY / 2)).
+inline unsigned int selectLod(const LodChain& chain, float distance, float projectionScale, float pixelThreshold = 1.0f)
+{
+    // inside the bounding sphere: always full detail
+    distance = distance - chain.radius;
+    if (distance <= 0.0f)
+        return 0;
+    unsigned int chosen = 0;
+    for (unsigned int i = 0; i < chain.levels.size(); i++)
+    {
+        float pixels = chain.levels[i].error / distance * projectionScale;
+        if (pixels > pixelThreshold)
+            break;
+        chosen = i;
+    }
+    return chosen;
+}
+
+#endif
@@ -0,0 +1,201 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <glm/glm.hpp>
+
+#include "mesh_simplify.h"
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// Limits match what mesh shading hardware expects, so the same clusters can
+// later be culled on the GPU without rebuilding them
+const unsigned int MESHLET_MAX_VERTICES = 64;
+const unsigned int MESHLET_MAX_TRIANGLES = 124;
+
+// A small cluster of triangles stored as a contiguous range of the index buffer
+struct Meshlet
+{
+    unsigned int indexOffset;   // absolute offset into the index buffer
+    unsigned int indexCount;
+    unsigned int vertexCount;   // unique vertices referenced
+    // bounding sphere (object space)
+    glm::vec3 center;
+    float radius;
+    // normal cone: every triangle normal is within acos(-coneCutoff) of coneAxis
+    // (coneCutoff == 1 means the cluster can never be back-face culled)
+    glm::vec3 coneAxis;
+    float coneCutoff;
+};
+
+// Six planes (xyz = inward normal, w = distance) in world space
+struct Frustum
+{
+    glm::vec4 planes[6];
+};
+
+// Compacted output of the culling pass, ready for glMultiDrawElements
+struct MeshletDrawList
+{
+    std::vector<int> counts;
+    std::vector<const void*> offsets;
+    unsigned int culled = 0;
+
+    void clear() { counts.clear(); offsets.clear(); culled = 0; }
+};
+
+// Gribb/Hartmann plane extraction from a projection * view matrix
+inline Frustum extractFrustum(const glm::mat4& viewProjection)
+{
+    Frustum f;
+    glm::vec4 row[4];
+    for (int r = 0; r < 4; r++)
+        row[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+    f.planes[0] = row[3] + row[0];  // left
+    f.planes[1] = row[3] - row[0];  // right
+    f.planes[2] = row[3] + row[1];  // bottom
+    f.planes[3] = row[3] - row[1];  // top
+    f.planes[4] = row[3] + row[2];  // near
+    f.planes[5] = row[3] - row[2];  // far
+    for (int i = 0; i < 6; i++)
+        f.planes[i] = f.planes[i] / glm::length(glm::vec3(f.planes[i].x, f.planes[i].y, f.planes[i].z));
+    return f;
+}
+
+inline bool sphereInFrustum(const Frustum& f, const glm::vec3& center, float radius)
+{
+    for (int i = 0; i < 6; i++)
+        if (glm::dot(glm::vec3(f.planes[i].x, f.planes[i].y, f.planes[i].z), center) + f.planes[i].w < -radius)
+            return false;
+    return true;
+}
+
+namespace meshlet_detail
+{
+    inline void computeBounds(const Mesh& mesh, const std::vector<unsigned int>& indices, Meshlet& m)
+    {
+        // bounding sphere: box center + farthest vertex
+        glm::vec3 minP(1e30f), maxP(-1e30f);
+        for (unsigned int i = 0; i < m.indexCount; i++)
+        {
+            glm::vec3 p = mesh.position(indices[m.indexOffset + i]);
+            minP = glm::min(minP, p);
+            maxP = glm::max(maxP, p);
+        }
+        m.center = (minP + maxP) * 0.5f;
+        m.radius = 0.0f;
+        for (unsigned int i = 0; i < m.indexCount; i++)
+            m.radius = std::max(m.radius, glm::length(mesh.position(indices[m.indexOffset + i]) - m.center));
+
+        // normal cone: average normal, then the widest deviation from it
+        std::vector<glm::vec3> normals;
+        glm::vec3 axis(0.0f);
+        for (unsigned int i = 0; i < m.indexCount; i += 3)
+        {
+            const unsigned int* t = &indices[m.indexOffset + i];
+            glm::vec3 p0 = mesh.position(t[0]), p1 = mesh.position(t[1]), p2 = mesh.position(t[2]);
+            glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+            float len = glm::length(n);
+            if (len <= 0.0f)
+                continue;
+            normals.push_back(n / len);
+            axis += n / len;
+        }
+        float axisLength = glm::length(axis);
+        m.coneAxis = axisLength > 0.0f ? axis / axisLength : glm::vec3(0.0f, 0.0f, 1.0f);
+        float minDot = 1.0f;
+        for (const glm::vec3& n : normals)
+            minDot = std::min(minDot, glm::dot(n, m.coneAxis));
+        // wider than ~84 degrees: the cone test can't reject anything useful
+        m.coneCutoff = (axisLength <= 0.0f || minDot <= 0.1f) ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+    }
+}
+
+// Greedily splits indices[first, first + count) into meshlets, each a contiguous
+// run of that range. The indices aren't reordered, so the clusters are only as
+// spatially coherent as the mesh's own triangle order.
+inline std::vector<Meshlet> buildMeshlets(const Mesh& mesh, const std::vector<unsigned int>& indices, size_t first, size_t count)
+{
+    std::vector<Meshlet> meshlets;
+    std::vector<unsigned int> used;     // unique vertices of the meshlet being built
+    Meshlet current = {};
+    current.indexOffset = (unsigned int)first;
+
+    auto flush = [&]()
+    {
+        if (current.indexCount == 0)
+            return;
+        current.vertexCount = (unsigned int)used.size();
+        meshlet_detail::computeBounds(mesh, indices, current);
+        meshlets.push_back(current);
+        current = Meshlet();
+        current.indexOffset = meshlets.back().indexOffset + meshlets.back().indexCount;
+        used.clear();
+    };
+
+    for (size_t i = first; i + 2 < first + count; i += 3)
+    {
+        unsigned int added = 0;
+        for (int c = 0; c < 3; c++)
+            if (std::find(used.begin(), used.end(), indices[i + c]) == used.end())
+                added++;
+        if (used.size() + added > MESHLET_MAX_VERTICES || current.indexCount / 3 + 1 > MESHLET_MAX_TRIANGLES)
+            flush();
+        for (int c = 0; c < 3; c++)
+            if (std::find(used.begin(), used.end(), indices[i + c]) == used.end())
+                used.push_back(indices[i + c]);
+        current.indexCount += 3;
+    }
+    flush();
+    return meshlets;
+}
+
+// CPU culling pass: drops meshlets that are outside the frustum or entirely back-facing,
+// and merges neighbouring survivors into single draw ranges.
+// model must be a rigid transform (rotation/translation/uniform scale).
+inline void cullMeshlets(const std::vector<Meshlet>& meshlets, unsigned int firstMeshlet, unsigned int meshletCount,
+                         const Frustum& frustum, const glm::mat4& model, const glm::vec3& cameraPos,
+                         MeshletDrawList& out)
+{
+    float scale = glm::length(glm::vec3(model[0].x, model[0].y, model[0].z));
+    // camera in object space, so the cones don't need transforming
+    glm::vec3 localCamera = glm::vec3(glm::inverse(model) * glm::vec4(cameraPos, 1.0f));
+
+    unsigned int runStart = 0, runCount = 0;
+    for (unsigned int i = firstMeshlet; i < firstMeshlet + meshletCount; i++)
+    {
+        const Meshlet& m = meshlets[i];
+        glm::vec3 worldCenter = glm::vec3(model * glm::vec4(m.center, 1.0f));
+        bool visible = sphereInFrustum(frustum, worldCenter, m.radius * scale);
+        if (visible && m.coneCutoff < 1.0f)
+        {
+            glm::vec3 toCluster = m.center - localCamera;
+            visible = glm::dot(toCluster, m.coneAxis) < m.coneCutoff * glm::length(toCluster) + m.radius;
+        }
+        if (!visible)
+        {
+            out.culled++;
+            continue;
+        }
+        if (runCount > 0 && runStart + runCount == m.indexOffset)
+        {
+            runCount += m.indexCount;
+            continue;
+        }
+        if (runCount > 0)
+        {
+            out.counts.push_back((int)runCount);
+            out.offsets.push_back((const void*)(runStart * sizeof(unsigned int)));
+        }
+        runStart = m.indexOffset;
+        runCount = m.indexCount;
+    }
+    if (runCount > 0)
+    {
+        out.counts.push_back((int)runCount);
+        out.offsets.push_back((const void*)(runStart * sizeof(unsigned int)));
+    }
+}
+
+#endif
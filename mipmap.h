@@ -0,0 +1,287 @@
+#ifndef MIPMAP_H
+#define MIPMAP_H
+
+// CPU mip chain generation, so mip quality and cost don't depend on what the
+// driver's glGenerateMipmap happens to do.
+//
+// Filtering happens in linear light (sRGB input is decoded first) and, for
+// images with alpha, on premultiplied colour so fully transparent texels don't
+// bleed their colour into the smaller levels. Each level is built from the
+// previous one, its rows split over the job pool.
+//
+//      MipLevel levels[11];                    // levels[0] is the source image
+//      levels[0] = { pixels, 1024, 1024, 1024 * 4 };
+//      for (int i = 1; i < 11; i++)            // caller provides the memory
+//          levels[i] = { buffer + offset[i], TextureLoader::levelSize(1024, i), ... };
+//      generateMipChain(levels, 11, 4, MipOptions());
+
+#include "image_kernels.h"
+#include "job_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+enum MipFilter
+{
+    MIP_FILTER_BOX,         // 2x2 average, what drivers usually do
+    MIP_FILTER_KAISER       // 8 tap Kaiser windowed sinc, sharper smaller levels
+};
+
+struct MipOptions
+{
+    MipFilter filter = MIP_FILTER_BOX;
+    bool srgb = true;                   // colour channels are sRGB encoded (alpha never is)
+    bool premultiply = true;            // filter premultiplied colour, ignored without alpha
+    bool wrap = false;                  // sample across edges like GL_REPEAT instead of clamping
+};
+
+struct MipLevel
+{
+    uint8_t* pixels;
+    int width, height;
+    size_t stride;                      // bytes per row
+};
+
+namespace mipmap_detail
+{
+    const int ROWS_PER_TASK = 16;
+
+    struct Kernel
+    {
+        int taps;
+        int first;              // offset of the first tap from 2 * x
+        float weights[8];
+    };
+
+    inline double besselI0(double x)
+    {
+        double sum = 1.0, term = 1.0;
+        for (int k = 1; k < 32; k++)
+        {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    inline const Kernel& kernelFor(MipFilter filter)
+    {
+        static const Kernel box = { 2, 0, { 0.5f, 0.5f } };
+        struct Kaiser : Kernel
+        {
+            Kaiser()
+            {
+                // taps at -3.5 .. 3.5 source texels from the destination texel centre
+                const double pi = 3.14159265358979323846, beta = 4.0, radius = 4.0;
+                taps = 8;
+                first = -3;
+                double sum = 0.0, w[8];
+                for (int k = 0; k < 8; k++)
+                {
+                    double d = k - 3.5, x = pi * d / 2.0, t = d / radius;
+                    w[k] = std::sin(x) / x * besselI0(beta * std::sqrt(1.0 - t * t)) / besselI0(beta);
+                    sum += w[k];
+                }
+                for (int k = 0; k < 8; k++)
+                    weights[k] = (float)(w[k] / sum);
+            }
+        };
+        static const Kaiser kaiser;
+        return filter == MIP_FILTER_KAISER ? (const Kernel&)kaiser : box;
+    }
+
+    // source index of every tap of every destination texel along one axis
+    inline std::vector<int> tapIndices(const Kernel& kernel, int srcSize, int dstSize, bool wrap)
+    {
+        std::vector<int> indices((size_t)dstSize * kernel.taps);
+        for (int x = 0; x < dstSize; x++)
+            for (int k = 0; k < kernel.taps; k++)
+            {
+                int i = 2 * x + kernel.first + k;
+                if (wrap)
+                    i = ((i % srcSize) + srcSize) % srcSize;
+                else
+                    i = i < 0 ? 0 : i >= srcSize ? srcSize - 1 : i;
+                indices[(size_t)x * kernel.taps + k] = i;
+            }
+        return indices;
+    }
+
+    // out[i] = sum over taps of weights[k] * rows[k][i]
+#ifdef IMAGE_KERNELS_X86
+    IMAGE_KERNELS_TARGET("avx2")
+    inline size_t weightedSum_avx2(const float* const* rows, const float* weights, int taps, float* out, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256 sum = _mm256_mul_ps(_mm256_loadu_ps(rows[0] + i), _mm256_set1_ps(weights[0]));
+            for (int k = 1; k < taps; k++)
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(rows[k] + i), _mm256_set1_ps(weights[k])));
+            _mm256_storeu_ps(out + i, sum);
+        }
+        return i;
+    }
+
+    // one RGBA texel per SSE register
+    IMAGE_KERNELS_TARGET("sse2")
+    inline void downsampleRow4_sse(const float* in, float* out, int dstWidth, const int* indices, const float* weights, int taps)
+    {
+        for (int x = 0; x < dstWidth; x++)
+        {
+            const int* tap = indices + (size_t)x * taps;
+            __m128 sum = _mm_mul_ps(_mm_loadu_ps(in + tap[0] * 4), _mm_set1_ps(weights[0]));
+            for (int k = 1; k < taps; k++)
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(in + tap[k] * 4), _mm_set1_ps(weights[k])));
+            _mm_storeu_ps(out + (size_t)x * 4, sum);
+        }
+    }
+#endif
+
+    inline void weightedSum(const float* const* rows, const float* weights, int taps, float* out, size_t count)
+    {
+        size_t i = 0;
+#ifdef IMAGE_KERNELS_X86
+        if (imageKernelLevel() >= IMAGE_KERNELS_AVX2)
+            i = weightedSum_avx2(rows, weights, taps, out, count);
+#endif
+        for (; i < count; i++)
+        {
+            float sum = rows[0][i] * weights[0];
+            for (int k = 1; k < taps; k++)
+                sum += rows[k][i] * weights[k];
+            out[i] = sum;
+        }
+    }
+
+    inline void downsampleRow(const float* in, float* out, int dstWidth, int channels, const int* indices, const float* weights, int taps)
+    {
+#ifdef IMAGE_KERNELS_X86
+        if (channels == 4 && imageKernelLevel() >= IMAGE_KERNELS_SSSE3)
+        {
+            downsampleRow4_sse(in, out, dstWidth, indices, weights, taps);
+            return;
+        }
+#endif
+        for (int x = 0; x < dstWidth; x++)
+        {
+            const int* tap = indices + (size_t)x * taps;
+            for (int c = 0; c < channels; c++)
+            {
+                float sum = in[tap[0] * channels + c] * weights[0];
+                for (int k = 1; k < taps; k++)
+                    sum += in[tap[k] * channels + c] * weights[k];
+                out[(size_t)x * channels + c] = sum;
+            }
+        }
+    }
+
+    // 8-bit row -> linear float, premultiplied if asked
+    inline void decodeRow(const uint8_t* in, float* out, int width, int channels, const MipOptions& options, bool premultiply)
+    {
+        size_t count = (size_t)width * channels;
+        if (options.srgb)
+            srgbToLinear(in, out, width, channels);
+        else
+            for (size_t i = 0; i < count; i++)
+                out[i] = in[i] * (1.0f / 255.0f);
+        if (premultiply)
+            for (int x = 0; x < width; x++)
+            {
+                float* px = out + (size_t)x * channels;
+                for (int c = 0; c < channels - 1; c++)
+                    px[c] *= px[channels - 1];
+            }
+    }
+
+    // linear float row -> 8-bit straight alpha, scratch holds a row
+    inline void encodeRow(const float* in, uint8_t* out, float* scratch, int width, int channels, const MipOptions& options, bool premultiplied)
+    {
+        size_t count = (size_t)width * channels;
+        const float* src = in;
+        if (premultiplied)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                const float* px = in + (size_t)x * channels;
+                float* dst = scratch + (size_t)x * channels;
+                float alpha = px[channels - 1];
+                float scale = alpha > 0.0f ? 1.0f / alpha : 0.0f;
+                for (int c = 0; c < channels - 1; c++)
+                    dst[c] = px[c] * scale;
+                dst[channels - 1] = alpha;
+            }
+            src = scratch;
+        }
+        if (options.srgb)
+            linearToSrgb(src, out, width, channels);
+        else
+            for (size_t i = 0; i < count; i++)
+            {
+                float v = src[i] > 0.0f ? src[i] : 0.0f;
+                out[i] = (uint8_t)((v < 1.0f ? v : 1.0f) * 255.0f + 0.5f);
+            }
+    }
+}
+
+// Fills levels[1 .. count - 1] from levels[0]. Level sizes are up to the
+// caller, normally the GL ones (each half the previous, at least 1).
+inline void generateMipChain(const MipLevel* levels, int count, int channels, const MipOptions& options = MipOptions(),
+                             JobPool& pool = JobPool::shared())
+{
+    using namespace mipmap_detail;
+    if (count < 2)
+        return;
+    const Kernel& kernel = kernelFor(options.filter);
+    bool premultiply = options.premultiply && (channels == 2 || channels == 4);
+
+    // the previous level stays in linear float, so rounding never accumulates
+    std::vector<float> src((size_t)levels[0].width * levels[0].height * channels);
+    int srcWidth = levels[0].width, srcHeight = levels[0].height;
+    size_t srcRow = (size_t)srcWidth * channels;
+    int bands = (srcHeight + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+    pool.parallelFor(bands, [&](int band)
+    {
+        int end = std::min(srcHeight, (band + 1) * ROWS_PER_TASK);
+        for (int y = band * ROWS_PER_TASK; y < end; y++)
+            decodeRow(levels[0].pixels + levels[0].stride * y, src.data() + srcRow * y, srcWidth, channels, options, premultiply);
+    });
+
+    std::vector<float> dst;
+    for (int level = 1; level < count; level++)
+    {
+        const MipLevel& out = levels[level];
+        size_t dstRow = (size_t)out.width * channels;
+        dst.resize(dstRow * out.height);
+        std::vector<int> columns = tapIndices(kernel, srcWidth, out.width, options.wrap);
+        std::vector<int> rows = tapIndices(kernel, srcHeight, out.height, options.wrap);
+
+        bands = (out.height + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+        pool.parallelFor(bands, [&](int band)
+        {
+            // vertical pass into one source-width row, then horizontal into the destination
+            std::vector<float> column(srcRow), scratch(dstRow);
+            const float* taps[8];
+            int end = std::min(out.height, (band + 1) * ROWS_PER_TASK);
+            for (int y = band * ROWS_PER_TASK; y < end; y++)
+            {
+                for (int k = 0; k < kernel.taps; k++)
+                    taps[k] = src.data() + srcRow * rows[(size_t)y * kernel.taps + k];
+                weightedSum(taps, kernel.weights, kernel.taps, column.data(), srcRow);
+                float* row = dst.data() + dstRow * y;
+                downsampleRow(column.data(), row, out.width, channels, columns.data(), kernel.weights, kernel.taps);
+                encodeRow(row, out.pixels + out.stride * y, scratch.data(), out.width, channels, options, premultiply);
+            }
+        });
+
+        src.swap(dst);
+        srcWidth = out.width;
+        srcHeight = out.height;
+        srcRow = dstRow;
+    }
+}
+
+#endif
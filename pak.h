@@ -0,0 +1,444 @@
+#ifndef PAK_H
+#define PAK_H
+
+#include "lz4_block.h"
+#include "async_io.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Single-file asset archive, mapped into memory once and read in place:
+//
+//      PakArchive pak;
+//      if (pak.open("assets.pak"))
+//          mountPak(pak);      // texture and shader loads now look in it first
+//      ...
+//      PakSpan span;
+//      std::vector<uint8_t> storage;
+//      findAsset("assets/wall.jpeg", span, storage);   // points into the mapping
+//
+// Names are case-insensitive, '/' or '\' separated, with "." and ".."
+// resolved ("./Shaders/shader.vs" finds "shaders/shader.vs"), and looked up
+// through a hash table stored in the file. Entries start 64 byte aligned and
+// are either stored as is (handed out without a copy) or LZ4 compressed
+// (decompressed into the caller's buffer). Build archives with pak_tool.
+//
+// Layout: PakHeader, entry data, PakEntry table, hash buckets, names.
+
+const uint32_t PAK_MAGIC = 0x314b4150;      // "PAK1"
+const uint32_t PAK_VERSION = 1;
+const uint64_t PAK_ALIGNMENT = 64;
+const uint64_t PAK_MAX_ENTRY_SIZE = (uint64_t)1 << 30;    // decompressed, more than any asset needs
+
+enum PakCompression
+{
+    PAK_STORED = 0,
+    PAK_LZ4 = 1,
+};
+
+struct PakHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t bucketCount;       // power of two, entry index + 1 per bucket, 0 is empty
+    uint64_t entriesOffset;
+    uint64_t bucketsOffset;
+    uint64_t namesOffset;
+    uint64_t namesSize;
+};
+
+struct PakEntry
+{
+    uint64_t nameHash;
+    uint64_t offset;
+    uint64_t size;              // uncompressed
+    uint64_t storedSize;        // in the file
+    uint32_t nameOffset;        // into the name block, not 0 terminated
+    uint16_t nameLength;
+    uint16_t compression;
+};
+
+struct PakSpan
+{
+    const uint8_t* data = NULL;
+    size_t size = 0;
+};
+
+class PakArchive
+{
+public:
+    PakArchive() = default;
+    PakArchive(const PakArchive&) = delete;
+    PakArchive& operator=(const PakArchive&) = delete;
+
+    ~PakArchive()
+    {
+        close();
+    }
+
+    // Maps the whole file, false if it's missing or not a valid archive
+    bool open(const std::string& path)
+    {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(PakHeader))
+        {
+            mappedSize = (size_t)st.st_size;
+            void* mapping = mmap(NULL, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+            base = mapping == MAP_FAILED ? NULL : (const uint8_t*)mapping;
+        }
+        ::close(fd);    // the mapping stays valid
+        if (!base)
+        {
+            std::cout << "ERROR::PAK::MAP_FAILED " << path << std::endl;
+            return false;
+        }
+        if (!validate())
+        {
+            std::cout << "ERROR::PAK::INVALID " << path << std::endl;
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close()
+    {
+        if (base)
+            munmap((void*)base, mappedSize);
+        base = NULL;
+        mappedSize = 0;
+        header = NULL;
+        entries = NULL;
+        buckets = NULL;
+        names = NULL;
+    }
+
+    bool isOpen() const { return base != NULL; }
+
+    // Entry index for a name, -1 if the archive doesn't have it
+    int find(const std::string& path) const
+    {
+        if (!base)
+            return -1;
+        std::string name = normalizeName(path);
+        uint64_t hash = hashName(name);
+        uint32_t mask = header->bucketCount - 1;
+        uint32_t b = (uint32_t)hash & mask;
+        for (uint32_t probes = 0; probes < header->bucketCount; probes++, b = (b + 1) & mask)
+        {
+            uint32_t slot = buckets[b];
+            if (!slot)
+                return -1;
+            const PakEntry& entry = entries[slot - 1];
+            if (entry.nameHash == hash && entry.nameLength == name.size() &&
+                memcmp(names + entry.nameOffset, name.data(), name.size()) == 0)
+                return (int)slot - 1;
+        }
+        return -1;
+    }
+
+    // Contents of an entry: straight from the mapping when it is stored as
+    // is, otherwise decompressed into 'storage'
+    bool read(int index, PakSpan& span, std::vector<uint8_t>& storage) const
+    {
+        const PakEntry& entry = entries[index];
+        const uint8_t* stored = base + entry.offset;
+        if (entry.compression == PAK_STORED)
+        {
+            span.data = stored;
+            span.size = (size_t)entry.size;
+            return true;
+        }
+        if (!sizeOk(entry))
+        {
+            std::cout << "ERROR::PAK::CORRUPT_ENTRY " << name(index) << std::endl;
+            return false;
+        }
+        storage.resize((size_t)entry.size);
+        if (!lz4Decompress(stored, (size_t)entry.storedSize, storage.data(), storage.size()))
+        {
+            std::cout << "ERROR::PAK::CORRUPT_ENTRY " << name(index) << std::endl;
+            return false;
+        }
+        span.data = storage.data();
+        span.size = storage.size();
+        return true;
+    }
+
+    int entryCount() const { return base ? (int)header->entryCount : 0; }
+    const PakEntry& entry(int index) const { return entries[index]; }
+    std::string name(int index) const { return std::string(names + entries[index].nameOffset, entries[index].nameLength); }
+
+    // lower case, '/' separated, "." and ".." resolved, no leading "/"
+    static std::string normalizeName(const std::string& path)
+    {
+        std::vector<std::string> parts;
+        std::string part;
+        for (size_t i = 0; i <= path.size(); i++)
+        {
+            char c = i < path.size() ? path[i] : '/';
+            if (c != '/' && c != '\\')
+            {
+                part += (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+                continue;
+            }
+            if (part == "..")
+            {
+                if (!parts.empty())
+                    parts.pop_back();
+            }
+            else if (!part.empty() && part != ".")
+                parts.push_back(part);
+            part.clear();
+        }
+        std::string name;
+        for (const std::string& p : parts)
+            name += (name.empty() ? "" : "/") + p;
+        return name;
+    }
+
+    // 64-bit FNV-1a of a normalized name
+    static uint64_t hashName(const std::string& name)
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        for (char c : name)
+            hash = (hash ^ (uint8_t)c) * 1099511628211ULL;
+        return hash;
+    }
+
+private:
+    const uint8_t* base = NULL;
+    size_t mappedSize = 0;
+    const PakHeader* header = NULL;
+    const PakEntry* entries = NULL;
+    const uint32_t* buckets = NULL;
+    const char* names = NULL;
+
+    // everything find() and read() touch lies inside the file
+    bool validate()
+    {
+        header = (const PakHeader*)base;
+        if (header->magic != PAK_MAGIC || header->version != PAK_VERSION)
+            return false;
+        uint32_t count = header->entryCount, bucketCount = header->bucketCount;
+        if (!bucketCount || (bucketCount & (bucketCount - 1)) || bucketCount <= count)
+            return false;
+        if (!inside(header->entriesOffset, (uint64_t)count * sizeof(PakEntry)) ||
+            !inside(header->bucketsOffset, (uint64_t)bucketCount * sizeof(uint32_t)) ||
+            !inside(header->namesOffset, header->namesSize) ||
+            header->entriesOffset % alignof(PakEntry) || header->bucketsOffset % alignof(uint32_t))
+            return false;
+        entries = (const PakEntry*)(base + header->entriesOffset);
+        buckets = (const uint32_t*)(base + header->bucketsOffset);
+        names = (const char*)(base + header->namesOffset);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const PakEntry& entry = entries[i];
+            if (!inside(entry.offset, entry.storedSize) || (uint64_t)entry.nameOffset + entry.nameLength > header->namesSize ||
+                entry.compression > PAK_LZ4 || !sizeOk(entry))
+                return false;
+        }
+        // probing stops at an empty bucket, a table without one never ends
+        bool anyEmpty = false;
+        for (uint32_t b = 0; b < bucketCount; b++)
+        {
+            if (buckets[b] > count)
+                return false;
+            anyEmpty |= buckets[b] == 0;
+        }
+        return anyEmpty;
+    }
+
+    // stored entries are their bytes in the file; a compressed one's size is
+    // allocated before decompressing, so a corrupt one mustn't ask for gigabytes
+    static bool sizeOk(const PakEntry& entry)
+    {
+        if (entry.compression == PAK_STORED)
+            return entry.storedSize == entry.size;
+        return entry.size <= PAK_MAX_ENTRY_SIZE && entry.size <= lz4MaxDecompressedSize(entry.storedSize);
+    }
+
+    bool inside(uint64_t offset, uint64_t size) const
+    {
+        return offset <= mappedSize && size <= mappedSize - offset;
+    }
+};
+
+// Builds an archive in memory, then writes it out in one go (used by pak_tool)
+class PakWriter
+{
+public:
+    // Compressed only when that saves at least 1/8, already compressed
+    // formats (JPEG, PNG) end up stored. Returns false for a duplicate or too long name.
+    bool add(const std::string& path, const uint8_t* data, size_t size, bool compress = true)
+    {
+        Pending item;
+        item.name = PakArchive::normalizeName(path);
+        if (item.name.size() > 0xffff)
+            return false;
+        for (const Pending& other : items)
+            if (other.name == item.name)
+                return false;
+        item.size = size;
+        item.compression = PAK_STORED;
+        if (compress && size > 64)
+        {
+            lz4Compress(data, size, item.bytes);
+            if (item.bytes.size() <= size - size / 8)
+                item.compression = PAK_LZ4;
+        }
+        if (item.compression == PAK_STORED)
+            item.bytes.assign(data, data + size);
+        items.push_back(std::move(item));
+        return true;
+    }
+
+    bool write(const std::string& path) const
+    {
+        std::vector<uint8_t> file(sizeof(PakHeader), 0);
+        std::vector<PakEntry> entries(items.size());
+        std::string names;
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            const Pending& item = items[i];
+            file.resize((file.size() + PAK_ALIGNMENT - 1) & ~(PAK_ALIGNMENT - 1), 0);
+            PakEntry& entry = entries[i];
+            entry.nameHash = PakArchive::hashName(item.name);
+            entry.offset = file.size();
+            entry.size = item.size;
+            entry.storedSize = item.bytes.size();
+            entry.nameOffset = (uint32_t)names.size();
+            entry.nameLength = (uint16_t)item.name.size();
+            entry.compression = (uint16_t)item.compression;
+            file.insert(file.end(), item.bytes.begin(), item.bytes.end());
+            names += item.name;
+        }
+
+        // open addressing, at most half full so misses end quickly
+        uint32_t bucketCount = 2;
+        while (bucketCount < items.size() * 2)
+            bucketCount *= 2;
+        std::vector<uint32_t> buckets(bucketCount, 0);
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            uint32_t b = (uint32_t)entries[i].nameHash & (bucketCount - 1);
+            while (buckets[b])
+                b = (b + 1) & (bucketCount - 1);
+            buckets[b] = (uint32_t)i + 1;
+        }
+
+        PakHeader header;
+        header.magic = PAK_MAGIC;
+        header.version = PAK_VERSION;
+        header.entryCount = (uint32_t)entries.size();
+        header.bucketCount = bucketCount;
+        file.resize((file.size() + PAK_ALIGNMENT - 1) & ~(PAK_ALIGNMENT - 1), 0);
+        header.entriesOffset = file.size();
+        file.insert(file.end(), (const uint8_t*)entries.data(), (const uint8_t*)(entries.data() + entries.size()));
+        header.bucketsOffset = file.size();
+        file.insert(file.end(), (const uint8_t*)buckets.data(), (const uint8_t*)(buckets.data() + buckets.size()));
+        header.namesOffset = file.size();
+        header.namesSize = names.size();
+        file.insert(file.end(), names.begin(), names.end());
+        memcpy(file.data(), &header, sizeof(header));
+
+        FILE* out = fopen(path.c_str(), "wb");
+        if (!out)
+            return false;
+        bool ok = fwrite(file.data(), 1, file.size(), out) == file.size();
+        return fclose(out) == 0 && ok;
+    }
+
+    size_t count() const { return items.size(); }
+    size_t storedBytes(size_t i) const { return items[i].bytes.size(); }
+    bool compressed(size_t i) const { return items[i].compression != PAK_STORED; }
+    const std::string& name(size_t i) const { return items[i].name; }
+
+private:
+    struct Pending
+    {
+        std::string name;
+        size_t size;
+        int compression;
+        std::vector<uint8_t> bytes;
+    };
+    std::vector<Pending> items;
+};
+
+// Archives that asset loads look in before the loose files, latest mounted
+// first. Mount at startup, before loads start on the job pool.
+inline std::vector<const PakArchive*>& mountedPaks()
+{
+    static std::vector<const PakArchive*> paks;
+    return paks;
+}
+
+inline void mountPak(const PakArchive& pak)
+{
+    mountedPaks().insert(mountedPaks().begin(), &pak);
+}
+
+inline void unmountPak(const PakArchive& pak)
+{
+    std::vector<const PakArchive*>& paks = mountedPaks();
+    for (size_t i = 0; i < paks.size(); i++)
+        if (paks[i] == &pak)
+        {
+            paks.erase(paks.begin() + i);
+            return;
+        }
+}
+
+// Whether a mounted archive has 'path', without reading it
+inline bool isPackedAsset(const std::string& path)
+{
+    for (const PakArchive* pak : mountedPaks())
+        if (pak->find(path) >= 0)
+            return true;
+    return false;
+}
+
+// Looks 'path' up in the mounted archives only, see PakArchive::read()
+inline bool findAsset(const std::string& path, PakSpan& span, std::vector<uint8_t>& storage)
+{
+    for (const PakArchive* pak : mountedPaks())
+    {
+        int index = pak->find(path);
+        if (index >= 0)
+            return pak->read(index, span, storage);
+    }
+    return false;
+}
+
+// Whole text file from the mounted archives, or from disk if they don't have it
+inline bool readTextAsset(const std::string& path, std::string& text)
+{
+    PakSpan span;
+    std::vector<uint8_t> storage;
+    if (findAsset(path, span, storage))
+    {
+        text.assign((const char*)span.data, span.size);
+        return true;
+    }
+    std::vector<uint8_t> bytes;
+    if (!AsyncIO::shared().readFile(path, bytes))
+        return false;
+    text.assign((const char*)bytes.data(), bytes.size());
+    return true;
+}
+
+#endif
@@ -0,0 +1,117 @@
+// Packs files and directories into one archive for pak.h:
+//
+//      ./pak_tool assets.pak Assets Shaders
+//      ./pak_tool --store assets.pak Assets        (no compression)
+//      ./pak_tool --list assets.pak
+//
+// Entries are named by the path as given ("Assets/wall.jpeg" is looked up as
+// "assets/wall.jpeg"), so pack from the directory the program runs in.
+// Build with `make pak_tool`, or `make assets.pak` to pack Assets and Shaders.
+#include "pak.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static bool readFile(const fs::path& path, std::vector<uint8_t>& bytes)
+{
+    FILE* file = fopen(path.string().c_str(), "rb");
+    if (!file)
+        return false;
+    bytes.clear();
+    uint8_t chunk[64 * 1024];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        bytes.insert(bytes.end(), chunk, chunk + read);
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+static int list(const char* path)
+{
+    PakArchive pak;
+    if (!pak.open(path))
+        return 1;
+    for (int i = 0; i < pak.entryCount(); i++)
+    {
+        const PakEntry& entry = pak.entry(i);
+        std::printf("%10llu %10llu %-6s %s\n", (unsigned long long)entry.size, (unsigned long long)entry.storedSize,
+                    entry.compression == PAK_LZ4 ? "lz4" : "stored", pak.name(i).c_str());
+    }
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    bool compress = true;
+    int arg = 1;
+    if (arg < argc && std::strcmp(argv[arg], "--list") == 0)
+        return arg + 1 < argc ? list(argv[arg + 1]) : 1;
+    if (arg < argc && std::strcmp(argv[arg], "--store") == 0)
+    {
+        compress = false;
+        arg++;
+    }
+    if (argc - arg < 2)
+    {
+        std::printf("usage: %s [--store] out.pak file|directory...\n       %s --list archive.pak\n", argv[0], argv[0]);
+        return 1;
+    }
+    const char* output = argv[arg++];
+
+    // sorted, so the same inputs always give the same archive
+    std::vector<fs::path> files;
+    for (; arg < argc; arg++)
+    {
+        std::error_code error;
+        if (fs::is_directory(argv[arg], error))
+        {
+            for (fs::recursive_directory_iterator it(argv[arg], error), end; it != end; it.increment(error))
+                if (it->is_regular_file(error) && it->path().filename().string()[0] != '.')
+                    files.push_back(it->path());
+        }
+        else if (fs::is_regular_file(argv[arg], error))
+            files.push_back(argv[arg]);
+        else
+        {
+            std::printf("ERROR::PAK_TOOL::NOT_FOUND %s\n", argv[arg]);
+            return 1;
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    PakWriter writer;
+    size_t totalIn = 0, totalOut = 0;
+    std::vector<uint8_t> bytes;
+    for (const fs::path& file : files)
+    {
+        if (!readFile(file, bytes))
+        {
+            std::printf("ERROR::PAK_TOOL::READ_FAILED %s\n", file.string().c_str());
+            return 1;
+        }
+        if (!writer.add(file.generic_string(), bytes.data(), bytes.size(), compress))
+        {
+            std::printf("ERROR::PAK_TOOL::DUPLICATE_NAME %s\n", file.string().c_str());
+            return 1;
+        }
+        size_t i = writer.count() - 1;
+        std::printf("%10zu -> %10zu %-6s %s\n", bytes.size(), writer.storedBytes(i), writer.compressed(i) ? "lz4" : "stored",
+                    writer.name(i).c_str());
+        totalIn += bytes.size();
+        totalOut += writer.storedBytes(i);
+    }
+    if (!writer.write(output))
+    {
+        std::printf("ERROR::PAK_TOOL::WRITE_FAILED %s\n", output);
+        return 1;
+    }
+    std::printf("%zu files, %zu -> %zu bytes in %s\n", writer.count(), totalIn, totalOut, output);
+    return 0;
+}
@@ -0,0 +1,129 @@
+#ifndef SAMPLER_CACHE_H
+#define SAMPLER_CACHE_H
+
+#include <glad/glad.h>
+
+#include "gl_ext.h"
+#include "gl_state_cache.h"
+#include "hash.h"
+
+#include <unordered_map>
+
+// Filtering and wrapping live in sampler objects bound per texture unit, not
+// in the textures, so one image can be sampled several ways and switching
+// costs a bind instead of parameter changes. Equal descriptions share one
+// sampler object:
+//
+//      SamplerDesc clamped(GL_CLAMP_TO_EDGE);
+//      clamped.anisotropy = 8.0f;
+//      glState().bindSampler(1, SamplerCache::shared().get(clamped));
+//
+// A bound sampler overrides all the texture's own sampling parameters
+// (GL_TEXTURE_BASE_LEVEL / MAX_LEVEL are texture state and still apply).
+// Call destroy() while the GL context is still alive.
+
+struct SamplerDesc
+{
+    GLenum wrapS = GL_REPEAT, wrapT = GL_REPEAT, wrapR = GL_REPEAT;
+    GLenum minFilter = GL_LINEAR_MIPMAP_LINEAR;
+    GLenum magFilter = GL_LINEAR;
+    float anisotropy = 1.0f;        // 1 is off, clamped to what the GPU supports
+    float lodBias = 0.0f;
+    float minLod = -1000.0f, maxLod = 1000.0f;     // GL defaults
+
+    SamplerDesc() = default;
+    explicit SamplerDesc(GLenum wrap, GLenum minFilter = GL_LINEAR_MIPMAP_LINEAR, GLenum magFilter = GL_LINEAR)
+        : wrapS(wrap), wrapT(wrap), wrapR(wrap), minFilter(minFilter), magFilter(magFilter)
+    {
+    }
+
+    bool operator==(const SamplerDesc& other) const
+    {
+        return wrapS == other.wrapS && wrapT == other.wrapT && wrapR == other.wrapR && minFilter == other.minFilter &&
+               magFilter == other.magFilter && anisotropy == other.anisotropy && lodBias == other.lodBias &&
+               minLod == other.minLod && maxLod == other.maxLod;
+    }
+};
+
+class SamplerCache
+{
+public:
+    struct Stats
+    {
+        size_t hits = 0;
+        size_t created = 0;
+    };
+
+    // One cache for the (single) GL context
+    static SamplerCache& shared()
+    {
+        static SamplerCache cache;
+        return cache;
+    }
+
+    // Sampler object for the description, created on first use
+    GLuint get(SamplerDesc desc)
+    {
+        // anisotropy the GPU can't do would only split equal samplers
+        desc.anisotropy = glExt().anisotropic ? clamp(desc.anisotropy, 1.0f, glExt().maxAnisotropy) : 1.0f;
+        // -0 == 0 but hashes differently
+        desc.lodBias += 0.0f;
+        desc.minLod += 0.0f;
+        desc.maxLod += 0.0f;
+        auto found = samplers.find(desc);
+        if (found != samplers.end())
+        {
+            counters.hits++;
+            return found->second;
+        }
+
+        GLuint sampler;
+        glGenSamplers(1, &sampler);
+        glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, desc.wrapS);
+        glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, desc.wrapT);
+        glSamplerParameteri(sampler, GL_TEXTURE_WRAP_R, desc.wrapR);
+        glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, desc.minFilter);
+        glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, desc.magFilter);
+        glSamplerParameterf(sampler, GL_TEXTURE_LOD_BIAS, desc.lodBias);
+        glSamplerParameterf(sampler, GL_TEXTURE_MIN_LOD, desc.minLod);
+        glSamplerParameterf(sampler, GL_TEXTURE_MAX_LOD, desc.maxLod);
+        if (desc.anisotropy > 1.0f)
+            glSamplerParameterf(sampler, GL_TEXTURE_MAX_ANISOTROPY_EXT, desc.anisotropy);
+        samplers[desc] = sampler;
+        counters.created++;
+        return sampler;
+    }
+
+    void destroy()
+    {
+        for (auto& entry : samplers)
+        {
+            glState().forgetSampler(entry.second);
+            glDeleteSamplers(1, &entry.second);
+        }
+        samplers.clear();
+    }
+
+    size_t count() const { return samplers.size(); }
+    const Stats& stats() const { return counters; }
+
+private:
+    struct DescHash
+    {
+        size_t operator()(const SamplerDesc& desc) const
+        {
+            static_assert(sizeof(SamplerDesc) == 9 * 4, "SamplerDesc has padding, hash the fields instead");
+            return (size_t)xxhash64(&desc, sizeof(desc));
+        }
+    };
+
+    std::unordered_map<SamplerDesc, GLuint, DescHash> samplers;
+    Stats counters;
+
+    static float clamp(float value, float low, float high)
+    {
+        return value < low ? low : value > high ? high : value;
+    }
+};
+
+#endif
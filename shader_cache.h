@@ -0,0 +1,119 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include <glad/glad.h>
+
+#include "shader_s.h"
+#include "shader_preprocess.h"
+#include "hash.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdio>
+
+// One program per distinct shader variant:
+//
+//      ShaderCache shaders;
+//      ShaderDefines fogged;
+//      fogged.enable("FOG").define("MAX_LIGHTS", "4");
+//      Shader& lit = shaders.get("Shaders/lit.vs", "Shaders/lit.fs", fogged);
+//
+// Variants are keyed by the hash of the expanded sources and the define set,
+// after dropping the keywords the sources don't declare (#pragma keywords),
+// so asking for the same variant twice, through other paths to the same
+// code, or with keywords it ignores, all give the same Shader. Keys come from
+// the sources as first read, hot reloading a Shader doesn't move it.
+// Call destroy() while the GL context is still alive.
+
+class ShaderCache
+{
+public:
+    struct Stats
+    {
+        size_t requests = 0;
+        size_t hits = 0;        // requests that got an existing program
+    };
+
+    Shader& get(const std::string& vertexPath, const std::string& fragmentPath, const ShaderDefines& defines = ShaderDefines())
+    {
+        counters.requests++;
+        const Sources& sources = sourcesFor(vertexPath, fragmentPath);
+        ShaderDefines used = defines.filtered(sources.keywords);
+        char hash[17];
+        std::snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)sources.hash);
+        // sources that failed to read aren't the same as each other
+        std::string key = (sources.hash ? std::string(hash) : vertexPath + "\n" + fragmentPath) + "|" + used.key();
+
+        std::unordered_map<std::string, std::unique_ptr<Shader>>::iterator it = programs.find(key);
+        if (it != programs.end())
+        {
+            counters.hits++;
+            return *it->second;
+        }
+        // the sources are expanded already, only the defines change per variant
+        Shader* shader = sources.hash ? new Shader(vertexPath.c_str(), fragmentPath.c_str(), used,
+                                                   injectDefines(sources.vertex, used), injectDefines(sources.fragment, used))
+                                      : new Shader(vertexPath.c_str(), fragmentPath.c_str(), used);
+        programs[key].reset(shader);
+        return *shader;
+    }
+
+    // Every program, e.g. for ShaderReloader::add()
+    template <typename Visit>
+    void forEach(Visit visit)
+    {
+        for (std::pair<const std::string, std::unique_ptr<Shader>>& program : programs)
+            visit(*program.second);
+    }
+
+    void destroy()
+    {
+        for (std::pair<const std::string, std::unique_ptr<Shader>>& program : programs)
+            glDeleteProgram(program.second->ID);
+        programs.clear();
+        sources.clear();
+    }
+
+    size_t programCount() const { return programs.size(); }
+    const Stats& stats() const { return counters; }
+
+private:
+    struct Sources
+    {
+        uint64_t hash = 0;                  // of both stages, includes expanded, no defines
+        std::vector<std::string> keywords;  // of both stages, sorted
+        ShaderSource vertex, fragment;      // expanded without defines
+    };
+
+    std::unordered_map<std::string, std::unique_ptr<Shader>> programs;
+    std::unordered_map<std::string, Sources> sources;     // by path pair
+    Stats counters;
+
+    const Sources& sourcesFor(const std::string& vertexPath, const std::string& fragmentPath)
+    {
+        std::string pair = vertexPath + "\n" + fragmentPath;
+        std::unordered_map<std::string, Sources>::iterator it = sources.find(pair);
+        if (it != sources.end())
+            return it->second;
+
+        // a failed read keeps hash 0, the Shader then reports it
+        Sources& entry = sources[pair];
+        ShaderSource& vertex = entry.vertex;
+        ShaderSource& fragment = entry.fragment;
+        ShaderDefines none;
+        if (preprocessShader(vertexPath, none, vertex) && preprocessShader(fragmentPath, none, fragment))
+        {
+            entry.hash = xxhash64(fragment.text.data(), fragment.text.size(), xxhash64(vertex.text.data(), vertex.text.size()));
+            entry.keywords = vertex.keywords;
+            for (const std::string& keyword : fragment.keywords)
+                if (!std::binary_search(entry.keywords.begin(), entry.keywords.end(), keyword))
+                    entry.keywords.insert(std::lower_bound(entry.keywords.begin(), entry.keywords.end(), keyword), keyword);
+        }
+        return entry;
+    }
+};
+
+#endif
@@ -0,0 +1,280 @@
+#ifndef SHADER_PREPROCESS_H
+#define SHADER_PREPROCESS_H
+
+#include "pak.h"
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <iostream>
+
+// What GLSL's own preprocessor doesn't do, before glShaderSource:
+//
+//      #include "lighting.glsl"        relative to the including file, each file
+//                                      at most once per stage (cycles are harmless)
+//      #pragma keywords FOG SHADOWS    the variant keywords this shader knows
+//
+// and the defines of a ShaderDefines injected after #version. Keywords the
+// caller enables become "#define FOG 1" only if the shader declares them, so
+// turning on a keyword a shader doesn't use can't make a new variant of it.
+// #line directives keep compiler errors pointing at the right file and line:
+// the source number is the index in ShaderSource::files.
+// (#include inside a /* */ comment still counts, keep it out of those.)
+
+struct ShaderDefines
+{
+    std::vector<std::pair<std::string, std::string>> values;   // always injected, sorted by name
+    std::vector<std::string> keywords;                         // enabled keywords, sorted
+
+    ShaderDefines& define(const std::string& name, const std::string& value = "1")
+    {
+        std::vector<std::pair<std::string, std::string>>::iterator it = values.begin();
+        while (it != values.end() && it->first < name)
+            ++it;
+        if (it != values.end() && it->first == name)
+            it->second = value;
+        else
+            values.insert(it, std::make_pair(name, value));
+        return *this;
+    }
+
+    ShaderDefines& enable(const std::string& keyword)
+    {
+        std::vector<std::string>::iterator it = std::lower_bound(keywords.begin(), keywords.end(), keyword);
+        if (it == keywords.end() || *it != keyword)
+            keywords.insert(it, keyword);
+        return *this;
+    }
+
+    // only the keywords that are in the sorted 'declared' list
+    ShaderDefines filtered(const std::vector<std::string>& declared) const
+    {
+        ShaderDefines result;
+        result.values = values;
+        for (const std::string& keyword : keywords)
+            if (std::binary_search(declared.begin(), declared.end(), keyword))
+                result.keywords.push_back(keyword);
+        return result;
+    }
+
+    // the same for the same set, whatever order things were added in
+    std::string key() const
+    {
+        std::string key;
+        for (const std::pair<std::string, std::string>& value : values)
+            key += value.first + "=" + value.second + ";";
+        key += "|";
+        for (const std::string& keyword : keywords)
+            key += keyword + ";";
+        return key;
+    }
+};
+
+struct ShaderSource
+{
+    std::string text;                       // ready for glShaderSource
+    std::vector<std::string> files;         // source number in #line -> file, 0 is the shader itself
+    std::vector<std::string> keywords;      // declared with #pragma keywords, sorted
+    size_t definesAt = 0, definesSize = 0;  // the injected #defines in 'text', for injectDefines()
+};
+
+typedef std::function<bool(const std::string& path, std::string& text)> ShaderFileReader;
+
+namespace shader_detail
+{
+    // the #define lines for 'defines', keywords only if 'declared' has them
+    inline std::string defineLines(const ShaderDefines& defines, const std::vector<std::string>& declared)
+    {
+        std::string lines;
+        for (const std::pair<std::string, std::string>& value : defines.values)
+            lines += "#define " + value.first + " " + value.second + "\n";
+        for (const std::string& keyword : defines.filtered(declared).keywords)
+            lines += "#define " + keyword + " 1\n";
+        return lines;
+    }
+
+    inline std::string directoryOf(const std::string& path)
+    {
+        size_t slash = path.find_last_of('/');
+        return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+    }
+
+    // "a/b/../c.glsl" -> "a/c.glsl", so one file has one name
+    inline std::string cleanPath(const std::string& path)
+    {
+        std::vector<std::string> parts;
+        size_t start = 0;
+        bool absolute = !path.empty() && path[0] == '/';
+        while (start <= path.size())
+        {
+            size_t end = path.find('/', start);
+            if (end == std::string::npos)
+                end = path.size();
+            std::string part = path.substr(start, end - start);
+            if (part == "..")
+            {
+                if (!parts.empty() && parts.back() != "..")
+                    parts.pop_back();
+                else if (!absolute)
+                    parts.push_back(part);
+            }
+            else if (!part.empty() && part != ".")
+                parts.push_back(part);
+            start = end + 1;
+        }
+        std::string result = absolute ? "/" : "";
+        for (size_t i = 0; i < parts.size(); i++)
+            result += (i ? "/" : "") + parts[i];
+        return result;
+    }
+
+    // the word after a leading '#', with the rest of the line in 'rest'
+    inline bool directive(const std::string& line, std::string& name, std::string& rest)
+    {
+        size_t i = line.find_first_not_of(" \t");
+        if (i == std::string::npos || line[i] != '#')
+            return false;
+        i = line.find_first_not_of(" \t", i + 1);
+        if (i == std::string::npos)
+            return false;
+        size_t end = line.find_first_of(" \t", i);
+        name = line.substr(i, end == std::string::npos ? std::string::npos : end - i);
+        rest = end == std::string::npos ? std::string() : line.substr(end);
+        return true;
+    }
+
+    struct Expansion
+    {
+        const ShaderFileReader& read;
+        ShaderSource& out;
+        std::string body;
+        size_t versionAt = std::string::npos;   // where the #version line goes in 'body'
+        std::string version;
+        int versionLine = 0;
+
+        Expansion(const ShaderFileReader& reader, ShaderSource& output) : read(reader), out(output) {}
+    };
+
+    inline bool expand(Expansion& e, const std::string& path, const std::string& from, int fromLine)
+    {
+        std::string source;
+        if (!e.read(path, source))
+        {
+            if (from.empty())
+                std::cout << "ERROR::SHADER::FILE_NOT_FOUND " << path << std::endl;
+            else
+                std::cout << "ERROR::SHADER::INCLUDE_NOT_FOUND " << path << " (" << from << ":" << fromLine << ")" << std::endl;
+            return false;
+        }
+        int index = (int)e.out.files.size();
+        e.out.files.push_back(path);
+        if (index)
+            e.body += "#line 1 " + std::to_string(index) + "\n";
+
+        int lineNumber = 0;
+        size_t start = 0;
+        while (start < source.size())
+        {
+            size_t end = source.find('\n', start);
+            if (end == std::string::npos)
+                end = source.size();
+            std::string line = source.substr(start, end - start);
+            start = end + 1;
+            lineNumber++;
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+
+            std::string name, rest;
+            if (!directive(line, name, rest))
+            {
+                e.body += line + "\n";
+                continue;
+            }
+            if (name == "version" && index == 0 && e.versionAt == std::string::npos)
+            {
+                e.versionAt = e.body.size();
+                e.version = line;
+                e.versionLine = lineNumber;
+                continue;
+            }
+            if (name == "include")
+            {
+                size_t open = rest.find_first_of("\"<");
+                size_t close = open == std::string::npos ? open : rest.find_first_of("\">", open + 1);
+                if (close == std::string::npos)
+                {
+                    std::cout << "ERROR::SHADER::BAD_INCLUDE " << path << ":" << lineNumber << std::endl;
+                    return false;
+                }
+                std::string included = cleanPath(directoryOf(path) + rest.substr(open + 1, close - open - 1));
+                if (std::find(e.out.files.begin(), e.out.files.end(), included) == e.out.files.end())
+                {
+                    if (!expand(e, included, path, lineNumber))
+                        return false;
+                    e.body += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(index) + "\n";
+                }
+                else
+                    e.body += "\n";
+                continue;
+            }
+            std::string words;
+            if (name == "pragma" && directive("#" + rest, words, rest) && words == "keywords")
+            {
+                for (size_t i = rest.find_first_not_of(" \t"); i != std::string::npos; i = rest.find_first_not_of(" \t", i))
+                {
+                    size_t end = rest.find_first_of(" \t", i);
+                    std::string keyword = rest.substr(i, end == std::string::npos ? std::string::npos : end - i);
+                    if (!std::binary_search(e.out.keywords.begin(), e.out.keywords.end(), keyword))
+                        e.out.keywords.insert(std::lower_bound(e.out.keywords.begin(), e.out.keywords.end(), keyword), keyword);
+                    i = end;
+                }
+                e.body += "\n";
+                continue;
+            }
+            e.body += line + "\n";
+        }
+        return true;
+    }
+}
+
+// Expands 'path' for glShaderSource with 'defines' injected. Prints what went
+// wrong and returns false if a file is missing.
+inline bool preprocessShader(const std::string& path, const ShaderDefines& defines, ShaderSource& out,
+                             const ShaderFileReader& read = readTextAsset)
+{
+    using namespace shader_detail;
+    out = ShaderSource();
+    Expansion e(read, out);
+    if (!expand(e, cleanPath(path), std::string(), 0))
+        return false;
+
+    // #version has to come first, then the defines, then the code as it was
+    std::string injected = defineLines(defines, out.keywords);
+    if (e.versionAt == std::string::npos)
+    {
+        out.definesAt = 0;
+        out.text = injected + "#line 1 0\n" + e.body;
+    }
+    else
+    {
+        std::string head = e.body.substr(0, e.versionAt) + e.version + "\n";
+        out.definesAt = head.size();
+        out.text = head + injected + "#line " + std::to_string(e.versionLine + 1) + " 0\n" + e.body.substr(e.versionAt);
+    }
+    out.definesSize = injected.size();
+    return true;
+}
+
+// 'source' (from preprocessShader) with 'defines' in place of the ones it was
+// expanded with, without reading or expanding the files again
+inline ShaderSource injectDefines(const ShaderSource& source, const ShaderDefines& defines)
+{
+    ShaderSource out = source;
+    std::string injected = shader_detail::defineLines(defines, source.keywords);
+    out.text.replace(source.definesAt, source.definesSize, injected);
+    out.definesSize = injected.size();
+    return out;
+}
+
+#endif
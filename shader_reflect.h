@@ -0,0 +1,310 @@
+#ifndef SHADER_REFLECT_H
+#define SHADER_REFLECT_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdarg>
+#include <cctype>
+
+// What a linked program takes: its default block uniforms and its uniform
+// blocks with their std140 layout, as the driver reports them.
+//
+//      ProgramReflection reflection = reflectProgram(shader.ID);
+//
+// writeUniformStructs() turns that into C++ (uniform_gen.cpp writes it to a
+// header): a class per program with a setter per uniform that only marks
+// what changed and one upload() that sends those, plus a struct per uniform
+// block laid out like the block, to fill a buffer with.
+
+struct ReflectedUniform
+{
+    std::string name;           // "lights" for an array, "light.color" for a struct member
+    GLenum type = 0;
+    GLint count = 1;            // array length
+    GLint location = -1;        // default block uniforms
+    GLint block = -1;           // block members
+    GLint offset = 0, arrayStride = 0, matrixStride = 0;
+};
+
+struct ReflectedBlock
+{
+    std::string name;
+    GLint dataSize = 0;
+    GLint binding = 0;
+    std::vector<ReflectedUniform> members;      // by offset
+};
+
+struct ProgramReflection
+{
+    std::vector<ReflectedUniform> uniforms;     // the default block, by name
+    std::vector<ReflectedBlock> blocks;
+};
+
+inline ProgramReflection reflectProgram(GLuint program)
+{
+    ProgramReflection reflection;
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> name(maxLength + 1);
+    std::vector<ReflectedUniform> members;
+    for (GLint i = 0; i < count; i++)
+    {
+        ReflectedUniform uniform;
+        GLsizei length = 0;
+        glGetActiveUniform(program, (GLuint)i, (GLsizei)name.size(), &length, &uniform.count, &uniform.type, name.data());
+        uniform.name.assign(name.data(), length);
+        GLuint index = (GLuint)i;
+        glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_BLOCK_INDEX, &uniform.block);
+        glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_OFFSET, &uniform.offset);
+        glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_ARRAY_STRIDE, &uniform.arrayStride);
+        glGetActiveUniformsiv(program, 1, &index, GL_UNIFORM_MATRIX_STRIDE, &uniform.matrixStride);
+        if (uniform.block < 0)
+            uniform.location = glGetUniformLocation(program, name.data());
+        if (uniform.name.size() > 3 && uniform.name.compare(uniform.name.size() - 3, 3, "[0]") == 0)
+            uniform.name.resize(uniform.name.size() - 3);
+        (uniform.block < 0 ? reflection.uniforms : members).push_back(uniform);
+    }
+    std::sort(reflection.uniforms.begin(), reflection.uniforms.end(),
+              [](const ReflectedUniform& a, const ReflectedUniform& b) { return a.name < b.name; });
+
+    GLint blockCount = 0, maxBlockName = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxBlockName);
+    std::vector<char> blockName(maxBlockName + 1);
+    for (GLint b = 0; b < blockCount; b++)
+    {
+        ReflectedBlock block;
+        GLsizei length = 0;
+        glGetActiveUniformBlockName(program, (GLuint)b, (GLsizei)blockName.size(), &length, blockName.data());
+        block.name.assign(blockName.data(), length);
+        glGetActiveUniformBlockiv(program, (GLuint)b, GL_UNIFORM_BLOCK_DATA_SIZE, &block.dataSize);
+        glGetActiveUniformBlockiv(program, (GLuint)b, GL_UNIFORM_BLOCK_BINDING, &block.binding);
+        for (const ReflectedUniform& member : members)
+            if (member.block == b)
+            {
+                block.members.push_back(member);
+                // a named block instance prefixes its members: "PerDraw.model"
+                if (block.members.back().name.compare(0, block.name.size() + 1, block.name + ".") == 0)
+                    block.members.back().name.erase(0, block.name.size() + 1);
+            }
+        std::sort(block.members.begin(), block.members.end(),
+                  [](const ReflectedUniform& a, const ReflectedUniform& b) { return a.offset < b.offset; });
+        reflection.blocks.push_back(block);
+    }
+    return reflection;
+}
+
+namespace reflect_detail
+{
+    struct UniformType
+    {
+        GLenum type;
+        const char* glsl;
+        const char* cpp;            // member type
+        const char* upload;         // the glUniform*v call, before "(location, count, "
+        const char* pointer;        // what the data pointer is cast to
+        const char* initial;
+        int columns, rows;          // rows are components for vectors
+    };
+
+    // samplers are set to a texture unit, bools go as ints like glUniform1i wants
+    inline const UniformType* findType(GLenum type)
+    {
+        static const UniformType types[] = {
+            { GL_FLOAT, "float", "float", "glUniform1fv", "const GLfloat*", "0.0f", 1, 1 },
+            { GL_FLOAT_VEC2, "vec2", "glm::vec2", "glUniform2fv", "const GLfloat*", "glm::vec2(0.0f)", 1, 2 },
+            { GL_FLOAT_VEC3, "vec3", "glm::vec3", "glUniform3fv", "const GLfloat*", "glm::vec3(0.0f)", 1, 3 },
+            { GL_FLOAT_VEC4, "vec4", "glm::vec4", "glUniform4fv", "const GLfloat*", "glm::vec4(0.0f)", 1, 4 },
+            { GL_INT, "int", "int", "glUniform1iv", "const GLint*", "0", 1, 1 },
+            { GL_INT_VEC2, "ivec2", "glm::ivec2", "glUniform2iv", "const GLint*", "glm::ivec2(0)", 1, 2 },
+            { GL_INT_VEC3, "ivec3", "glm::ivec3", "glUniform3iv", "const GLint*", "glm::ivec3(0)", 1, 3 },
+            { GL_INT_VEC4, "ivec4", "glm::ivec4", "glUniform4iv", "const GLint*", "glm::ivec4(0)", 1, 4 },
+            { GL_UNSIGNED_INT, "uint", "unsigned int", "glUniform1uiv", "const GLuint*", "0u", 1, 1 },
+            { GL_UNSIGNED_INT_VEC2, "uvec2", "glm::uvec2", "glUniform2uiv", "const GLuint*", "glm::uvec2(0u)", 1, 2 },
+            { GL_UNSIGNED_INT_VEC3, "uvec3", "glm::uvec3", "glUniform3uiv", "const GLuint*", "glm::uvec3(0u)", 1, 3 },
+            { GL_UNSIGNED_INT_VEC4, "uvec4", "glm::uvec4", "glUniform4uiv", "const GLuint*", "glm::uvec4(0u)", 1, 4 },
+            { GL_BOOL, "bool", "int", "glUniform1iv", "const GLint*", "0", 1, 1 },
+            { GL_BOOL_VEC2, "bvec2", "glm::ivec2", "glUniform2iv", "const GLint*", "glm::ivec2(0)", 1, 2 },
+            { GL_BOOL_VEC3, "bvec3", "glm::ivec3", "glUniform3iv", "const GLint*", "glm::ivec3(0)", 1, 3 },
+            { GL_BOOL_VEC4, "bvec4", "glm::ivec4", "glUniform4iv", "const GLint*", "glm::ivec4(0)", 1, 4 },
+            { GL_FLOAT_MAT2, "mat2", "glm::mat2", "glUniformMatrix2fv", "const GLfloat*", "glm::mat2(1.0f)", 2, 2 },
+            { GL_FLOAT_MAT3, "mat3", "glm::mat3", "glUniformMatrix3fv", "const GLfloat*", "glm::mat3(1.0f)", 3, 3 },
+            { GL_FLOAT_MAT4, "mat4", "glm::mat4", "glUniformMatrix4fv", "const GLfloat*", "glm::mat4(1.0f)", 4, 4 },
+            { GL_FLOAT_MAT2x3, "mat2x3", "glm::mat2x3", "glUniformMatrix2x3fv", "const GLfloat*", "glm::mat2x3(1.0f)", 2, 3 },
+            { GL_FLOAT_MAT2x4, "mat2x4", "glm::mat2x4", "glUniformMatrix2x4fv", "const GLfloat*", "glm::mat2x4(1.0f)", 2, 4 },
+            { GL_FLOAT_MAT3x2, "mat3x2", "glm::mat3x2", "glUniformMatrix3x2fv", "const GLfloat*", "glm::mat3x2(1.0f)", 3, 2 },
+            { GL_FLOAT_MAT3x4, "mat3x4", "glm::mat3x4", "glUniformMatrix3x4fv", "const GLfloat*", "glm::mat3x4(1.0f)", 3, 4 },
+            { GL_FLOAT_MAT4x2, "mat4x2", "glm::mat4x2", "glUniformMatrix4x2fv", "const GLfloat*", "glm::mat4x2(1.0f)", 4, 2 },
+            { GL_FLOAT_MAT4x3, "mat4x3", "glm::mat4x3", "glUniformMatrix4x3fv", "const GLfloat*", "glm::mat4x3(1.0f)", 4, 3 },
+        };
+        static const GLenum samplers[] = {
+            GL_SAMPLER_1D, GL_SAMPLER_2D, GL_SAMPLER_3D, GL_SAMPLER_CUBE, GL_SAMPLER_1D_SHADOW, GL_SAMPLER_2D_SHADOW,
+            GL_SAMPLER_1D_ARRAY, GL_SAMPLER_2D_ARRAY, GL_SAMPLER_1D_ARRAY_SHADOW, GL_SAMPLER_2D_ARRAY_SHADOW,
+            GL_SAMPLER_2D_MULTISAMPLE, GL_SAMPLER_2D_MULTISAMPLE_ARRAY, GL_SAMPLER_CUBE_SHADOW, GL_SAMPLER_BUFFER,
+            GL_SAMPLER_2D_RECT, GL_SAMPLER_2D_RECT_SHADOW, GL_INT_SAMPLER_2D, GL_INT_SAMPLER_3D, GL_INT_SAMPLER_CUBE,
+            GL_INT_SAMPLER_2D_ARRAY, GL_UNSIGNED_INT_SAMPLER_2D, GL_UNSIGNED_INT_SAMPLER_3D, GL_UNSIGNED_INT_SAMPLER_CUBE,
+            GL_UNSIGNED_INT_SAMPLER_2D_ARRAY,
+        };
+        static const UniformType sampler = { 0, "sampler", "int", "glUniform1iv", "const GLint*", "0", 1, 1 };
+        for (const UniformType& t : types)
+            if (t.type == type)
+                return &t;
+        for (GLenum s : samplers)
+            if (s == type)
+                return &sampler;
+        return NULL;
+    }
+
+    inline std::string identifier(const std::string& name)
+    {
+        std::string result = name;
+        for (char& c : result)
+            if (!isalnum((unsigned char)c))
+                c = '_';
+        return result;
+    }
+
+    // "mixValue" -> "setMixValue", "getMixValue"
+    inline std::string accessorName(const char* prefix, const std::string& name)
+    {
+        std::string result = identifier(name);
+        result[0] = (char)toupper((unsigned char)result[0]);
+        return prefix + result;
+    }
+
+    inline std::string format(const char* pattern, ...)
+    {
+        char buffer[512];
+        va_list args;
+        va_start(args, pattern);
+        vsnprintf(buffer, sizeof(buffer), pattern, args);
+        va_end(args);
+        return buffer;
+    }
+
+    // whether the C++ type has the block's layout: vectors and scalars are
+    // packed, std140 pads array elements and matrix columns to 16 bytes
+    inline bool matchesLayout(const UniformType& type, const ReflectedUniform& member)
+    {
+        int columnBytes = type.rows * 4;
+        if (type.columns > 1 && member.matrixStride != columnBytes)
+            return false;
+        return member.count == 1 || member.arrayStride == columnBytes * type.columns;
+    }
+}
+
+// C++ for a program's interface (see the top of this file). 'name' prefixes
+// the class, "Box" gives BoxUniforms. Returns false if something can't be
+// generated, with the reason in 'error'.
+inline bool writeUniformStructs(const ProgramReflection& reflection, const std::string& name, std::string& out, std::string& error)
+{
+    using namespace reflect_detail;
+    std::vector<const UniformType*> types;
+    for (const ReflectedUniform& uniform : reflection.uniforms)
+    {
+        types.push_back(findType(uniform.type));
+        if (!types.back())
+        {
+            error = format("uniform %s has a type this doesn't know (0x%x)", uniform.name.c_str(), uniform.type);
+            return false;
+        }
+    }
+    if (reflection.uniforms.size() > 64)
+    {
+        error = "more than 64 uniforms, the dirty mask is 64 bits";
+        return false;
+    }
+
+    std::string className = name + "Uniforms";
+    out += "// " + className + ": the default uniform block. set*() only marks what\n";
+    out += "// changed, upload(shader) sends those to the shader in use in one pass,\n";
+    out += "// and everything again after a hot reload or for another program.\n";
+    out += "class " + className + "\n{\npublic:\n";
+    for (size_t i = 0; i < reflection.uniforms.size(); i++)
+    {
+        const ReflectedUniform& uniform = reflection.uniforms[i];
+        const UniformType& type = *types[i];
+        std::string member = identifier(uniform.name);
+        std::string parameter = type.columns > 1 || type.rows > 1 ? format("const %s&", type.cpp) : std::string(type.cpp);
+        std::string element = uniform.count > 1 ? member + "[index]" : member;
+        std::string index = uniform.count > 1 ? "int index" : "";
+        out += format("    void %s(%s%s%s value)\n    {\n        if (!(%s == value))\n        {\n",
+                      accessorName("set", uniform.name).c_str(), index.c_str(), index.empty() ? "" : ", ", parameter.c_str(), element.c_str());
+        out += format("            %s = value;\n            dirty |= (uint64_t)1 << %zu;\n        }\n    }\n", element.c_str(), i);
+        out += format("    %s %s(%s) const { return %s; }\n", parameter.c_str(), accessorName("get", uniform.name).c_str(), index.c_str(), element.c_str());
+    }
+
+    out += "\n    void upload(const Shader& shader)\n    {\n";
+    out += "        if (shader.ID != program || shader.reloadCount() != reloads)\n        {\n";
+    out += "            program = shader.ID;\n            reloads = shader.reloadCount();\n";
+    for (size_t i = 0; i < reflection.uniforms.size(); i++)
+        out += format("            locations[%zu] = shader.location(\"%s\"_u);\n", i, reflection.uniforms[i].name.c_str());
+    out += "            dirty = ~(uint64_t)0;\n        }\n";
+    out += "        if (!dirty)\n            return;\n";
+    for (size_t i = 0; i < reflection.uniforms.size(); i++)
+    {
+        const ReflectedUniform& uniform = reflection.uniforms[i];
+        const UniformType& type = *types[i];
+        out += format("        if (dirty & ((uint64_t)1 << %zu))\n            %s(locations[%zu], %d, %s(%s)&%s);\n", i, type.upload, i,
+                      uniform.count, type.columns > 1 ? "GL_FALSE, " : "", type.pointer, identifier(uniform.name).c_str());
+    }
+    out += "        dirty = 0;\n    }\n\nprivate:\n";
+    for (size_t i = 0; i < reflection.uniforms.size(); i++)
+    {
+        const ReflectedUniform& uniform = reflection.uniforms[i];
+        const UniformType& type = *types[i];
+        std::string glsl = type.type ? type.glsl : "sampler, texture unit";
+        if (uniform.count == 1)
+            out += format("    %s %s = %s;    // %s\n", type.cpp, identifier(uniform.name).c_str(), type.initial, glsl.c_str());
+        else
+            out += format("    %s %s[%d] = {};    // %s[%d]\n", type.cpp, identifier(uniform.name).c_str(), uniform.count, glsl.c_str(), uniform.count);
+    }
+    out += format("    GLint locations[%zu];\n", std::max<size_t>(reflection.uniforms.size(), 1));
+    out += "    unsigned int program = 0, reloads = 0;\n";
+    out += "    uint64_t dirty = ~(uint64_t)0;\n};\n";
+
+    for (const ReflectedBlock& block : reflection.blocks)
+    {
+        std::string structName = identifier(block.name) + "Block";
+        out += format("\n// uniform block %s, std140, %d bytes\nstruct %s\n{\n", block.name.c_str(), block.dataSize, structName.c_str());
+        int cursor = 0, padding = 0;
+        std::string checks;
+        for (size_t m = 0; m < block.members.size(); m++)
+        {
+            const ReflectedUniform& member = block.members[m];
+            if (member.offset > cursor)
+                out += format("    uint8_t pad%d[%d];\n", padding++, member.offset - cursor);
+            int end = m + 1 < block.members.size() ? block.members[m + 1].offset : block.dataSize;
+            const UniformType* type = findType(member.type);
+            std::string field = identifier(member.name);
+            if (type && type->type && matchesLayout(*type, member))
+            {
+                out += format("    %s %s", type->cpp, field.c_str());
+                out += member.count > 1 ? format("[%d];\n", member.count) : std::string(";\n");
+                cursor = member.offset + type->columns * type->rows * 4 * member.count;
+            }
+            else
+            {
+                // std140 padding the C++ type doesn't have, written by hand
+                out += format("    uint8_t %s[%d];    // %s%s, std140 strides\n", field.c_str(), end - member.offset,
+                              type ? type->glsl : "?", member.count > 1 ? format("[%d]", member.count).c_str() : "");
+                cursor = end;
+            }
+            checks += format("static_assert(offsetof(%s, %s) == %d, \"%s changed, regenerate\");\n", structName.c_str(),
+                             field.c_str(), member.offset, block.name.c_str());
+        }
+        if (block.dataSize > cursor)
+            out += format("    uint8_t pad%d[%d];\n", padding++, block.dataSize - cursor);
+        out += "};\n";
+        out += checks;
+        out += format("static_assert(sizeof(%s) == %d, \"%s changed, regenerate\");\n", structName.c_str(), block.dataSize, block.name.c_str());
+    }
+    return true;
+}
+
+#endif
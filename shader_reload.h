@@ -0,0 +1,74 @@
+#ifndef SHADER_RELOAD_H
+#define SHADER_RELOAD_H
+
+#include "shader_s.h"
+#include "file_watcher.h"
+#include "async_io.h"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// Recompiles shaders when their source files change on disk, without
+// stopping the frame:
+//
+//      ShaderReloader reloader;
+//      reloader.add(ourShader);
+//      ...once per frame, before the draws:
+//      reloader.update();
+//
+// A change to a source or anything it includes starts Shader::beginReload(),
+// after that update() only polls: the sources are read through AsyncIO and
+// the compile is checked with KHR_parallel_shader_compile where the driver
+// has it, so a frame never waits on either. The shader keeps drawing with
+// its old program until the new one has linked. The shaders must outlive
+// the reloader.
+
+class ShaderReloader
+{
+public:
+    void add(Shader& shader)
+    {
+        shaders.push_back(&shader);
+        watchFiles(shader);
+    }
+
+    void update()
+    {
+        changed.clear();
+        if (watcher.poll(changed))
+            for (Shader* shader : shaders)
+            {
+                std::vector<std::string> files = shader->dependencies();
+                for (const std::string& path : changed)
+                    if (std::find(files.begin(), files.end(), path) != files.end())
+                    {
+                        shader->beginReload();
+                        break;
+                    }
+            }
+
+        bool reloading = false;
+        for (Shader* shader : shaders)
+            reloading |= shader->reloading();
+        if (!reloading)
+            return;
+        AsyncIO::shared().poll();
+        for (Shader* shader : shaders)
+            if (shader->reloading() && shader->pollReload())
+                watchFiles(*shader);    // an edit may have added includes
+    }
+
+private:
+    std::vector<Shader*> shaders;
+    FileWatcher watcher;
+    std::vector<std::string> changed;
+
+    void watchFiles(const Shader& shader)
+    {
+        for (const std::string& file : shader.dependencies())
+            watcher.watch(file);
+    }
+};
+
+#endif
@@ -4,9 +4,19 @@
 #include <glad/glad.h>   // include glad to get all required OpenGL headers
 #include <glm/glm.hpp>
 
+#include "gl_ext.h"
+#include "gl_state_cache.h"
+#include "pak.h"
+#include "async_io.h"
+#include "shader_preprocess.h"
+#include "uniform_id.h"
+
 #include <string>
-#include <fstream>
-#include <sstream>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 
 class Shader
@@ -15,132 +25,458 @@ public:
     // program ID
     unsigned int ID;
 
-    // constructor reads and builds shader
-    Shader(const char* vertexPath, const char* fragmentPath)
+    // constructor reads and builds shader, the variant given by 'defines'
+    // (includes and defines: shader_preprocess.h, shared variants: shader_cache.h)
+    Shader(const char* vertexPath, const char* fragmentPath, const ShaderDefines& defines = ShaderDefines())
+        : vertexFile(vertexPath), fragmentFile(fragmentPath), variant(defines)
+    {
+        // 1. Retrieve the vertex/fragment source code from a mounted pak (pak.h) or filePath, includes expanded
+        ShaderSource vertexCode;
+        ShaderSource fragmentCode;
+        if (!preprocessShader(vertexPath, variant, vertexCode) || !preprocessShader(fragmentPath, variant, fragmentCode))
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+        build(vertexCode, fragmentCode);
+    } 
+
+    // the same from sources the caller already preprocessed with 'defines'
+    // (ShaderCache has them from building its key), the paths are what hot
+    // reload rereads
+    Shader(const char* vertexPath, const char* fragmentPath, const ShaderDefines& defines,
+           const ShaderSource& vertexCode, const ShaderSource& fragmentCode)
+        : vertexFile(vertexPath), fragmentFile(fragmentPath), variant(defines)
     {
-        // 1. Retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
+        build(vertexCode, fragmentCode);
+    }
 
-        // Ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-        try
+    const std::string& vertexPath() const { return vertexFile; }
+    const std::string& fragmentPath() const { return fragmentFile; }
+    const ShaderDefines& defines() const { return variant; }
+
+    // every file the sources were built from, includes too
+    std::vector<std::string> dependencies() const
+    {
+        std::vector<std::string> files = vertexFiles;
+        for (const std::string& file : fragmentFiles)
+            if (std::find(files.begin(), files.end(), file) == files.end())
+                files.push_back(file);
+        return files;
+    }
+
+    // Hot reload (driven by ShaderReloader, shader_reload.h), neither call
+    // waits on the disk or the compiler. beginReload() rereads the source
+    // files and their includes (from disk, an edited file wins over a packed
+    // copy) and compiles them into a new program; call pollReload() once a
+    // frame until it returns true. Only once the new program links does it
+    // replace ID, with the uniforms and block bindings set so far applied to
+    // it; a failed compile prints the log and keeps the old program.
+    void beginReload()
+    {
+        if (reload)
         {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
+            reloadAgain = true;     // changed again while compiling, pick that up next
+            return;
         }
-        catch(std::ifstream::failure e)
+        reload.reset(new Reload());
+        std::shared_ptr<ReloadSources> sources = reload->sources;
+        AsyncIO& io = AsyncIO::shared();
+        for (const std::string& file : dependencies())
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+            sources->remaining++;
+            io.read(file, [sources, file](bool ok, std::vector<uint8_t>& bytes)
+            {
+                if (ok)
+                    sources->texts[file].assign((const char*)bytes.data(), bytes.size());
+                sources->remaining--;
+            }, IO_PRIORITY_HIGH);
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char* fShaderCode = fragmentCode.c_str();
+        io.submit();
+    }
 
-        // 2. Compile shaders
-        unsigned int vertex, fragment;
+    // true when no reload is in progress (any more)
+    bool pollReload()
+    {
+        if (!reload)
+            return true;
+        Reload& r = *reload;
+        if (!r.program)
+        {
+            if (r.sources->remaining > 0)
+                return false;   // AsyncIO callbacks run in AsyncIO::poll()
+            // an include the edit added wasn't read yet, that one is read here
+            std::shared_ptr<ReloadSources> sources = r.sources;
+            ShaderFileReader read = [sources](const std::string& path, std::string& text)
+            {
+                std::unordered_map<std::string, std::string>::iterator it = sources->texts.find(path);
+                if (it != sources->texts.end())
+                {
+                    text = it->second;
+                    return true;
+                }
+                std::vector<uint8_t> bytes;
+                if (!AsyncIO::shared().readFile(path, bytes))
+                    return false;
+                text.assign((const char*)bytes.data(), bytes.size());
+                return true;
+            };
+            ShaderSource vertexCode, fragmentCode;
+            if (!preprocessShader(vertexFile, variant, vertexCode, read) || !preprocessShader(fragmentFile, variant, fragmentCode, read))
+            {
+                std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+                return endReload();
+            }
+            vertexFiles = vertexCode.files;
+            fragmentFiles = fragmentCode.files;
+            r.program = startProgram(vertexCode.text, fragmentCode.text, r.vertex, r.fragment);
+            return false;
+        }
+        // asking for the link status waits until the compiler is done. with
+        // parallel compile the driver says when that's free, without it give it a frame
+        if (glExt().parallelShaderCompile)
+        {
+            GLint done = 0;
+            glGetProgramiv(r.program, GL_COMPLETION_STATUS_KHR, &done);
+            if (!done)
+                return false;
+        }
+        else if (r.frames++ == 0)
+            return false;
 
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        
-        // shader program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
+        bool ok = checkCompileErrors(r.vertex, "VERTEX", &vertexFiles);
+        ok = checkCompileErrors(r.fragment, "FRAGMENT", &fragmentFiles) && ok;
+        ok = checkCompileErrors(r.program, "PROGRAM") && ok;
+        glDeleteShader(r.vertex);
+        glDeleteShader(r.fragment);
+        if (!ok)
+        {
+            glDeleteProgram(r.program);
+            return endReload();
+        }
 
-        // delete the shaders since they are linked into our program and no longer necessary
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-    } 
+        // the swap: the new program gets the old one's state, then replaces it
+        GLint current = 0;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &current);
+        glState().useProgram(r.program);
+        buildUniformTable(r.program);
+        for (const UniformSlot& slot : uniformTable)
+            if (slot.cached.type)
+                applyUniform(slot.location, slot.cached);
+        for (const std::pair<const std::string, unsigned int>& block : blockBindings)
+        {
+            unsigned int index = glGetUniformBlockIndex(r.program, block.first.c_str());
+            if (index != GL_INVALID_INDEX)
+                glUniformBlockBinding(r.program, index, block.second);
+        }
+        glState().useProgram((unsigned int)current == ID ? r.program : (unsigned int)current);
+        glDeleteProgram(ID);
+        ID = r.program;
+        reloads++;
+        return endReload();
+    }
+
+    bool reloading() const { return reload != nullptr; }
+    // programs swapped in by hot reload so far
+    unsigned int reloadCount() const { return reloads; }
 
 
-    // use/active shader
+    // use/active shader, through glState() so it skips a program already in use
     void use()
     {
-        glUseProgram(ID);
+        glState().useProgram(ID);
     }
 
-    // utility uniform functions
-    void setBool(const std::string &name, bool value) const
+    // a uniform's location in the current program, -1 if it isn't active
+    GLint location(UniformId id) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        return uniformSlot(id.hash).location;
     }
-    void setInt(const std::string &name, int value) const
+
+    // utility uniform functions, by UniformId ("model"_u, uniform_id.h): a
+    // lookup in the location table built at link time, no strings involved
+    void setBool(UniformId id, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        setInt(id, (int)value);
     }
-    void setFloat(const std::string &name, float value) const
+    void setInt(UniformId id, int value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        UniformSlot& slot = uniformSlot(id.hash);
+        rememberInt(slot.cached, value);
+        glUniform1i(slot.location, value);
+    }
+    void setFloat(UniformId id, float value) const
+    {
+        UniformSlot& slot = uniformSlot(id.hash);
+        remember(slot.cached, GL_FLOAT, &value, 1);
+        glUniform1f(slot.location, value);
     }
     // -----------------------------------------------------------------------  
-    void setVec2(const std::string &name, const glm::vec2 &value) const
+    void setVec2(UniformId id, const glm::vec2 &value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        UniformSlot& slot = uniformSlot(id.hash);
+        remember(slot.cached, GL_FLOAT_VEC2, &value[0], 2);
+        glUniform2fv(slot.location, 1, &value[0]);
     }
-    void setVec2(const std::string &name, float x, float y) const
+    void setVec2(UniformId id, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        setVec2(id, glm::vec2(x, y));
     }
     // --------------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
+    void setVec3(UniformId id, const glm::vec3 &value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        UniformSlot& slot = uniformSlot(id.hash);
+        remember(slot.cached, GL_FLOAT_VEC3, &value[0], 3);
+        glUniform3fv(slot.location, 1, &value[0]);
     }
-    void setVec3(const std::string &name, float x, float y, float z) const
+    void setVec3(UniformId id, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        setVec3(id, glm::vec3(x, y, z));
     }
     // --------------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
+    void setVec4(UniformId id, const glm::vec4 &value) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        UniformSlot& slot = uniformSlot(id.hash);
+        remember(slot.cached, GL_FLOAT_VEC4, &value[0], 4);
+        glUniform4fv(slot.location, 1, &value[0]);
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w) const
+    void setVec4(UniformId id, float x, float y, float z, float w) const
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        setVec4(id, glm::vec4(x, y, z, w));
     }
     // --------------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    void setMat2(UniformId id, const glm::mat2 &mat) const
+    {
+        UniformSlot& slot = uniformSlot(id.hash);
+        remember(slot.cached, GL_FLOAT_MAT2, &mat[0][0], 4);
+        glUniformMatrix2fv(slot.location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat3(UniformId id, const glm::mat3 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        UniformSlot& slot = uniformSlot(id.hash);
+        remember(slot.cached, GL_FLOAT_MAT3, &mat[0][0], 9);
+        glUniformMatrix3fv(slot.location, 1, GL_FALSE, &mat[0][0]);
     }
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    void setMat4(UniformId id, const glm::mat4 &mat) const
     {
-        glUniformMatrix3fv(glad_glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        UniformSlot& slot = uniformSlot(id.hash);
+        remember(slot.cached, GL_FLOAT_MAT4, &mat[0][0], 16);
+        glUniformMatrix4fv(slot.location, 1, GL_FALSE, &mat[0][0]);
     }
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    // --------------------------------------------------------------------------------
+    // the same by name, hashed on every call
+    void setBool(const std::string &name, bool value) const { setBool(UniformId(name.c_str(), name.size()), value); }
+    void setInt(const std::string &name, int value) const { setInt(UniformId(name.c_str(), name.size()), value); }
+    void setFloat(const std::string &name, float value) const { setFloat(UniformId(name.c_str(), name.size()), value); }
+    void setVec2(const std::string &name, const glm::vec2 &value) const { setVec2(UniformId(name.c_str(), name.size()), value); }
+    void setVec2(const std::string &name, float x, float y) const { setVec2(UniformId(name.c_str(), name.size()), x, y); }
+    void setVec3(const std::string &name, const glm::vec3 &value) const { setVec3(UniformId(name.c_str(), name.size()), value); }
+    void setVec3(const std::string &name, float x, float y, float z) const { setVec3(UniformId(name.c_str(), name.size()), x, y, z); }
+    void setVec4(const std::string &name, const glm::vec4 &value) const { setVec4(UniformId(name.c_str(), name.size()), value); }
+    void setVec4(const std::string &name, float x, float y, float z, float w) const { setVec4(UniformId(name.c_str(), name.size()), x, y, z, w); }
+    void setMat2(const std::string &name, const glm::mat2 &mat) const { setMat2(UniformId(name.c_str(), name.size()), mat); }
+    void setMat3(const std::string &name, const glm::mat3 &mat) const { setMat3(UniformId(name.c_str(), name.size()), mat); }
+    void setMat4(const std::string &name, const glm::mat4 &mat) const { setMat4(UniformId(name.c_str(), name.size()), mat); }
+    // --------------------------------------------------------------------------------
+    // connect a uniform block to a buffer binding point (GLSL 330 has no layout(binding))
+    void setBlockBinding(const std::string &name, unsigned int binding) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        blockBindings[name] = binding;
+        unsigned int index = glGetUniformBlockIndex(ID, name.c_str());
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
     }
 
 
 private:
+    std::string vertexFile, fragmentFile;
+    ShaderDefines variant;
+    std::vector<std::string> vertexFiles, fragmentFiles;    // source numbers in compile errors
+
+    // what set*() last gave a uniform, so a reloaded program can get it too
+    struct CachedUniform
+    {
+        GLenum type = 0;        // 0 until set
+        GLint value;
+        float values[16];
+    };
+    // The location table: open addressing on the name hash, filled with the
+    // active uniforms at link time. Names that aren't active get a slot
+    // (location -1, which glUniform ignores) the first time they're set, so
+    // their values survive a reload that makes them active.
+    struct UniformSlot
+    {
+        uint64_t hash = 0;      // 0 is empty
+        GLint location = -1;
+        CachedUniform cached;
+    };
+    mutable std::vector<UniformSlot> uniformTable;
+    mutable size_t uniformCount = 0;
+    mutable std::unordered_map<std::string, unsigned int> blockBindings;
+
+    struct ReloadSources
+    {
+        std::unordered_map<std::string, std::string> texts;     // what could be read
+        int remaining = 0;
+    };
+    struct Reload
+    {
+        // shared with the read callbacks, which may outlive the reload
+        std::shared_ptr<ReloadSources> sources = std::make_shared<ReloadSources>();
+        unsigned int vertex = 0, fragment = 0, program = 0;
+        int frames = 0;
+    };
+    std::unique_ptr<Reload> reload;
+    bool reloadAgain = false;
+    unsigned int reloads = 0;
+
+    void build(const ShaderSource& vertexCode, const ShaderSource& fragmentCode)
+    {
+        vertexFiles = vertexCode.files;
+        fragmentFiles = fragmentCode.files;
+
+        // 2. Compile shaders and link them, 3. check the results
+        unsigned int vertex, fragment;
+        ID = startProgram(vertexCode.text, fragmentCode.text, vertex, fragment);
+        checkCompileErrors(vertex, "VERTEX", &vertexFiles);
+        checkCompileErrors(fragment, "FRAGMENT", &fragmentFiles);
+        checkCompileErrors(ID, "PROGRAM");
+        buildUniformTable(ID);
+
+        // delete the shaders since they are linked into our program and no longer necessary
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+    }
+
+    bool endReload()
+    {
+        reload.reset();
+        if (reloadAgain)
+        {
+            reloadAgain = false;
+            beginReload();
+            return false;
+        }
+        return true;
+    }
+
+    // compiles and links without looking at the results, which would wait for the compiler
+    static unsigned int startProgram(const std::string& vertexCode, const std::string& fragmentCode,
+                                     unsigned int& vertex, unsigned int& fragment)
+    {
+        const char* vShaderCode = vertexCode.c_str();
+        const char* fShaderCode = fragmentCode.c_str();
+        // vertex shader
+        vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vertex, 1, &vShaderCode, NULL);
+        glCompileShader(vertex);
+        // fragment shader
+        fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fragment, 1, &fShaderCode, NULL);
+        glCompileShader(fragment);
+        // shader program
+        unsigned int program = glCreateProgram();
+        glAttachShader(program, vertex);
+        glAttachShader(program, fragment);
+        glLinkProgram(program);
+        return program;
+    }
+
+    UniformSlot& uniformSlot(uint64_t hash) const
+    {
+        size_t mask = uniformTable.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask)
+        {
+            UniformSlot& slot = uniformTable[i];
+            if (slot.hash == hash)
+                return slot;
+            if (!slot.hash)
+            {
+                if ((uniformCount + 1) * 2 > uniformTable.size())
+                {
+                    // at most half full keeps the probes short
+                    std::vector<UniformSlot> old(uniformTable.size() * 2);
+                    old.swap(uniformTable);
+                    uniformCount = 0;
+                    for (const UniformSlot& moved : old)
+                        if (moved.hash)
+                            uniformSlot(moved.hash) = moved;
+                    return uniformSlot(hash);
+                }
+                slot.hash = hash;
+                uniformCount++;
+                return slot;
+            }
+        }
+    }
+
+    // Locations of all active uniforms, array elements one by one. Values
+    // set on the previous program come along.
+    void buildUniformTable(unsigned int program)
+    {
+        std::vector<UniformSlot> previous(16);
+        previous.swap(uniformTable);
+        uniformCount = 0;
+        GLint active = 0, maxLength = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &active);
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<char> name(maxLength + 1);
+        for (GLint i = 0; i < active; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type;
+            glGetActiveUniform(program, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, name.data());
+            GLint location = glGetUniformLocation(program, name.data());
+            if (location < 0)
+                continue;   // in a uniform block
+            std::string uniform(name.data(), length);
+            if (uniform.size() > 3 && uniform.compare(uniform.size() - 3, 3, "[0]") == 0)
+            {
+                // arrays answer to "lights" and "lights[0]", and each "lights[i]"
+                uniform.resize(uniform.size() - 3);
+                uniformSlot(UniformId(uniform.c_str(), uniform.size()).hash).location = location;
+                for (GLint element = 0; element < size; element++)
+                {
+                    std::string indexed = uniform + "[" + std::to_string(element) + "]";
+                    uniformSlot(UniformId(indexed.c_str(), indexed.size()).hash).location =
+                        element ? glGetUniformLocation(program, indexed.c_str()) : location;
+                }
+            }
+            else
+                uniformSlot(UniformId(uniform.c_str(), uniform.size()).hash).location = location;
+        }
+        for (const UniformSlot& old : previous)
+            if (old.hash && old.cached.type)
+                uniformSlot(old.hash).cached = old.cached;
+    }
+
+    static void remember(CachedUniform& uniform, GLenum type, const float* values, int count)
+    {
+        uniform.type = type;
+        memcpy(uniform.values, values, count * sizeof(float));
+    }
+
+    static void rememberInt(CachedUniform& uniform, int value)
+    {
+        uniform.type = GL_INT;
+        uniform.value = value;
+    }
+
+    static void applyUniform(GLint location, const CachedUniform& uniform)
+    {
+        switch (uniform.type)
+        {
+        case GL_INT: glUniform1i(location, uniform.value); break;
+        case GL_FLOAT: glUniform1fv(location, 1, uniform.values); break;
+        case GL_FLOAT_VEC2: glUniform2fv(location, 1, uniform.values); break;
+        case GL_FLOAT_VEC3: glUniform3fv(location, 1, uniform.values); break;
+        case GL_FLOAT_VEC4: glUniform4fv(location, 1, uniform.values); break;
+        case GL_FLOAT_MAT2: glUniformMatrix2fv(location, 1, GL_FALSE, uniform.values); break;
+        case GL_FLOAT_MAT3: glUniformMatrix3fv(location, 1, GL_FALSE, uniform.values); break;
+        case GL_FLOAT_MAT4: glUniformMatrix4fv(location, 1, GL_FALSE, uniform.values); break;
+        }
+    }
+
     // Check shader compilation/linking errors
-    void checkCompileErrors(unsigned int shader, std::string type)
+    bool checkCompileErrors(unsigned int shader, std::string type, const std::vector<std::string>* files = NULL)
     {
         int success;
         char infoLog[1024];
@@ -150,7 +486,11 @@ private:
             if (!success)
             {
                 glGetShaderInfoLog(shader, 1024, NULL, infoLog);
-                std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << "\n -- -------------------------";
+                std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog;
+                // the number before the line in the log is the file
+                for (size_t i = 0; files && files->size() > 1 && i < files->size(); i++)
+                    std::cout << i << ": " << (*files)[i] << "\n";
+                std::cout << "\n -- -------------------------";
             }
 
         }
@@ -163,6 +503,7 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -------------------------------";
             }
         }
+        return success != 0;
     }
     
 };
@@ -0,0 +1,116 @@
+// Generated by uniform_gen from Shaders/shader.vs and Shaders/shader.fs, don't edit.
+// Regenerate with uniform_gen (`make uniforms`) after changing the shader's uniforms.
+#ifndef SHADER_UNIFORMS_H
+#define SHADER_UNIFORMS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader_s.h"
+#include "uniform_id.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// BoxUniforms: the default uniform block. set*() only marks what
+// changed, upload(shader) sends those to the shader in use in one pass,
+// and everything again after a hot reload or for another program.
+class BoxUniforms
+{
+public:
+    void setMixValue(float value)
+    {
+        if (!(mixValue == value))
+        {
+            mixValue = value;
+            dirty |= (uint64_t)1 << 0;
+        }
+    }
+    float getMixValue() const { return mixValue; }
+    void setProjection(const glm::mat4& value)
+    {
+        if (!(projection == value))
+        {
+            projection = value;
+            dirty |= (uint64_t)1 << 1;
+        }
+    }
+    const glm::mat4& getProjection() const { return projection; }
+    void setTexture1(int value)
+    {
+        if (!(texture1 == value))
+        {
+            texture1 = value;
+            dirty |= (uint64_t)1 << 2;
+        }
+    }
+    int getTexture1() const { return texture1; }
+    void setTexture2(int value)
+    {
+        if (!(texture2 == value))
+        {
+            texture2 = value;
+            dirty |= (uint64_t)1 << 3;
+        }
+    }
+    int getTexture2() const { return texture2; }
+    void setView(const glm::mat4& value)
+    {
+        if (!(view == value))
+        {
+            view = value;
+            dirty |= (uint64_t)1 << 4;
+        }
+    }
+    const glm::mat4& getView() const { return view; }
+
+    void upload(const Shader& shader)
+    {
+        if (shader.ID != program || shader.reloadCount() != reloads)
+        {
+            program = shader.ID;
+            reloads = shader.reloadCount();
+            locations[0] = shader.location("mixValue"_u);
+            locations[1] = shader.location("projection"_u);
+            locations[2] = shader.location("texture1"_u);
+            locations[3] = shader.location("texture2"_u);
+            locations[4] = shader.location("view"_u);
+            dirty = ~(uint64_t)0;
+        }
+        if (!dirty)
+            return;
+        if (dirty & ((uint64_t)1 << 0))
+            glUniform1fv(locations[0], 1, (const GLfloat*)&mixValue);
+        if (dirty & ((uint64_t)1 << 1))
+            glUniformMatrix4fv(locations[1], 1, GL_FALSE, (const GLfloat*)&projection);
+        if (dirty & ((uint64_t)1 << 2))
+            glUniform1iv(locations[2], 1, (const GLint*)&texture1);
+        if (dirty & ((uint64_t)1 << 3))
+            glUniform1iv(locations[3], 1, (const GLint*)&texture2);
+        if (dirty & ((uint64_t)1 << 4))
+            glUniformMatrix4fv(locations[4], 1, GL_FALSE, (const GLfloat*)&view);
+        dirty = 0;
+    }
+
+private:
+    float mixValue = 0.0f;    // float
+    glm::mat4 projection = glm::mat4(1.0f);    // mat4
+    int texture1 = 0;    // sampler, texture unit
+    int texture2 = 0;    // sampler, texture unit
+    glm::mat4 view = glm::mat4(1.0f);    // mat4
+    GLint locations[5];
+    unsigned int program = 0, reloads = 0;
+    uint64_t dirty = ~(uint64_t)0;
+};
+
+// uniform block PerDraw, std140, 80 bytes
+struct PerDrawBlock
+{
+    glm::mat4 model;
+    glm::vec4 uvRect;
+};
+static_assert(offsetof(PerDrawBlock, model) == 0, "PerDraw changed, regenerate");
+static_assert(offsetof(PerDrawBlock, uvRect) == 64, "PerDraw changed, regenerate");
+static_assert(sizeof(PerDrawBlock) == 80, "PerDraw changed, regenerate");
+
+#endif
@@ -426,6 +426,17 @@ STBIDEF stbi_uc *stbi_load_from_file  (FILE *f, int *x, int *y, int *channels_in
 // for stbi_load_from_file, file pointer is left pointing immediately after image
 #endif
 
+// Decode into caller memory (e.g. a mapped pixel buffer object) instead of a
+// new buffer: image row r goes to dest + r*dest_stride, or to row height-1-r
+// when flipping on load. The image must be exactly width x height (ask
+// stbi_info first) and desired_channels can't be 0. JPEGs are written there
+// directly by the decoder, other formats are decoded as usual and copied over
+// once. Returns 1 on success, 0 (see stbi_failure_reason) otherwise.
+STBIDEF int      stbi_load_from_memory_into(stbi_uc const *buffer, int len, stbi_uc *dest, int dest_stride, int width, int height, int desired_channels);
+#ifndef STBI_NO_STDIO
+STBIDEF int      stbi_load_into            (char const *filename, stbi_uc *dest, int dest_stride, int width, int height, int desired_channels);
+#endif
+
 #ifndef STBI_NO_GIF
 STBIDEF stbi_uc *stbi_load_gif_from_memory(stbi_uc const *buffer, int len, int **delays, int *x, int *y, int *z, int *comp, int req_comp);
 #endif
@@ -514,6 +525,31 @@ STBIDEF void stbi_convert_iphone_png_to_rgb(int flag_true_if_should_convert);
 // flip the image vertically, so the first pixel in the output array is the bottom left
 STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip);
 
+// SIMD kernel selection for JPEG (IDCT, upsampling, YCbCr->RGB) and PNG
+// (unfiltering). The default picks the best level the CPU supports at runtime;
+// forcing a lower level is mainly useful for benchmarking. Levels the CPU or
+// build doesn't have fall back down.
+enum
+{
+   STBI_SIMD_AUTO   = 0,
+   STBI_SIMD_SCALAR = 1,
+   STBI_SIMD_SSE2   = 2,   // or NEON on ARM
+   STBI_SIMD_AVX2   = 3
+};
+STBIDEF void stbi_set_simd_level(int level);
+// the level decodes will actually use with the current setting
+STBIDEF int  stbi_get_simd_level(void);
+
+// Parallel JPEG decoding. Hand stb_image a "parallel for" from your job system:
+// it must call task(arg, i) for every i in [0, count) (on any threads) and
+// return only when all calls have finished. Once set, baseline JPEGs with
+// restart markers are entropy decoded one restart interval per task, JPEGs
+// without them get their IDCTs done in parallel, and upsampling/colour
+// conversion is split into horizontal strips. Pass NULL to go back to serial.
+typedef void stbi_parallel_task(void *arg, int index);
+typedef void stbi_parallel_for_func(void *user, int count, stbi_parallel_task *task, void *arg);
+STBIDEF void stbi_set_parallel_for(stbi_parallel_for_func *parallel_for, void *user);
+
 // as above, but only applies to images loaded on the thread that calls the function
 // this function is only available if your compiler supports thread-local variables;
 // calling it will fail to link if your compiler doesn't
@@ -640,12 +676,14 @@ typedef unsigned short stbi__uint16;
 typedef   signed short stbi__int16;
 typedef unsigned int   stbi__uint32;
 typedef   signed int   stbi__int32;
+typedef unsigned __int64 stbi__uint64;
 #else
 #include <stdint.h>
 typedef uint16_t stbi__uint16;
 typedef int16_t  stbi__int16;
 typedef uint32_t stbi__uint32;
 typedef int32_t  stbi__int32;
+typedef uint64_t stbi__uint64;
 #endif
 
 // should produce compiler error if size is wrong
@@ -747,7 +785,7 @@ static int stbi__cpuid3(void)
 
 #define STBI_SIMD_ALIGN(type, name) __declspec(align(16)) type name
 
-#if !defined(STBI_NO_JPEG) && defined(STBI_SSE2)
+#ifdef STBI_SSE2
 static int stbi__sse2_available(void)
 {
    int info3 = stbi__cpuid3();
@@ -758,7 +796,7 @@ static int stbi__sse2_available(void)
 #else // assume GCC-style if not VC++
 #define STBI_SIMD_ALIGN(type, name) type name __attribute__((aligned(16)))
 
-#if !defined(STBI_NO_JPEG) && defined(STBI_SSE2)
+#ifdef STBI_SSE2
 static int stbi__sse2_available(void)
 {
    // If we're even attempting to compile this on GCC/Clang, that means
@@ -771,6 +809,36 @@ static int stbi__sse2_available(void)
 #endif
 #endif
 
+// AVX2: compiled with a per-function target attribute so the rest of the file
+// doesn't need -mavx2, and only used when the CPU reports it at runtime.
+// #define STBI_NO_AVX2 to leave it out.
+#if defined(STBI_SSE2) && !defined(STBI_NO_AVX2) \
+    && (defined(_MSC_VER) || defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define STBI_AVX2
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#define STBI__AVX2_TARGET
+static int stbi__avx2_available(void)
+{
+   int info[4];
+   __cpuid(info,1);
+   // the OS has to save the ymm registers (OSXSAVE + XCR0 bits 1,2)
+   if (!((info[2] >> 27) & 1) || (_xgetbv(0) & 6) != 6)
+      return 0;
+   __cpuidex(info,7,0);
+   return ((info[1] >> 5) & 1) != 0;
+}
+#else
+#define STBI__AVX2_TARGET __attribute__((target("avx2")))
+static int stbi__avx2_available(void)
+{
+   // also checks OS support for the ymm state
+   return __builtin_cpu_supports("avx2");
+}
+#endif
+#endif
+
 // ARM NEON
 #if defined(STBI_NO_SIMD) && defined(STBI_NEON)
 #undef STBI_NEON
@@ -789,6 +857,32 @@ static int stbi__sse2_available(void)
 #define STBI_SIMD_ALIGN(type, name) type name
 #endif
 
+static int stbi__simd_level_setting = STBI_SIMD_AUTO;
+
+STBIDEF void stbi_set_simd_level(int level)
+{
+   stbi__simd_level_setting = level;
+}
+
+STBIDEF int stbi_get_simd_level(void)
+{
+   int best = STBI_SIMD_SCALAR;
+#ifdef STBI_SSE2
+   if (stbi__sse2_available())
+      best = STBI_SIMD_SSE2;
+#endif
+#ifdef STBI_NEON
+   best = STBI_SIMD_SSE2;
+#endif
+#ifdef STBI_AVX2
+   if (best == STBI_SIMD_SSE2 && stbi__avx2_available())
+      best = STBI_SIMD_AVX2;
+#endif
+   if (stbi__simd_level_setting != STBI_SIMD_AUTO && stbi__simd_level_setting < best)
+      return stbi__simd_level_setting;
+   return best;
+}
+
 #ifndef STBI_MAX_DIMENSIONS
 #define STBI_MAX_DIMENSIONS (1 << 24)
 #endif
@@ -905,6 +999,7 @@ typedef struct
 #ifndef STBI_NO_JPEG
 static int      stbi__jpeg_test(stbi__context *s);
 static void    *stbi__jpeg_load(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri);
+static int      stbi__jpeg_load_into(stbi__context *s, stbi_uc *dest, int dest_stride, int flip, int width, int height, int req_comp);
 static int      stbi__jpeg_info(stbi__context *s, int *x, int *y, int *comp);
 #endif
 
@@ -1263,6 +1358,41 @@ static unsigned char *stbi__load_and_postprocess_8bit(stbi__context *s, int *x,
    return (unsigned char *) result;
 }
 
+static int stbi__load_into(stbi__context *s, stbi_uc *dest, int dest_stride, int width, int height, int req_comp)
+{
+   stbi__result_info ri;
+   void *result;
+   int x, y, comp, j, row_bytes;
+   int flip = stbi__vertically_flip_on_load;
+
+   if (req_comp < 1 || req_comp > 4) return stbi__err("bad req_comp", "Internal error");
+   if (width <= 0 || height <= 0 || !stbi__mul2sizes_valid(width, req_comp)) return stbi__err("bad size", "Invalid destination size");
+   row_bytes = width * req_comp;
+   if (dest_stride < row_bytes) return stbi__err("bad stride", "Destination stride smaller than a row");
+
+   #ifndef STBI_NO_JPEG
+   if (stbi__jpeg_test(s))
+      return stbi__jpeg_load_into(s, dest, dest_stride, flip, width, height, req_comp);
+   #endif
+
+   // other formats decode into their own buffer, copy once with the flip folded in
+   result = stbi__load_main(s, &x, &y, &comp, req_comp, &ri, 8);
+   if (result == NULL)
+      return 0;
+   if (ri.bits_per_channel != 8)
+      result = stbi__convert_16_to_8((stbi__uint16 *) result, x, y, req_comp);
+   if (result == NULL)
+      return 0;
+   if (x != width || y != height) {
+      STBI_FREE(result);
+      return stbi__err("size mismatch", "Image size differs from the destination");
+   }
+   for (j=0; j < height; ++j)
+      memcpy(dest + (size_t) dest_stride * (flip ? height-1-j : j), (stbi_uc *) result + (size_t) row_bytes * j, row_bytes);
+   STBI_FREE(result);
+   return 1;
+}
+
 static stbi__uint16 *stbi__load_and_postprocess_16bit(stbi__context *s, int *x, int *y, int *comp, int req_comp)
 {
    stbi__result_info ri;
@@ -1420,6 +1550,27 @@ STBIDEF stbi_uc *stbi_load_from_callbacks(stbi_io_callbacks const *clbk, void *u
    return stbi__load_and_postprocess_8bit(&s,x,y,comp,req_comp);
 }
 
+STBIDEF int stbi_load_from_memory_into(stbi_uc const *buffer, int len, stbi_uc *dest, int dest_stride, int width, int height, int desired_channels)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   return stbi__load_into(&s, dest, dest_stride, width, height, desired_channels);
+}
+
+#ifndef STBI_NO_STDIO
+STBIDEF int stbi_load_into(char const *filename, stbi_uc *dest, int dest_stride, int width, int height, int desired_channels)
+{
+   int result;
+   stbi__context s;
+   FILE *f = stbi__fopen(filename, "rb");
+   if (!f) return stbi__err("can't fopen", "Unable to open file");
+   stbi__start_file(&s,f);
+   result = stbi__load_into(&s, dest, dest_stride, width, height, desired_channels);
+   fclose(f);
+   return result;
+}
+#endif
+
 #ifndef STBI_NO_GIF
 STBIDEF stbi_uc *stbi_load_gif_from_memory(stbi_uc const *buffer, int len, int **delays, int *x, int *y, int *z, int *comp, int req_comp)
 {
@@ -1973,6 +2124,7 @@ typedef struct
 
    int scan_n, order[4];
    int restart_interval, todo;
+   int deferred_idct;   // parallel mode: baseline blocks were stored in coeff, IDCT still to do
 
 // kernels
    void (*idct_block_kernel)(stbi_uc *out, int out_stride, short data[64]);
@@ -2878,6 +3030,127 @@ static void stbi__idct_simd(stbi_uc *out, int out_stride, short data[64])
 
 #endif // STBI_NEON
 
+#ifdef STBI_AVX2
+// avx2 integer IDCT. every register holds one row of 8 coefficients widened
+// to 32 bits, so the column pass does all 8 columns at once with exactly the
+// arithmetic of stbi__idct_block and the output is bit-identical to it.
+// (the all-zero AC shortcut of the scalar version gives the same values as
+// the full computation, so it isn't needed here.)
+
+#define stbi__avx2_f2f(x) _mm256_set1_epi32(stbi__f2f(x))
+
+// same as STBI__IDCT_1D, on 8 lanes; results in x0..x3, t0..t3
+#define STBI__IDCT_1D_AVX2(s0,s1,s2,s3,s4,s5,s6,s7) \
+   p2 = s2;                                                            \
+   p3 = s6;                                                            \
+   p1 = _mm256_mullo_epi32(_mm256_add_epi32(p2,p3), stbi__avx2_f2f(0.5411961f));  \
+   t2 = _mm256_add_epi32(p1, _mm256_mullo_epi32(p3, stbi__avx2_f2f(-1.847759065f))); \
+   t3 = _mm256_add_epi32(p1, _mm256_mullo_epi32(p2, stbi__avx2_f2f( 0.765366865f))); \
+   p2 = s0;                                                            \
+   p3 = s4;                                                            \
+   t0 = _mm256_slli_epi32(_mm256_add_epi32(p2,p3), 12);                \
+   t1 = _mm256_slli_epi32(_mm256_sub_epi32(p2,p3), 12);                \
+   x0 = _mm256_add_epi32(t0,t3);                                       \
+   x3 = _mm256_sub_epi32(t0,t3);                                       \
+   x1 = _mm256_add_epi32(t1,t2);                                       \
+   x2 = _mm256_sub_epi32(t1,t2);                                       \
+   t0 = s7;                                                            \
+   t1 = s5;                                                            \
+   t2 = s3;                                                            \
+   t3 = s1;                                                            \
+   p3 = _mm256_add_epi32(t0,t2);                                       \
+   p4 = _mm256_add_epi32(t1,t3);                                       \
+   p1 = _mm256_add_epi32(t0,t3);                                       \
+   p2 = _mm256_add_epi32(t1,t2);                                       \
+   p5 = _mm256_mullo_epi32(_mm256_add_epi32(p3,p4), stbi__avx2_f2f( 1.175875602f)); \
+   t0 = _mm256_mullo_epi32(t0, stbi__avx2_f2f( 0.298631336f));         \
+   t1 = _mm256_mullo_epi32(t1, stbi__avx2_f2f( 2.053119869f));         \
+   t2 = _mm256_mullo_epi32(t2, stbi__avx2_f2f( 3.072711026f));         \
+   t3 = _mm256_mullo_epi32(t3, stbi__avx2_f2f( 1.501321110f));         \
+   p1 = _mm256_add_epi32(p5, _mm256_mullo_epi32(p1, stbi__avx2_f2f(-0.899976223f))); \
+   p2 = _mm256_add_epi32(p5, _mm256_mullo_epi32(p2, stbi__avx2_f2f(-2.562915447f))); \
+   p3 = _mm256_mullo_epi32(p3, stbi__avx2_f2f(-1.961570560f));         \
+   p4 = _mm256_mullo_epi32(p4, stbi__avx2_f2f(-0.390180644f));         \
+   t3 = _mm256_add_epi32(t3, _mm256_add_epi32(p1,p4));                 \
+   t2 = _mm256_add_epi32(t2, _mm256_add_epi32(p2,p3));                 \
+   t1 = _mm256_add_epi32(t1, _mm256_add_epi32(p2,p4));                 \
+   t0 = _mm256_add_epi32(t0, _mm256_add_epi32(p1,p3));
+
+// 8x8 transpose of 32-bit lanes, r[i] becomes column i
+#define STBI__TRANSPOSE_AVX2(r) { \
+   __m256i a0 = _mm256_unpacklo_epi32(r[0],r[1]), a1 = _mm256_unpackhi_epi32(r[0],r[1]); \
+   __m256i a2 = _mm256_unpacklo_epi32(r[2],r[3]), a3 = _mm256_unpackhi_epi32(r[2],r[3]); \
+   __m256i a4 = _mm256_unpacklo_epi32(r[4],r[5]), a5 = _mm256_unpackhi_epi32(r[4],r[5]); \
+   __m256i a6 = _mm256_unpacklo_epi32(r[6],r[7]), a7 = _mm256_unpackhi_epi32(r[6],r[7]); \
+   __m256i b0 = _mm256_unpacklo_epi64(a0,a2), b1 = _mm256_unpackhi_epi64(a0,a2);        \
+   __m256i b2 = _mm256_unpacklo_epi64(a1,a3), b3 = _mm256_unpackhi_epi64(a1,a3);        \
+   __m256i b4 = _mm256_unpacklo_epi64(a4,a6), b5 = _mm256_unpackhi_epi64(a4,a6);        \
+   __m256i b6 = _mm256_unpacklo_epi64(a5,a7), b7 = _mm256_unpackhi_epi64(a5,a7);        \
+   r[0] = _mm256_permute2x128_si256(b0,b4,0x20); r[4] = _mm256_permute2x128_si256(b0,b4,0x31); \
+   r[1] = _mm256_permute2x128_si256(b1,b5,0x20); r[5] = _mm256_permute2x128_si256(b1,b5,0x31); \
+   r[2] = _mm256_permute2x128_si256(b2,b6,0x20); r[6] = _mm256_permute2x128_si256(b2,b6,0x31); \
+   r[3] = _mm256_permute2x128_si256(b3,b7,0x20); r[7] = _mm256_permute2x128_si256(b3,b7,0x31); \
+}
+
+STBI__AVX2_TARGET static void stbi__idct_avx2(stbi_uc *out, int out_stride, short data[64])
+{
+   __m256i r[8], v[8];
+   __m256i p1,p2,p3,p4,p5,t0,t1,t2,t3,x0,x1,x2,x3,bias;
+   int i;
+
+   for (i=0; i < 8; ++i)
+      r[i] = _mm256_cvtepi16_epi32(_mm_loadu_si128((__m128i *) (data + i*8)));
+
+   // columns: every lane is one column, the rows come out in place
+   STBI__IDCT_1D_AVX2(r[0],r[1],r[2],r[3],r[4],r[5],r[6],r[7])
+   bias = _mm256_set1_epi32(512);
+   x0 = _mm256_add_epi32(x0,bias); x1 = _mm256_add_epi32(x1,bias);
+   x2 = _mm256_add_epi32(x2,bias); x3 = _mm256_add_epi32(x3,bias);
+   v[0] = _mm256_srai_epi32(_mm256_add_epi32(x0,t3), 10);
+   v[7] = _mm256_srai_epi32(_mm256_sub_epi32(x0,t3), 10);
+   v[1] = _mm256_srai_epi32(_mm256_add_epi32(x1,t2), 10);
+   v[6] = _mm256_srai_epi32(_mm256_sub_epi32(x1,t2), 10);
+   v[2] = _mm256_srai_epi32(_mm256_add_epi32(x2,t1), 10);
+   v[5] = _mm256_srai_epi32(_mm256_sub_epi32(x2,t1), 10);
+   v[3] = _mm256_srai_epi32(_mm256_add_epi32(x3,t0), 10);
+   v[4] = _mm256_srai_epi32(_mm256_sub_epi32(x3,t0), 10);
+
+   // rows: transpose so every lane is one row, then the same 1D pass
+   STBI__TRANSPOSE_AVX2(v)
+   STBI__IDCT_1D_AVX2(v[0],v[1],v[2],v[3],v[4],v[5],v[6],v[7])
+   bias = _mm256_set1_epi32(65536 + (128<<17));
+   x0 = _mm256_add_epi32(x0,bias); x1 = _mm256_add_epi32(x1,bias);
+   x2 = _mm256_add_epi32(x2,bias); x3 = _mm256_add_epi32(x3,bias);
+   r[0] = _mm256_srai_epi32(_mm256_add_epi32(x0,t3), 17);
+   r[7] = _mm256_srai_epi32(_mm256_sub_epi32(x0,t3), 17);
+   r[1] = _mm256_srai_epi32(_mm256_add_epi32(x1,t2), 17);
+   r[6] = _mm256_srai_epi32(_mm256_sub_epi32(x1,t2), 17);
+   r[2] = _mm256_srai_epi32(_mm256_add_epi32(x2,t1), 17);
+   r[5] = _mm256_srai_epi32(_mm256_sub_epi32(x2,t1), 17);
+   r[3] = _mm256_srai_epi32(_mm256_add_epi32(x3,t0), 17);
+   r[4] = _mm256_srai_epi32(_mm256_sub_epi32(x3,t0), 17);
+
+   // back to one row per register, then saturate to bytes (same as stbi__clamp)
+   STBI__TRANSPOSE_AVX2(r)
+   for (i=0; i < 8; i += 4) {
+      // packs works per 128-bit lane; the permute puts each row's 8 shorts together
+      __m256i w01 = _mm256_permute4x64_epi64(_mm256_packs_epi32(r[i+0], r[i+1]), 0xd8);
+      __m256i w23 = _mm256_permute4x64_epi64(_mm256_packs_epi32(r[i+2], r[i+3]), 0xd8);
+      __m256i b = _mm256_packus_epi16(w01, w23);   // lane 0: rows i, i+2; lane 1: rows i+1, i+3
+      __m128i lo = _mm256_castsi256_si128(b);
+      __m128i hi = _mm256_extracti128_si256(b, 1);
+      _mm_storel_epi64((__m128i *) (out + (i+0)*out_stride), lo);
+      _mm_storel_epi64((__m128i *) (out + (i+1)*out_stride), hi);
+      _mm_storel_epi64((__m128i *) (out + (i+2)*out_stride), _mm_srli_si128(lo, 8));
+      _mm_storel_epi64((__m128i *) (out + (i+3)*out_stride), _mm_srli_si128(hi, 8));
+   }
+}
+
+#undef STBI__TRANSPOSE_AVX2
+#undef STBI__IDCT_1D_AVX2
+#undef stbi__avx2_f2f
+#endif // STBI_AVX2
+
 #define STBI__MARKER_none  0xff
 // if there's a pending marker from the entropy stream, return that
 // otherwise, fetch from the stream and get a marker. if there's no
@@ -2912,8 +3185,289 @@ static void stbi__jpeg_reset(stbi__jpeg *j)
    // since we don't even allow 1<<30 pixels
 }
 
+//////////////////////////////////////////////////////////////////////////////
+//
+//  parallel baseline decoding, used once stbi_set_parallel_for() was called
+//
+
+static stbi_parallel_for_func *stbi__parallel_for = NULL;
+static void *stbi__parallel_for_user = NULL;
+
+static int stbi__min(int a, int b)
+{
+   return a < b ? a : b;
+}
+
+STBIDEF void stbi_set_parallel_for(stbi_parallel_for_func *parallel_for, void *user)
+{
+   stbi__parallel_for = parallel_for;
+   stbi__parallel_for_user = user;
+}
+
+static void stbi__jpeg_store_block(stbi__jpeg *z, int n, int bx, int by, short *data, int to_coeff)
+{
+   if (to_coeff)
+      memcpy(z->img_comp[n].coeff + 64 * (bx + by * z->img_comp[n].coeff_w), data, 64 * sizeof(short));
+   else
+      z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*by*8+bx*8, z->img_comp[n].w2, data);
+}
+
+// decode MCUs [first, first+count) of the current baseline scan, same block
+// order as stbi__parse_entropy_coded_data but without restart handling (the
+// caller resets at interval boundaries). with to_coeff the dequantized blocks
+// are kept in img_comp[].coeff for a later IDCT pass instead of IDCT'd here.
+static int stbi__jpeg_decode_mcus(stbi__jpeg *z, int first, int count, int to_coeff)
+{
+   STBI_SIMD_ALIGN(short, data[64]);
+   int m;
+   for (m=first; m < first+count; ++m) {
+      if (z->scan_n == 1) {
+         int n = z->order[0];
+         int w = (z->img_comp[n].x+7) >> 3;
+         int ha = z->img_comp[n].ha;
+         if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+         stbi__jpeg_store_block(z, n, m % w, m / w, data, to_coeff);
+      } else {
+         int i = m % z->img_mcu_x, j = m / z->img_mcu_x;
+         int k,x,y;
+         for (k=0; k < z->scan_n; ++k) {
+            int n = z->order[k];
+            for (y=0; y < z->img_comp[n].v; ++y) {
+               for (x=0; x < z->img_comp[n].h; ++x) {
+                  int ha = z->img_comp[n].ha;
+                  if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+                  stbi__jpeg_store_block(z, n, i*z->img_comp[n].h + x, j*z->img_comp[n].v + y, data, to_coeff);
+               }
+            }
+         }
+      }
+   }
+   return 1;
+}
+
+// Reads the entropy-coded bytes of the current scan up to the marker that ends
+// it, recording where every restart interval begins. Memory sources are scanned
+// in place, callback sources are copied into *owned (free it afterwards). The
+// terminating marker is left in z->marker, as the serial decoder would.
+static int stbi__jpeg_find_restarts(stbi__jpeg *z, stbi_uc **bytes, int *length, int **starts, int *count, stbi_uc **owned)
+{
+   stbi__context *s = z->s;
+   int in_place = !s->read_from_callbacks;
+   stbi_uc *begin = s->img_buffer;
+   int len = 0, cap = 0, n = 1, ncap = 64;
+   int *st = (int *) stbi__malloc(ncap * sizeof(int));
+   stbi_uc *buf = NULL;
+   if (!st) return stbi__err("outofmem", "Out of memory");
+   st[0] = 0;
+   *owned = NULL;
+
+   for (;;) {
+      stbi_uc b, m;
+      if (stbi__at_eof(s)) break;
+      b = stbi__get8(s);
+      if (b == 0xff) {
+         m = stbi__get8(s);
+         while (m == 0xff) m = stbi__get8(s);   // fill bytes
+         if (m != 0 && !STBI__RESTART(m)) { z->marker = m; break; }
+         if (m == 0) {
+            // stuffed zero: keep both bytes, the huffman decoder expects them
+            if (!in_place) {
+               if (len + 2 > cap) {
+                  int ncap2 = cap ? cap*2 : 65536;
+                  stbi_uc *grown = (stbi_uc *) STBI_REALLOC_SIZED(buf, cap, ncap2);
+                  if (!grown) { STBI_FREE(buf); STBI_FREE(st); return stbi__err("outofmem", "Out of memory"); }
+                  buf = grown; cap = ncap2;
+               }
+               buf[len] = 0xff; buf[len+1] = 0;
+            }
+            len += 2;
+            continue;
+         }
+         // RSTn: the next interval starts after the marker, leave the
+         // marker bytes in place so the previous interval ends on them
+         if (!in_place) {
+            if (len + 2 > cap) {
+               int ncap2 = cap ? cap*2 : 65536;
+               stbi_uc *grown = (stbi_uc *) STBI_REALLOC_SIZED(buf, cap, ncap2);
+               if (!grown) { STBI_FREE(buf); STBI_FREE(st); return stbi__err("outofmem", "Out of memory"); }
+               buf = grown; cap = ncap2;
+            }
+            buf[len] = 0xff; buf[len+1] = m;
+         }
+         len += 2;
+         if (n == ncap) {
+            int *grown = (int *) STBI_REALLOC_SIZED(st, ncap * sizeof(int), ncap * 2 * sizeof(int));
+            if (!grown) { STBI_FREE(buf); STBI_FREE(st); return stbi__err("outofmem", "Out of memory"); }
+            st = grown; ncap *= 2;
+         }
+         st[n++] = len;
+         continue;
+      }
+      if (!in_place) {
+         if (len + 1 > cap) {
+            int ncap2 = cap ? cap*2 : 65536;
+            stbi_uc *grown = (stbi_uc *) STBI_REALLOC_SIZED(buf, cap, ncap2);
+            if (!grown) { STBI_FREE(buf); STBI_FREE(st); return stbi__err("outofmem", "Out of memory"); }
+            buf = grown; cap = ncap2;
+         }
+         buf[len] = b;
+      }
+      ++len;
+   }
+
+   *bytes = in_place ? begin : buf;
+   *owned = buf;
+   *length = len;
+   *starts = st;
+   *count = n;
+   return 1;
+}
+
+typedef struct
+{
+   stbi__jpeg *z;
+   stbi_uc *bytes;
+   int length;
+   int *starts;            // byte offset of each restart interval
+   int intervals;
+   int intervals_per_task;
+   int total_mcus;
+   int failed;
+   int misaligned;         // the scan doesn't end where its mcus do
+} stbi__jpeg_restart_job;
+
+// the marker the serial decoder reads when the scan stops at w's position: the
+// rst it resets on after a full last interval, then whatever marker comes
+// next; running off the end of the data means the scan's own end marker
+static int stbi__jpeg_marker_after_scan(stbi__jpeg *w, int full_interval, int end_marker)
+{
+   if (full_interval) {
+      if (w->code_bits < 24) stbi__grow_buffer_unsafe(w);
+      if (STBI__RESTART(w->marker)) w->marker = STBI__MARKER_none;
+   }
+   if (w->marker != STBI__MARKER_none) return w->marker;
+   while (!stbi__at_eof(w->s))
+      if (stbi__get8(w->s) == 0xff) return stbi__get8(w->s);
+   return end_marker;
+}
+
+static void stbi__jpeg_restart_task(void *arg, int index)
+{
+   stbi__jpeg_restart_job *job = (stbi__jpeg_restart_job *) arg;
+   stbi__context ctx;
+   int r = index * job->intervals_per_task;
+   int end = stbi__min(r + job->intervals_per_task, job->intervals);
+   // private decoder state: same tables, own bit buffer and dc predictors
+   stbi__jpeg *w = (stbi__jpeg *) stbi__malloc(sizeof(stbi__jpeg));
+   if (!w) { job->failed = 1; return; }
+   memcpy(w, job->z, sizeof(*w));
+   w->s = &ctx;
+   for (; r < end; ++r) {
+      int first = r * job->z->restart_interval;
+      int count = stbi__min(job->z->restart_interval, job->total_mcus - first);
+      if (count <= 0) break;
+      stbi__start_mem(&ctx, job->bytes + job->starts[r], job->length - job->starts[r]);
+      stbi__jpeg_reset(w);
+      if (!stbi__jpeg_decode_mcus(w, first, count, 0)) { job->failed = 1; break; }
+      // like the serial decoder: an interval that doesn't end on an rst ends
+      // the scan, and so does the last mcu; either way the next marker has to
+      // be the one after the scan, not more data or intervals
+      if (first + count < job->total_mcus) {
+         if (w->code_bits < 24) stbi__grow_buffer_unsafe(w);
+         if (STBI__RESTART(w->marker)) continue;
+      }
+      if (stbi__jpeg_marker_after_scan(w, first + count == job->total_mcus && count == job->z->restart_interval,
+                                       job->z->marker) != job->z->marker) {
+         job->misaligned = 1;
+         break;
+      }
+   }
+   STBI_FREE(w);
+}
+
+static int stbi__parse_entropy_coded_data_parallel(stbi__jpeg *z)
+{
+   int total, n;
+   if (z->scan_n == 1) {
+      n = z->order[0];
+      total = ((z->img_comp[n].x+7) >> 3) * ((z->img_comp[n].y+7) >> 3);
+   } else {
+      total = z->img_mcu_x * z->img_mcu_y;
+   }
+   stbi__jpeg_reset(z);
+
+   if (z->restart_interval) {
+      // every restart interval starts with fresh dc predictors on a byte
+      // boundary, so they can be decoded independently
+      stbi__jpeg_restart_job job;
+      stbi_uc *owned;
+      int tasks;
+      if (!stbi__jpeg_find_restarts(z, &job.bytes, &job.length, &job.starts, &job.intervals, &owned)) return 0;
+      job.z = z;
+      job.total_mcus = total;
+      job.failed = 0;
+      job.misaligned = 0;
+      // a few intervals per task so tiny intervals don't drown in overhead
+      tasks = stbi__min(job.intervals, 256);
+      job.intervals_per_task = (job.intervals + tasks - 1) / tasks;
+      tasks = (job.intervals + job.intervals_per_task - 1) / job.intervals_per_task;
+      stbi__parallel_for(stbi__parallel_for_user, tasks, stbi__jpeg_restart_task, &job);
+      STBI_FREE(job.starts);
+      if (owned) STBI_FREE(owned);
+      if (job.failed) return stbi__err("bad huffman code","Corrupt JPEG");
+      // the serial decoder stops the scan there and then fails on the marker after it
+      if (job.misaligned) return stbi__err("unknown marker","Corrupt JPEG");
+      return 1;
+   }
+
+   // no restart markers: entropy decoding is inherently serial, so keep the
+   // blocks and run all IDCTs in parallel once every scan has been read
+   for (n=0; n < z->s->img_n; ++n) {
+      if (!z->img_comp[n].raw_coeff) {
+         z->img_comp[n].coeff_w = z->img_comp[n].w2 / 8;
+         z->img_comp[n].coeff_h = z->img_comp[n].h2 / 8;
+         z->img_comp[n].raw_coeff = stbi__malloc_mad3(z->img_comp[n].w2, z->img_comp[n].h2, sizeof(short), 15);
+         if (z->img_comp[n].raw_coeff == NULL) return stbi__err("outofmem", "Out of memory");
+         z->img_comp[n].coeff = (short*) (((size_t) z->img_comp[n].raw_coeff + 15) & ~15);
+      }
+   }
+   z->deferred_idct = 1;
+   return stbi__jpeg_decode_mcus(z, 0, total, 1);
+}
+
+#define STBI__IDCT_TASK_ROWS 4   // block rows per IDCT task
+
+static void stbi__jpeg_idct_task(void *arg, int index)
+{
+   stbi__jpeg *z = (stbi__jpeg *) arg;
+   int n,i,j;
+   for (n=0; n < z->s->img_n; ++n) {
+      int w = (z->img_comp[n].x+7) >> 3;
+      int h = (z->img_comp[n].y+7) >> 3;
+      int groups = (h + STBI__IDCT_TASK_ROWS-1) / STBI__IDCT_TASK_ROWS;
+      if (index >= groups) { index -= groups; continue; }
+      for (j=index*STBI__IDCT_TASK_ROWS; j < h && j < (index+1)*STBI__IDCT_TASK_ROWS; ++j) {
+         for (i=0; i < w; ++i) {
+            short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
+            z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+         }
+      }
+      return;
+   }
+}
+
+static void stbi__jpeg_idct_parallel(stbi__jpeg *z)
+{
+   int n, tasks = 0;
+   for (n=0; n < z->s->img_n; ++n)
+      tasks += (((z->img_comp[n].y+7) >> 3) + STBI__IDCT_TASK_ROWS-1) / STBI__IDCT_TASK_ROWS;
+   stbi__parallel_for(stbi__parallel_for_user, tasks, stbi__jpeg_idct_task, z);
+}
+
 static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
 {
+   if (stbi__parallel_for && !z->progressive)
+      return stbi__parse_entropy_coded_data_parallel(z);
    stbi__jpeg_reset(z);
    if (!z->progressive) {
       if (z->scan_n == 1) {
@@ -3360,6 +3914,7 @@ static int stbi__decode_jpeg_image(stbi__jpeg *j)
       j->img_comp[m].raw_coeff = NULL;
    }
    j->restart_interval = 0;
+   j->deferred_idct = 0;
    if (!stbi__decode_jpeg_header(j, STBI__SCAN_load)) return 0;
    m = stbi__get_marker(j);
    while (!stbi__EOI(m)) {
@@ -3389,6 +3944,8 @@ static int stbi__decode_jpeg_image(stbi__jpeg *j)
    }
    if (j->progressive)
       stbi__jpeg_finish(j);
+   else if (j->deferred_idct)
+      stbi__jpeg_idct_parallel(j);
    return 1;
 }
 
@@ -3589,6 +4146,62 @@ static stbi_uc *stbi__resample_row_hv_2_simd(stbi_uc *out, stbi_uc *in_near, stb
 }
 #endif
 
+#ifdef STBI_AVX2
+// 16 input pixels per iteration, otherwise the same as stbi__resample_row_hv_2_simd
+STBI__AVX2_TARGET static stbi_uc *stbi__resample_row_hv_2_avx2(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+{
+   int i=0,t0,t1;
+
+   if (w == 1) {
+      out[0] = out[1] = stbi__div4(3*in_near[0] + in_far[0] + 2);
+      return out;
+   }
+
+   t1 = 3*in_near[0] + in_far[0];
+   for (; i < ((w-1) & ~15); i += 16) {
+      // vertical pass: 3*near + far = 4*near + (far - near)
+      __m256i farw  = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (in_far + i)));
+      __m256i nearw = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (in_near + i)));
+      __m256i curr  = _mm256_add_epi16(_mm256_slli_epi16(nearw, 2), _mm256_sub_epi16(farw, nearw));
+
+      // shift the whole row by one pixel each way; byte shifts are per 128-bit
+      // lane so the neighbouring lane is brought in with a permute first
+      __m256i lowlane  = _mm256_permute2x128_si256(curr, curr, 0x08);  // [0, curr.lo]
+      __m256i highlane = _mm256_permute2x128_si256(curr, curr, 0x81);  // [curr.hi, 0]
+      __m256i prev = _mm256_insert_epi16(_mm256_alignr_epi8(curr, lowlane, 14), t1, 0);
+      __m256i next = _mm256_insert_epi16(_mm256_alignr_epi8(highlane, curr, 2), 3*in_near[i+16] + in_far[i+16], 15);
+
+      // horizontal pass, polyphase: even = 4*cur + (prev - cur), odd = 4*cur + (next - cur)
+      __m256i curb = _mm256_add_epi16(_mm256_slli_epi16(curr, 2), _mm256_set1_epi16(8));
+      __m256i even = _mm256_add_epi16(_mm256_sub_epi16(prev, curr), curb);
+      __m256i odd  = _mm256_add_epi16(_mm256_sub_epi16(next, curr), curb);
+
+      // interleave even/odd; per lane this yields pixels in order so a plain store works
+      __m256i int0 = _mm256_srli_epi16(_mm256_unpacklo_epi16(even, odd), 4);
+      __m256i int1 = _mm256_srli_epi16(_mm256_unpackhi_epi16(even, odd), 4);
+      _mm256_storeu_si256((__m256i *) (out + i*2), _mm256_packus_epi16(int0, int1));
+
+      t1 = 3*in_near[i+15] + in_far[i+15];
+   }
+
+   t0 = t1;
+   t1 = 3*in_near[i] + in_far[i];
+   out[i*2] = stbi__div16(3*t1 + t0 + 8);
+
+   for (++i; i < w; ++i) {
+      t0 = t1;
+      t1 = 3*in_near[i]+in_far[i];
+      out[i*2-1] = stbi__div16(3*t0 + t1 + 8);
+      out[i*2  ] = stbi__div16(3*t1 + t0 + 8);
+   }
+   out[w*2-1] = stbi__div4(t1+2);
+
+   STBI_NOTUSED(hs);
+
+   return out;
+}
+#endif
+
 static stbi_uc *stbi__resample_row_generic(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
 {
    // resample with nearest-neighbor
@@ -3763,26 +4376,98 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc cons
 }
 #endif
 
+#ifdef STBI_AVX2
+// 16 pixels per iteration, same fixed-point math as stbi__YCbCr_to_RGB_simd.
+// unlike the sse2 version this also handles step == 3, which is what plain
+// RGB jpeg loads (req_comp 0 or 3) use.
+STBI__AVX2_TARGET static void stbi__YCbCr_to_RGB_avx2(stbi_uc *out, stbi_uc const *y, stbi_uc const *pcb, stbi_uc const *pcr, int count, int step)
+{
+   int i = 0;
+
+   if (step == 4 || step == 3) {
+      __m256i cr_const0 = _mm256_set1_epi16(   (short) ( 1.40200f*4096.0f+0.5f));
+      __m256i cr_const1 = _mm256_set1_epi16( - (short) ( 0.71414f*4096.0f+0.5f));
+      __m256i cb_const0 = _mm256_set1_epi16( - (short) ( 0.34414f*4096.0f+0.5f));
+      __m256i cb_const1 = _mm256_set1_epi16(   (short) ( 1.77200f*4096.0f+0.5f));
+      __m256i y_bias = _mm256_set1_epi16(128);
+      __m256i xw = _mm256_set1_epi16(255); // alpha channel
+      __m128i signflip = _mm_set1_epi8(-0x80);
+      // per 128-bit lane: drop every 4th byte of 4 RGBX pixels -> 12 RGB bytes
+      __m256i rgb_shuffle = _mm256_setr_epi8(0,1,2,4,5,6,8,9,10,12,13,14,-1,-1,-1,-1,
+                                             0,1,2,4,5,6,8,9,10,12,13,14,-1,-1,-1,-1);
+
+      // the 3-byte path writes 4 bytes past each group, so it stops while a
+      // later pixel (written afterwards) still covers the overrun
+      for (; i+15 < count && (step == 4 || i+17 < count); i += 16) {
+         // load and widen; (y << 8) + 128 and (c - 128) << 8 like the sse2 unpacks
+         __m256i yw  = _mm256_or_si256(_mm256_slli_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (y+i))), 8), y_bias);
+         __m256i crw = _mm256_slli_epi16(_mm256_cvtepi8_epi16(_mm_xor_si128(_mm_loadu_si128((__m128i *) (pcr+i)), signflip)), 8);
+         __m256i cbw = _mm256_slli_epi16(_mm256_cvtepi8_epi16(_mm_xor_si128(_mm_loadu_si128((__m128i *) (pcb+i)), signflip)), 8);
+
+         // color transform
+         __m256i yws = _mm256_srli_epi16(yw, 4);
+         __m256i cr0 = _mm256_mulhi_epi16(cr_const0, crw);
+         __m256i cb0 = _mm256_mulhi_epi16(cb_const0, cbw);
+         __m256i cb1 = _mm256_mulhi_epi16(cbw, cb_const1);
+         __m256i cr1 = _mm256_mulhi_epi16(crw, cr_const1);
+         __m256i rw  = _mm256_srai_epi16(_mm256_add_epi16(cr0, yws), 4);
+         __m256i bw  = _mm256_srai_epi16(_mm256_add_epi16(yws, cb1), 4);
+         __m256i gw  = _mm256_srai_epi16(_mm256_add_epi16(_mm256_add_epi16(cb0, yws), cr1), 4);
+
+         // back to bytes and interleave; each lane holds 8 pixels as two groups of 4
+         __m256i brb = _mm256_packus_epi16(rw, bw);
+         __m256i gxb = _mm256_packus_epi16(gw, xw);
+         __m256i t0 = _mm256_unpacklo_epi8(brb, gxb);
+         __m256i t1 = _mm256_unpackhi_epi8(brb, gxb);
+         __m256i o0 = _mm256_unpacklo_epi16(t0, t1);   // pixels 0-3 | 8-11
+         __m256i o1 = _mm256_unpackhi_epi16(t0, t1);   // pixels 4-7 | 12-15
+
+         if (step == 4) {
+            _mm256_storeu_si256((__m256i *) (out +  0), _mm256_permute2x128_si256(o0, o1, 0x20));
+            _mm256_storeu_si256((__m256i *) (out + 32), _mm256_permute2x128_si256(o0, o1, 0x31));
+            out += 64;
+         } else {
+            __m256i p0 = _mm256_shuffle_epi8(o0, rgb_shuffle);
+            __m256i p1 = _mm256_shuffle_epi8(o1, rgb_shuffle);
+            _mm_storeu_si128((__m128i *) (out +  0), _mm256_castsi256_si128(p0));
+            _mm_storeu_si128((__m128i *) (out + 12), _mm256_castsi256_si128(p1));
+            _mm_storeu_si128((__m128i *) (out + 24), _mm256_extracti128_si256(p0, 1));
+            _mm_storeu_si128((__m128i *) (out + 36), _mm256_extracti128_si256(p1, 1));
+            out += 48;
+         }
+      }
+   }
+
+   // the rest goes through the scalar row converter
+   if (i < count)
+      stbi__YCbCr_to_RGB_row(out, y+i, pcb+i, pcr+i, count-i, step);
+}
+#endif
+
 // set up the kernels
 static void stbi__setup_jpeg(stbi__jpeg *j)
 {
+   int level = stbi_get_simd_level();
    j->idct_block_kernel = stbi__idct_block;
    j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_row;
    j->resample_row_hv_2_kernel = stbi__resample_row_hv_2;
 
-#ifdef STBI_SSE2
-   if (stbi__sse2_available()) {
+#if defined(STBI_SSE2) || defined(STBI_NEON)
+   if (level >= STBI_SIMD_SSE2) {
       j->idct_block_kernel = stbi__idct_simd;
       j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
       j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_simd;
    }
 #endif
 
-#ifdef STBI_NEON
-   j->idct_block_kernel = stbi__idct_simd;
-   j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
-   j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_simd;
+#ifdef STBI_AVX2
+   if (level >= STBI_SIMD_AVX2) {
+      j->idct_block_kernel = stbi__idct_avx2;
+      j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_avx2;
+      j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_avx2;
+   }
 #endif
+   STBI_NOTUSED(level);
 }
 
 // clean up the temporary component buffers
@@ -3808,7 +4493,186 @@ static stbi_uc stbi__blinn_8x8(stbi_uc x, stbi_uc y)
    return (stbi_uc) ((t + (t >>8)) >> 8);
 }
 
-static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp, int req_comp)
+// where converted rows go: image row j lands at pixels + stride*j, or at
+// pixels + stride*(img_y-1-j) when flipping
+typedef struct
+{
+   stbi_uc *pixels;
+   size_t stride;
+   int flip;
+   int width, height;   // caller's buffer size when decoding into caller memory
+   int n, decode_n, is_rgb;
+} stbi__jpeg_output;
+
+// resample and colour convert output rows [y0, y1). res_comp must hold the
+// resampler state for row y0. some converters (n == 3, CMYK to grey) write one
+// byte past the end of a row; if spare_row is given, the row whose extra byte could land in another
+// strip or past the end of the buffer (the last row, or the first when flipping)
+// is built there and copied out. for every other row the byte is put back when
+// it isn't the start of a row still to come: when flipping (the image row above,
+// already done) or when the stride leaves padding after the row (caller's bytes).
+static void stbi__jpeg_convert_rows(stbi__jpeg *z, stbi__resample *res_comp, stbi_uc **linebuf, const stbi__jpeg_output *o,
+                                    int y0, int y1, stbi_uc *spare_row)
+{
+   int k, j;
+   unsigned int i;
+   int n = o->n, decode_n = o->decode_n, is_rgb = o->is_rgb;
+   stbi_uc *coutput[4] = { NULL, NULL, NULL, NULL };
+   for (j=y0; j < y1; ++j) {
+      stbi_uc *row = o->pixels + o->stride * (o->flip ? (int) z->s->img_y-1-j : j);
+      int edge = o->flip ? j == y0 : j == y1-1;
+      stbi_uc *out = (spare_row && edge) ? spare_row : row;
+      stbi_uc *after = (!edge && (o->flip || o->stride != (size_t) n * z->s->img_x)) ? row + n * z->s->img_x : NULL;
+      stbi_uc saved = after ? *after : 0;
+      int spare = out != row;
+      for (k=0; k < decode_n; ++k) {
+         stbi__resample *r = &res_comp[k];
+         int y_bot = r->ystep >= (r->vs >> 1);
+         coutput[k] = r->resample(linebuf[k],
+                                  y_bot ? r->line1 : r->line0,
+                                  y_bot ? r->line0 : r->line1,
+                                  r->w_lores, r->hs);
+         if (++r->ystep >= r->vs) {
+            r->ystep = 0;
+            r->line0 = r->line1;
+            if (++r->ypos < z->img_comp[k].y)
+               r->line1 += z->img_comp[k].w2;
+         }
+      }
+      if (n >= 3) {
+         stbi_uc *y = coutput[0];
+         if (z->s->img_n == 3) {
+            if (is_rgb) {
+               for (i=0; i < z->s->img_x; ++i) {
+                  out[0] = y[i];
+                  out[1] = coutput[1][i];
+                  out[2] = coutput[2][i];
+                  out[3] = 255;
+                  out += n;
+               }
+            } else {
+               z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+            }
+         } else if (z->s->img_n == 4) {
+            if (z->app14_color_transform == 0) { // CMYK
+               for (i=0; i < z->s->img_x; ++i) {
+                  stbi_uc m = coutput[3][i];
+                  out[0] = stbi__blinn_8x8(coutput[0][i], m);
+                  out[1] = stbi__blinn_8x8(coutput[1][i], m);
+                  out[2] = stbi__blinn_8x8(coutput[2][i], m);
+                  out[3] = 255;
+                  out += n;
+               }
+            } else if (z->app14_color_transform == 2) { // YCCK
+               z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+               for (i=0; i < z->s->img_x; ++i) {
+                  stbi_uc m = coutput[3][i];
+                  out[0] = stbi__blinn_8x8(255 - out[0], m);
+                  out[1] = stbi__blinn_8x8(255 - out[1], m);
+                  out[2] = stbi__blinn_8x8(255 - out[2], m);
+                  out += n;
+               }
+            } else { // YCbCr + alpha?  Ignore the fourth channel for now
+               z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+            }
+         } else
+            for (i=0; i < z->s->img_x; ++i) {
+               out[0] = out[1] = out[2] = y[i];
+               out[3] = 255; // not used if n==3
+               out += n;
+            }
+      } else {
+         if (is_rgb) {
+            if (n == 1)
+               for (i=0; i < z->s->img_x; ++i)
+                  *out++ = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
+            else {
+               for (i=0; i < z->s->img_x; ++i, out += 2) {
+                  out[0] = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
+                  out[1] = 255;
+               }
+            }
+         } else if (z->s->img_n == 4 && z->app14_color_transform == 0) {
+            for (i=0; i < z->s->img_x; ++i) {
+               stbi_uc m = coutput[3][i];
+               stbi_uc r = stbi__blinn_8x8(coutput[0][i], m);
+               stbi_uc g = stbi__blinn_8x8(coutput[1][i], m);
+               stbi_uc b = stbi__blinn_8x8(coutput[2][i], m);
+               out[0] = stbi__compute_y(r, g, b);
+               out[1] = 255;
+               out += n;
+            }
+         } else if (z->s->img_n == 4 && z->app14_color_transform == 2) {
+            for (i=0; i < z->s->img_x; ++i) {
+               out[0] = stbi__blinn_8x8(255 - coutput[0][i], coutput[3][i]);
+               out[1] = 255;
+               out += n;
+            }
+         } else {
+            stbi_uc *y = coutput[0];
+            if (n == 1)
+               for (i=0; i < z->s->img_x; ++i) out[i] = y[i];
+            else
+               for (i=0; i < z->s->img_x; ++i) { *out++ = y[i]; *out++ = 255; }
+         }
+      }
+      if (spare)
+         memcpy(row, spare_row, n * z->s->img_x);
+      if (after)
+         *after = saved;
+   }
+}
+
+// move a resampler from row 0 to output row y, same steps as the convert loop
+static void stbi__jpeg_skip_rows(stbi__jpeg *z, stbi__resample *r, int k, int y)
+{
+   for (; y > 0; --y) {
+      if (++r->ystep >= r->vs) {
+         r->ystep = 0;
+         r->line0 = r->line1;
+         if (++r->ypos < z->img_comp[k].y)
+            r->line1 += z->img_comp[k].w2;
+      }
+   }
+}
+
+#define STBI__CONVERT_STRIP_ROWS 32
+
+typedef struct
+{
+   stbi__jpeg *z;
+   stbi__resample *res_comp;     // resampler state at row 0
+   const stbi__jpeg_output *output;
+   int caller_memory;            // no slack after the last row
+   int failed;
+} stbi__jpeg_convert_job;
+
+static void stbi__jpeg_convert_task(void *arg, int index)
+{
+   stbi__jpeg_convert_job *job = (stbi__jpeg_convert_job *) arg;
+   stbi__jpeg *z = job->z;
+   stbi__resample res_comp[4];
+   stbi_uc *linebuf[4] = { NULL, NULL, NULL, NULL };
+   int k, y0 = index * STBI__CONVERT_STRIP_ROWS;
+   int y1 = stbi__min(y0 + STBI__CONVERT_STRIP_ROWS, (int) z->s->img_y);
+   int line_size = z->s->img_x + 3;
+   int decode_n = job->output->decode_n;
+   // private line buffers plus a spare output row, one allocation
+   stbi_uc *scratch = (stbi_uc *) stbi__malloc_mad2(line_size, decode_n, job->output->n * z->s->img_x + 4);
+   if (!scratch) { job->failed = 1; return; }
+   for (k=0; k < decode_n; ++k) {
+      res_comp[k] = job->res_comp[k];
+      stbi__jpeg_skip_rows(z, &res_comp[k], k, y0);
+      linebuf[k] = scratch + line_size * k;
+   }
+   // our own malloc'd output has a byte of slack after the last row
+   stbi__jpeg_convert_rows(z, res_comp, linebuf, job->output, y0, y1,
+                           (job->caller_memory || y1 < (int) z->s->img_y) ? scratch + line_size * decode_n : NULL);
+   STBI_FREE(scratch);
+}
+
+// dest: decode into caller memory instead of a new buffer (returns dest->pixels)
+static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp, int req_comp, stbi__jpeg_output *dest)
 {
    int n, decode_n, is_rgb;
    z->s->img_n = 0; // make stbi__cleanup_jpeg safe
@@ -3836,11 +4700,14 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
    // resample and color-convert
    {
       int k;
-      unsigned int i,j;
       stbi_uc *output;
-      stbi_uc *coutput[4] = { NULL, NULL, NULL, NULL };
-
       stbi__resample res_comp[4];
+      stbi__jpeg_output o;
+
+      if (dest && (dest->width != (int) z->s->img_x || dest->height != (int) z->s->img_y || dest->n != n)) {
+         stbi__cleanup_jpeg(z);
+         return stbi__errpuc("size mismatch", "Image size differs from the destination");
+      }
 
       for (k=0; k < decode_n; ++k) {
          stbi__resample *r = &res_comp[k];
@@ -3864,104 +4731,44 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
          else                               r->resample = stbi__resample_row_generic;
       }
 
-      // can't error after this so, this is safe
-      output = (stbi_uc *) stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
-      if (!output) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
-
-      // now go ahead and resample
-      for (j=0; j < z->s->img_y; ++j) {
-         stbi_uc *out = output + n * z->s->img_x * j;
-         for (k=0; k < decode_n; ++k) {
-            stbi__resample *r = &res_comp[k];
-            int y_bot = r->ystep >= (r->vs >> 1);
-            coutput[k] = r->resample(z->img_comp[k].linebuf,
-                                     y_bot ? r->line1 : r->line0,
-                                     y_bot ? r->line0 : r->line1,
-                                     r->w_lores, r->hs);
-            if (++r->ystep >= r->vs) {
-               r->ystep = 0;
-               r->line0 = r->line1;
-               if (++r->ypos < z->img_comp[k].y)
-                  r->line1 += z->img_comp[k].w2;
-            }
-         }
-         if (n >= 3) {
-            stbi_uc *y = coutput[0];
-            if (z->s->img_n == 3) {
-               if (is_rgb) {
-                  for (i=0; i < z->s->img_x; ++i) {
-                     out[0] = y[i];
-                     out[1] = coutput[1][i];
-                     out[2] = coutput[2][i];
-                     out[3] = 255;
-                     out += n;
-                  }
-               } else {
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-               }
-            } else if (z->s->img_n == 4) {
-               if (z->app14_color_transform == 0) { // CMYK
-                  for (i=0; i < z->s->img_x; ++i) {
-                     stbi_uc m = coutput[3][i];
-                     out[0] = stbi__blinn_8x8(coutput[0][i], m);
-                     out[1] = stbi__blinn_8x8(coutput[1][i], m);
-                     out[2] = stbi__blinn_8x8(coutput[2][i], m);
-                     out[3] = 255;
-                     out += n;
-                  }
-               } else if (z->app14_color_transform == 2) { // YCCK
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-                  for (i=0; i < z->s->img_x; ++i) {
-                     stbi_uc m = coutput[3][i];
-                     out[0] = stbi__blinn_8x8(255 - out[0], m);
-                     out[1] = stbi__blinn_8x8(255 - out[1], m);
-                     out[2] = stbi__blinn_8x8(255 - out[2], m);
-                     out += n;
-                  }
-               } else { // YCbCr + alpha?  Ignore the fourth channel for now
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-               }
-            } else
-               for (i=0; i < z->s->img_x; ++i) {
-                  out[0] = out[1] = out[2] = y[i];
-                  out[3] = 255; // not used if n==3
-                  out += n;
-               }
-         } else {
-            if (is_rgb) {
-               if (n == 1)
-                  for (i=0; i < z->s->img_x; ++i)
-                     *out++ = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
-               else {
-                  for (i=0; i < z->s->img_x; ++i, out += 2) {
-                     out[0] = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
-                     out[1] = 255;
-                  }
-               }
-            } else if (z->s->img_n == 4 && z->app14_color_transform == 0) {
-               for (i=0; i < z->s->img_x; ++i) {
-                  stbi_uc m = coutput[3][i];
-                  stbi_uc r = stbi__blinn_8x8(coutput[0][i], m);
-                  stbi_uc g = stbi__blinn_8x8(coutput[1][i], m);
-                  stbi_uc b = stbi__blinn_8x8(coutput[2][i], m);
-                  out[0] = stbi__compute_y(r, g, b);
-                  out[1] = 255;
-                  out += n;
-               }
-            } else if (z->s->img_n == 4 && z->app14_color_transform == 2) {
-               for (i=0; i < z->s->img_x; ++i) {
-                  out[0] = stbi__blinn_8x8(255 - coutput[0][i], coutput[3][i]);
-                  out[1] = 255;
-                  out += n;
-               }
-            } else {
-               stbi_uc *y = coutput[0];
-               if (n == 1)
-                  for (i=0; i < z->s->img_x; ++i) out[i] = y[i];
-               else
-                  for (i=0; i < z->s->img_x; ++i) { *out++ = y[i]; *out++ = 255; }
-            }
+      if (dest) {
+         o = *dest;
+         output = dest->pixels;
+      } else {
+         // can't error after this so, this is safe
+         output = (stbi_uc *) stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
+         if (!output) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
+         o.pixels = output;
+         o.stride = (size_t) n * z->s->img_x;
+         o.flip = 0;
+      }
+      o.n = n;
+      o.decode_n = decode_n;
+      o.is_rgb = is_rgb;
+
+      // now go ahead and resample, in strips if there is a job system
+      if (stbi__parallel_for && z->s->img_y > STBI__CONVERT_STRIP_ROWS) {
+         stbi__jpeg_convert_job job;
+         job.z = z;
+         job.res_comp = res_comp;
+         job.output = &o;
+         job.caller_memory = dest != NULL;
+         job.failed = 0;
+         stbi__parallel_for(stbi__parallel_for_user, (z->s->img_y + STBI__CONVERT_STRIP_ROWS-1) / STBI__CONVERT_STRIP_ROWS,
+                            stbi__jpeg_convert_task, &job);
+         if (job.failed) { if (!dest) STBI_FREE(output); stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
+      } else {
+         stbi_uc *linebuf[4];
+         stbi_uc *spare_row = NULL;
+         // caller memory has no slack after the last row
+         if (dest) {
+            spare_row = (stbi_uc *) stbi__malloc_mad2(n, z->s->img_x, 4);
+            if (!spare_row) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
          }
+         for (k=0; k < decode_n; ++k)
+            linebuf[k] = z->img_comp[k].linebuf;
+         stbi__jpeg_convert_rows(z, res_comp, linebuf, &o, 0, z->s->img_y, spare_row);
+         if (spare_row) STBI_FREE(spare_row);
       }
       stbi__cleanup_jpeg(z);
       *out_x = z->s->img_x;
@@ -3979,11 +4786,32 @@ static void *stbi__jpeg_load(stbi__context *s, int *x, int *y, int *comp, int re
    STBI_NOTUSED(ri);
    j->s = s;
    stbi__setup_jpeg(j);
-   result = load_jpeg_image(j, x,y,comp,req_comp);
+   result = load_jpeg_image(j, x,y,comp,req_comp, NULL);
    STBI_FREE(j);
    return result;
 }
 
+// rows are written straight into dest by the colour converter, flipped or not
+static int stbi__jpeg_load_into(stbi__context *s, stbi_uc *dest, int dest_stride, int flip, int width, int height, int req_comp)
+{
+   stbi__jpeg_output o;
+   int x, y, comp;
+   stbi_uc *result;
+   stbi__jpeg* j = (stbi__jpeg*) stbi__malloc(sizeof(stbi__jpeg));
+   if (!j) return stbi__err("outofmem", "Out of memory");
+   j->s = s;
+   stbi__setup_jpeg(j);
+   o.pixels = dest;
+   o.stride = (size_t) dest_stride;
+   o.flip = flip;
+   o.width = width;
+   o.height = height;
+   o.n = req_comp;
+   result = load_jpeg_image(j, &x, &y, &comp, req_comp, &o);
+   STBI_FREE(j);
+   return result != NULL;
+}
+
 static int stbi__jpeg_test(stbi__context *s)
 {
    int r;
@@ -4031,7 +4859,7 @@ static int stbi__jpeg_info(stbi__context *s, int *x, int *y, int *comp)
 #ifndef STBI_NO_ZLIB
 
 // fast-way is faster to check than jpeg huffman, but slow way is slower
-#define STBI__ZFAST_BITS  9 // accelerate all cases in default tables
+#define STBI__ZFAST_BITS  11 // all codes of the default tables, nearly all of typical dynamic ones
 #define STBI__ZFAST_MASK  ((1 << STBI__ZFAST_BITS) - 1)
 #define STBI__ZNSYMS 288 // number of symbols in literal/length alphabet
 
@@ -4121,7 +4949,8 @@ typedef struct
 {
    stbi_uc *zbuffer, *zbuffer_end;
    int num_bits;
-   stbi__uint32 code_buffer;
+   int num_phantom;  // zero bytes the bit buffer was padded with past the end of input
+   stbi__uint64 code_buffer;
 
    char *zout;
    char *zout_start;
@@ -4129,6 +4958,9 @@ typedef struct
    int   z_expandable;
 
    stbi__zhuffman z_length, z_distance;
+   // z_length fast table resolved to literals: up to two literals whose codes
+   // fit in STBI__ZFAST_BITS together. lit1 | lit2 << 8 | bits << 16 | (count-1) << 24
+   stbi__uint32 literal_pairs[1 << STBI__ZFAST_BITS];
 } stbi__zbuf;
 
 stbi_inline static int stbi__zeof(stbi__zbuf *z)
@@ -4141,23 +4973,41 @@ stbi_inline static stbi_uc stbi__zget8(stbi__zbuf *z)
    return stbi__zeof(z) ? 0 : *z->zbuffer++;
 }
 
+// little-endian 64-bit load, compilers turn this into a single mov
+stbi_inline static stbi__uint64 stbi__zload64(const stbi_uc *p)
+{
+   return (stbi__uint64) (p[0] | (p[1] << 8) | (p[2] << 16) | ((stbi__uint32) p[3] << 24))
+        | (stbi__uint64) (p[4] | (p[5] << 8) | (p[6] << 16) | ((stbi__uint32) p[7] << 24)) << 32;
+}
+
+// tops the bit buffer up to at least 56 bits
 static void stbi__fill_bits(stbi__zbuf *z)
 {
+   if (z->code_buffer >= ((stbi__uint64) 1 << z->num_bits)) {
+      z->zbuffer = z->zbuffer_end;  /* treat this as EOF so we fail. */
+      return;
+   }
+   if (z->zbuffer_end - z->zbuffer >= 8) {
+      // one unaligned load instead of a byte at a time, keeping whole bytes
+      int n = (63 - z->num_bits) >> 3;
+      z->code_buffer |= stbi__zload64(z->zbuffer) << z->num_bits;
+      z->zbuffer += n;
+      z->num_bits += n * 8;
+      z->code_buffer &= ((stbi__uint64) 1 << z->num_bits) - 1;
+      return;
+   }
    do {
-      if (z->code_buffer >= (1U << z->num_bits)) {
-        z->zbuffer = z->zbuffer_end;  /* treat this as EOF so we fail. */
-        return;
-      }
-      z->code_buffer |= (unsigned int) stbi__zget8(z) << z->num_bits;
+      if (stbi__zeof(z)) ++z->num_phantom;
+      z->code_buffer |= (stbi__uint64) stbi__zget8(z) << z->num_bits;
       z->num_bits += 8;
-   } while (z->num_bits <= 24);
+   } while (z->num_bits <= 56);
 }
 
 stbi_inline static unsigned int stbi__zreceive(stbi__zbuf *z, int n)
 {
    unsigned int k;
    if (z->num_bits < n) stbi__fill_bits(z);
-   k = z->code_buffer & ((1 << n) - 1);
+   k = (unsigned int) (z->code_buffer & ((1 << n) - 1));
    z->code_buffer >>= n;
    z->num_bits -= n;
    return k;
@@ -4168,7 +5018,7 @@ static int stbi__zhuffman_decode_slowpath(stbi__zbuf *a, stbi__zhuffman *z)
    int b,s,k;
    // not resolved by fast table, so compute it the slow way
    // use jpeg approach, which requires MSbits at top
-   k = stbi__bit_reverse(a->code_buffer, 16);
+   k = stbi__bit_reverse((int) (a->code_buffer & 0xffff), 16);
    for (s=STBI__ZFAST_BITS+1; ; ++s)
       if (k < z->maxcode[s])
          break;
@@ -4237,11 +5087,90 @@ static const int stbi__zdist_base[32] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129
 static const int stbi__zdist_extra[32] =
 { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
 
+// called whenever z_length changes, see literal_pairs
+static void stbi__zbuild_literal_pairs(stbi__zbuf *a)
+{
+   int i;
+   const stbi__uint16 *fast = a->z_length.fast;
+   for (i=0; i < (1 << STBI__ZFAST_BITS); ++i) {
+      int b1 = fast[i];
+      stbi__uint32 e = 0;
+      if (b1 && (b1 & 511) < 256) {
+         int s1 = b1 >> 9;
+         // the bits after the first code only fill the low part of the index,
+         // so the second lookup is only valid for codes that short
+         int b2 = fast[i >> s1];
+         int s2 = b2 >> 9;
+         if (b2 && (b2 & 511) < 256 && s1 + s2 <= STBI__ZFAST_BITS)
+            e = (b1 & 255) | ((b2 & 255) << 8) | ((stbi__uint32) (s1 + s2) << 16) | (1u << 24);
+         else
+            e = (b1 & 255) | ((stbi__uint32) s1 << 16);
+      }
+      a->literal_pairs[i] = e;
+   }
+}
+
 static int stbi__parse_huffman_block(stbi__zbuf *a)
 {
    char *zout = a->zout;
    for(;;) {
-      int z = stbi__zhuffman_decode(a, &a->z_length);
+      int z;
+      // fast path: one length/distance pair takes at most 15+5+15+13 = 48 bits,
+      // so with 8 bytes of input left one refill covers a whole symbol, and with
+      // room for the longest match plus a word no output checks are needed either
+      if (a->zbuffer_end - a->zbuffer >= 8 && a->zout_end - zout >= 258 + 8) {
+         stbi__uint32 e;
+         stbi_uc *p;
+         int len,dist;
+         if (a->num_bits < 48) stbi__fill_bits(a);
+         e = a->literal_pairs[a->code_buffer & STBI__ZFAST_MASK];
+         if (e) {
+            int bits = (e >> 16) & 255;
+            a->code_buffer >>= bits;
+            a->num_bits -= bits;
+            *zout++ = (char) (e & 255);
+            if (e >> 24) *zout++ = (char) ((e >> 8) & 255);
+            continue;
+         }
+         z = stbi__zhuffman_decode(a, &a->z_length);
+         if (z < 256) {
+            if (z < 0) return stbi__err("bad huffman code","Corrupt PNG");
+            *zout++ = (char) z;
+            continue;
+         }
+         if (z == 256) {
+            a->zout = zout;
+            return 1;
+         }
+         z -= 257;
+         if (z >= 29) return stbi__err("bad huffman code","Corrupt PNG");
+         len = stbi__zlength_base[z];
+         if (stbi__zlength_extra[z]) len += stbi__zreceive(a, stbi__zlength_extra[z]);
+         z = stbi__zhuffman_decode(a, &a->z_distance);
+         if (z < 0 || z >= 30) return stbi__err("bad huffman code","Corrupt PNG");
+         dist = stbi__zdist_base[z];
+         if (stbi__zdist_extra[z]) dist += stbi__zreceive(a, stbi__zdist_extra[z]);
+         if (zout - a->zout_start < dist) return stbi__err("bad dist","Corrupt PNG");
+         p = (stbi_uc *) (zout - dist);
+         if (dist >= 8) {
+            // 8 bytes at a time, may write up to 7 bytes past the match
+            char *end = zout + len;
+            do {
+               memcpy(zout, p, 8);
+               zout += 8;
+               p += 8;
+            } while (zout < end);
+            zout = end;
+         } else if (dist == 1) {
+            memset(zout, *p, len);
+            zout += len;
+         } else {
+            do *zout++ = *p++; while (--len);
+         }
+         continue;
+      }
+
+      z = stbi__zhuffman_decode(a, &a->z_length);
       if (z < 256) {
          if (z < 0) return stbi__err("bad huffman code","Corrupt PNG"); // error in huffman codes
          if (zout >= a->zout_end) {
@@ -4335,17 +5264,16 @@ static int stbi__parse_uncompressed_block(stbi__zbuf *a)
    int len,nlen,k;
    if (a->num_bits & 7)
       stbi__zreceive(a, a->num_bits & 7); // discard
-   // drain the bit-packed data into header
-   k = 0;
-   while (a->num_bits > 0) {
-      header[k++] = (stbi_uc) (a->code_buffer & 255); // suppress MSVC run-time check
-      a->code_buffer >>= 8;
-      a->num_bits -= 8;
-   }
    if (a->num_bits < 0) return stbi__err("zlib corrupt","Corrupt PNG");
-   // now fill header the normal way
-   while (k < 4)
-      header[k++] = stbi__zget8(a);
+   // whole bytes left in the bit buffer were read ahead of the stored block,
+   // hand them back to the input (minus the zeros padded past its end)
+   k = (a->num_bits >> 3) - a->num_phantom;
+   if (k > 0) a->zbuffer -= k;
+   a->code_buffer = 0;
+   a->num_bits = 0;
+   a->num_phantom = 0;
+   for (k=0; k < 4; ++k)
+      header[k] = stbi__zget8(a);
    len  = header[1] * 256 + header[0];
    nlen = header[3] * 256 + header[2];
    if (nlen != (len ^ 0xffff)) return stbi__err("zlib corrupt","Corrupt PNG");
@@ -4407,6 +5335,7 @@ static int stbi__parse_zlib(stbi__zbuf *a, int parse_header)
    if (parse_header)
       if (!stbi__parse_zlib_header(a)) return 0;
    a->num_bits = 0;
+   a->num_phantom = 0;
    a->code_buffer = 0;
    do {
       final = stbi__zreceive(a,1);
@@ -4423,6 +5352,7 @@ static int stbi__parse_zlib(stbi__zbuf *a, int parse_header)
          } else {
             if (!stbi__compute_huffman_codes(a)) return 0;
          }
+         stbi__zbuild_literal_pairs(a);
          if (!stbi__parse_huffman_block(a)) return 0;
       }
    } while (!final);
@@ -4590,6 +5520,178 @@ static int stbi__paeth(int a, int b, int c)
 
 static const stbi_uc stbi__depth_scale_table[9] = { 0, 0xff, 0x55, 0, 0x11, 0,0,0, 0x01 };
 
+#ifdef STBI_SSE2
+// SIMD unfiltering for 8-bit rows with 3 or 4 bytes per pixel, starting at the
+// second pixel like the scalar loops. Sub, Avg and Paeth depend on the pixel to
+// the left, so those go one pixel per step; Up has no such chain.
+// bpp is always a constant 3 or 4 after inlining, so these become plain moves
+stbi_inline static __m128i stbi__png_load_px(const stbi_uc *p, int bpp)
+{
+   int v;
+   if (bpp == 4)
+      memcpy(&v, p, 4);
+   else
+      v = p[0] | (p[1] << 8) | (p[2] << 16);
+   return _mm_cvtsi32_si128(v);
+}
+
+stbi_inline static void stbi__png_store_px(stbi_uc *p, __m128i x, int bpp)
+{
+   int v = _mm_cvtsi128_si32(x);
+   if (bpp == 4) {
+      memcpy(p, &v, 4);
+   } else {
+      p[0] = (stbi_uc) v;
+      p[1] = (stbi_uc) (v >> 8);
+      p[2] = (stbi_uc) (v >> 16);
+   }
+}
+
+static void stbi__unfilter_up_sse2(stbi_uc *cur, const stbi_uc *raw, const stbi_uc *prior, int n)
+{
+   int k = 0;
+   for (; k+16 <= n; k += 16) {
+      __m128i r = _mm_loadu_si128((const __m128i *) (raw + k));
+      __m128i b = _mm_loadu_si128((const __m128i *) (prior + k));
+      _mm_storeu_si128((__m128i *) (cur + k), _mm_add_epi8(r, b));
+   }
+   for (; k < n; ++k)
+      cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
+}
+
+stbi_inline static void stbi__unfilter_sub_sse2(stbi_uc *cur, const stbi_uc *raw, int n, int bpp)
+{
+   __m128i a = stbi__png_load_px(cur - bpp, bpp);
+   int k = 0;
+   if (bpp == 4) {
+      // four pixels at once: prefix sum inside the register, then add the carry
+      a = _mm_shuffle_epi32(a, 0);
+      for (; k+16 <= n; k += 16) {
+         __m128i x = _mm_loadu_si128((const __m128i *) (raw + k));
+         x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+         x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+         x = _mm_add_epi8(x, a);
+         _mm_storeu_si128((__m128i *) (cur + k), x);
+         a = _mm_shuffle_epi32(x, 0xff);
+      }
+   }
+   for (; k < n; k += bpp) {
+      a = _mm_add_epi8(stbi__png_load_px(raw + k, bpp), a);
+      stbi__png_store_px(cur + k, a, bpp);
+   }
+}
+
+stbi_inline static void stbi__unfilter_avg_sse2(stbi_uc *cur, const stbi_uc *raw, const stbi_uc *prior, int n, int bpp)
+{
+   const __m128i one = _mm_set1_epi8(1);
+   __m128i a = stbi__png_load_px(cur - bpp, bpp);
+   int k;
+   for (k=0; k < n; k += bpp) {
+      __m128i b = stbi__png_load_px(prior + k, bpp);
+      // floor((a+b)/2): avg_epu8 rounds up, take the odd bit back off
+      __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+      a = _mm_add_epi8(stbi__png_load_px(raw + k, bpp), avg);
+      stbi__png_store_px(cur + k, a, bpp);
+   }
+}
+
+stbi_inline static void stbi__unfilter_paeth_sse2(stbi_uc *cur, const stbi_uc *raw, const stbi_uc *prior, int n, int bpp)
+{
+   const __m128i zero = _mm_setzero_si128();
+   // left (a) and upper left (c) widened to 16 bits
+   __m128i a = _mm_unpacklo_epi8(stbi__png_load_px(cur - bpp, bpp), zero);
+   __m128i c = _mm_unpacklo_epi8(stbi__png_load_px(prior - bpp, bpp), zero);
+   int k;
+   for (k=0; k < n; k += bpp) {
+      __m128i b = _mm_unpacklo_epi8(stbi__png_load_px(prior + k, bpp), zero);
+      __m128i bc = _mm_sub_epi16(b, c);
+      __m128i ac = _mm_sub_epi16(a, c);
+      __m128i abc = _mm_add_epi16(ac, bc);
+      // same distances as stbi__paeth: pa = |b-c|, pb = |a-c|, pc = |a+b-2c|
+      __m128i pa = _mm_max_epi16(bc, _mm_sub_epi16(zero, bc));
+      __m128i pb = _mm_max_epi16(ac, _mm_sub_epi16(zero, ac));
+      __m128i pc = _mm_max_epi16(abc, _mm_sub_epi16(zero, abc));
+      __m128i use_a = _mm_andnot_si128(_mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc)), _mm_set1_epi16(-1));
+      __m128i use_b = _mm_andnot_si128(_mm_cmpgt_epi16(pb, pc), _mm_set1_epi16(-1));
+      __m128i pred = _mm_or_si128(_mm_and_si128(use_b, b), _mm_andnot_si128(use_b, c));
+      pred = _mm_or_si128(_mm_and_si128(use_a, a), _mm_andnot_si128(use_a, pred));
+      pred = _mm_add_epi8(_mm_packus_epi16(pred, zero), stbi__png_load_px(raw + k, bpp));
+      stbi__png_store_px(cur + k, pred, bpp);
+      a = _mm_unpacklo_epi8(pred, zero);
+      c = b;
+   }
+}
+#endif
+
+#ifdef STBI_AVX2
+STBI__AVX2_TARGET static void stbi__unfilter_up_avx2(stbi_uc *cur, const stbi_uc *raw, const stbi_uc *prior, int n)
+{
+   int k = 0;
+   for (; k+32 <= n; k += 32) {
+      __m256i r = _mm256_loadu_si256((const __m256i *) (raw + k));
+      __m256i b = _mm256_loadu_si256((const __m256i *) (prior + k));
+      _mm256_storeu_si256((__m256i *) (cur + k), _mm256_add_epi8(r, b));
+   }
+   for (; k < n; ++k)
+      cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
+}
+
+STBI__AVX2_TARGET static void stbi__unfilter_sub4_avx2(stbi_uc *cur, const stbi_uc *raw, int n)
+{
+   int k = 0;
+   int left;
+   __m256i a;
+   memcpy(&left, cur - 4, 4);
+   a = _mm256_set1_epi32(left);
+   for (; k+32 <= n; k += 32) {
+      __m256i x = _mm256_loadu_si256((const __m256i *) (raw + k));
+      // prefix sum within each 128-bit lane, then carry the low lane into the high one
+      x = _mm256_add_epi8(x, _mm256_slli_si256(x, 4));
+      x = _mm256_add_epi8(x, _mm256_slli_si256(x, 8));
+      x = _mm256_add_epi8(x, _mm256_permute2x128_si256(_mm256_shuffle_epi32(x, 0xff), _mm256_shuffle_epi32(x, 0xff), 0x08));
+      x = _mm256_add_epi8(x, a);
+      _mm256_storeu_si256((__m256i *) (cur + k), x);
+      a = _mm256_permutevar8x32_epi32(x, _mm256_set1_epi32(7));
+   }
+   for (; k < n; ++k)
+      cur[k] = STBI__BYTECAST(raw[k] + cur[k-4]);
+}
+#endif
+
+#if defined(STBI_SSE2)
+// returns 0 if the row has to go through the scalar loops
+static int stbi__unfilter_row_simd(int level, int filter, stbi_uc *cur, const stbi_uc *raw, const stbi_uc *prior, int n, int bpp)
+{
+   if (level < STBI_SIMD_SSE2 || (bpp != 3 && bpp != 4))
+      return 0;
+   switch (filter) {
+      case STBI__F_up:
+#ifdef STBI_AVX2
+         if (level >= STBI_SIMD_AVX2) { stbi__unfilter_up_avx2(cur, raw, prior, n); return 1; }
+#endif
+         stbi__unfilter_up_sse2(cur, raw, prior, n);
+         return 1;
+      case STBI__F_sub:
+#ifdef STBI_AVX2
+         if (level >= STBI_SIMD_AVX2 && bpp == 4) { stbi__unfilter_sub4_avx2(cur, raw, n); return 1; }
+#endif
+         if (bpp == 4) stbi__unfilter_sub_sse2(cur, raw, n, 4);
+         else          stbi__unfilter_sub_sse2(cur, raw, n, 3);
+         return 1;
+      // literal bpp so each gets its own inlined copy
+      case STBI__F_avg:
+         if (bpp == 4) stbi__unfilter_avg_sse2(cur, raw, prior, n, 4);
+         else          stbi__unfilter_avg_sse2(cur, raw, prior, n, 3);
+         return 1;
+      case STBI__F_paeth:
+         if (bpp == 4) stbi__unfilter_paeth_sse2(cur, raw, prior, n, 4);
+         else          stbi__unfilter_paeth_sse2(cur, raw, prior, n, 3);
+         return 1;
+   }
+   return 0;
+}
+#endif
+
 // create the png data from post-deflated data
 static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 raw_len, int out_n, stbi__uint32 x, stbi__uint32 y, int depth, int color)
 {
@@ -4603,6 +5705,9 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
    int output_bytes = out_n*bytes;
    int filter_bytes = img_n*bytes;
    int width = x;
+#ifdef STBI_SSE2
+   int simd_level = stbi_get_simd_level();
+#endif
 
    STBI_ASSERT(out_n == s->img_n || out_n == s->img_n+1);
    a->out = (stbi_uc *) stbi__malloc_mad3(x, y, output_bytes, 0); // extra bytes to write off the end into
@@ -4675,6 +5780,10 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
          #define STBI__CASE(f) \
              case f:     \
                 for (k=0; k < nk; ++k)
+#ifdef STBI_SSE2
+         if (depth == 8 && stbi__unfilter_row_simd(simd_level, filter, cur, raw, prior, nk, filter_bytes))
+            filter = -1;   // done, skip the switch
+#endif
          switch (filter) {
             // "none" filter turns into a memcpy here; make that explicit.
             case STBI__F_none:         memcpy(cur, raw, nk); break;
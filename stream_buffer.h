@@ -0,0 +1,158 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <glad/glad.h>
+
+#include "gl_ext.h"
+
+#include <vector>
+#include <cstring>
+#include <iostream>
+
+// Ring buffer for data that changes every frame (per-draw transforms etc.).
+// The buffer is split into one region per frame in flight; each frame
+// bump-allocates from its region and a fence keeps the CPU from overwriting a
+// region the GPU may still be reading, so no implicit driver sync happens.
+//
+// With ARB_buffer_storage the whole buffer stays persistently mapped and
+// allocations are written straight into it. Without it allocations go into a
+// CPU copy and flush() uploads the written range with an unsynchronized map;
+// call flush() once after writing and before drawing with the data.
+class StreamBuffer
+{
+public:
+    struct Allocation
+    {
+        void* ptr;              // write the data here
+        GLintptr offset;        // offset inside the GL buffer (for glBindBufferRange)
+        GLsizeiptr size;
+    };
+
+    GLuint ID = 0;
+
+    StreamBuffer(GLenum target, GLsizeiptr frameSize, unsigned int framesInFlight = 3)
+        : target(target), frameSize(frameSize), frames(framesInFlight), fences(framesInFlight, (GLsync)0)
+    {
+        const GLsizeiptr total = frameSize * frames;
+        glGenBuffers(1, &ID);
+        glBindBuffer(target, ID);
+        persistent = glExt().bufferStorage;
+        if (persistent)
+        {
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glExt().BufferStorage(target, total, NULL, flags);
+            mapped = (unsigned char*)glMapBufferRange(target, 0, total, flags);
+            if (!mapped)
+            {
+                std::cout << "ERROR::STREAM_BUFFER::PERSISTENT_MAP_FAILED" << std::endl;
+                persistent = false;
+                // immutable storage can't be respecified, start over with a mutable buffer
+                glDeleteBuffers(1, &ID);
+                glGenBuffers(1, &ID);
+                glBindBuffer(target, ID);
+            }
+        }
+        if (!persistent)
+        {
+            glBufferData(target, total, NULL, GL_STREAM_DRAW);
+            shadow.resize(frameSize);
+        }
+    }
+
+    ~StreamBuffer()
+    {
+        destroy();
+    }
+
+    // Frees the GL objects, call it while the context is still alive
+    void destroy()
+    {
+        if (!ID)
+            return;
+        for (GLsync& fence : fences)
+            if (fence)
+            {
+                glDeleteSync(fence);
+                fence = 0;
+            }
+        if (persistent)
+        {
+            glBindBuffer(target, ID);
+            glUnmapBuffer(target);
+        }
+        glDeleteBuffers(1, &ID);
+        ID = 0;
+    }
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    // Move to the next frame's region, waiting for the GPU only if it is
+    // still behind by framesInFlight frames
+    void beginFrame()
+    {
+        frame = (frame + 1) % frames;
+        if (fences[frame])
+        {
+            GLenum result = glClientWaitSync(fences[frame], 0, 0);
+            while (result == GL_TIMEOUT_EXPIRED)
+                result = glClientWaitSync(fences[frame], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);   // 1ms
+            glDeleteSync(fences[frame]);
+            fences[frame] = 0;
+        }
+        head = 0;
+        flushed = 0;
+    }
+
+    // Bump-allocates size bytes aligned to alignment (e.g. GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT).
+    // Returns ptr == NULL when the frame's region is exhausted.
+    Allocation allocate(GLsizeiptr size, GLsizeiptr alignment)
+    {
+        GLsizeiptr start = (head + alignment - 1) / alignment * alignment;
+        if (start + size > frameSize)
+            return { NULL, 0, 0 };
+        head = start + size;
+        unsigned char* base = persistent ? mapped + frame * frameSize : shadow.data();
+        return { base + start, (GLintptr)(frame * frameSize + start), size };
+    }
+
+    // Makes everything allocated since the last flush visible to the GPU
+    // (a no-op for the coherent persistent mapping)
+    void flush()
+    {
+        if (persistent || head == flushed)
+            return;
+        glBindBuffer(target, ID);
+        void* dst = glMapBufferRange(target, frame * frameSize + flushed, head - flushed,
+                                     GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+        if (dst)
+        {
+            memcpy(dst, shadow.data() + flushed, head - flushed);
+            glUnmapBuffer(target);
+        }
+        flushed = head;
+    }
+
+    // Fence this frame's region after its last draw was submitted
+    void endFrame()
+    {
+        flush();
+        fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    bool isPersistent() const { return persistent; }
+
+private:
+    GLenum target;
+    GLsizeiptr frameSize;
+    unsigned int frames;
+    unsigned int frame = 0;
+    GLsizeiptr head = 0;        // bump pointer inside the current region
+    GLsizeiptr flushed = 0;     // fallback path: bytes already uploaded
+    bool persistent = false;
+    unsigned char* mapped = NULL;
+    std::vector<unsigned char> shadow;
+    std::vector<GLsync> fences;
+};
+
+#endif
@@ -0,0 +1,432 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <glad/glad.h>
+
+#include "gl_ext.h"
+#include "job_pool.h"
+#include "image_kernels.h"
+#include "mipmap.h"
+#include "pak.h"
+#include "baked_texture.h"
+#include "async_io.h"
+#ifndef STBI_INCLUDE_STB_IMAGE_H
+#include "stb_image.h"
+#endif
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+
+// Loads a set of textures in three steps, so GPU memory is known and
+// allocated before any pixel is decoded:
+//
+//      TextureLoader textures;
+//      int box = textures.add("assets/container.jpeg");
+//      textures.probe();       // header only, fills in sizes and vramBytes()
+//      textures.allocate();    // immutable storage (ARB_texture_storage) for every texture
+//      textures.load();        // read files (AsyncIO), decode on the job pool into a mapped PBO, upload from it
+//      glBindTexture(GL_TEXTURE_2D, textures.id(box));
+//
+// Call destroy() while the GL context is still alive.
+
+struct TextureParams
+{
+    GLenum wrap = GL_REPEAT;
+    GLenum minFilter = GL_LINEAR_MIPMAP_LINEAR;
+    GLenum magFilter = GL_LINEAR;
+    bool mipmaps = true;
+    bool cpuMipmaps = true;     // build the chain with generateMipChain() instead of glGenerateMipmap
+    MipOptions mipOptions;      // wrap is taken from 'wrap' above
+};
+
+// What the file header says, known before decoding
+struct TextureInfo
+{
+    std::string path;
+    TextureParams params;
+    int width = 0, height = 0;
+    int channels = 0;           // as stored in the file
+    int uploadChannels = 0;     // what gets uploaded, RGB goes up as RGBA
+    int levels = 1;
+    GLenum internalFormat = GL_RGBA8;
+    GLenum format = GL_RGBA;
+    size_t vramBytes = 0;       // all mip levels
+    bool valid = false;
+};
+
+class TextureLoader
+{
+public:
+    int add(const std::string& path, const TextureParams& params = TextureParams())
+    {
+        TextureInfo info;
+        info.path = path;
+        info.params = params;
+        textures.push_back(info);
+        ids.push_back(0);
+        return (int)textures.size() - 1;
+    }
+
+    // Parses only the image headers. Returns the GPU memory all valid textures will need.
+    size_t probe()
+    {
+        totalBytes = 0;
+        for (TextureInfo& info : textures)
+            if (probeInfo(info))
+                totalBytes += info.vramBytes;
+        return totalBytes;
+    }
+
+    // Creates the GL textures with their full mip chains, contents undefined until load()
+    void allocate()
+    {
+        for (size_t i = 0; i < textures.size(); i++)
+            if (textures[i].valid && !ids[i])
+                ids[i] = createTexture(textures[i]);
+    }
+
+    // Decodes every allocated texture on the job pool straight into one mapped
+    // pixel unpack buffer (no intermediate copy, stb flips while writing), then
+    // uploads from it on this (the GL) thread.
+    // RGB images are decoded to a scratch buffer and expanded to RGBA with the
+    // SIMD kernel on the way in, instead of leaving the driver to do it.
+    // With cpuMipmaps the whole chain is built on the job pool and every level
+    // goes into the buffer too, otherwise glGenerateMipmap builds it.
+    // Returns false if any texture failed.
+    bool load()
+    {
+        std::vector<const TextureInfo*> items(textures.size(), NULL);
+        for (size_t i = 0; i < textures.size(); i++)
+            if (ids[i])
+                items[i] = &textures[i];
+        return decodeAndUpload(items, [this](size_t i, size_t offset)
+        {
+            uploadTexture(textures[i], ids[i], offset);
+        });
+    }
+
+    void destroy()
+    {
+        for (GLuint& id : ids)
+            if (id)
+            {
+                glDeleteTextures(1, &id);
+                id = 0;
+            }
+    }
+
+    GLuint id(int handle) const { return ids[handle]; }
+    const TextureInfo& info(int handle) const { return textures[handle]; }
+    size_t count() const { return textures.size(); }
+    size_t vramBytes() const { return totalBytes; }
+
+    static int mipLevels(int width, int height)
+    {
+        int levels = 1;
+        for (int size = width > height ? width : height; size > 1; size >>= 1)
+            levels++;
+        return levels;
+    }
+
+    static int levelSize(int size, int level)
+    {
+        size >>= level;
+        return size > 0 ? size : 1;
+    }
+
+    // The steps below are shared with the cache, registry and streamer
+
+    // Fills in everything but path and params from the file header ('file' if
+    // the caller already read it)
+    static bool probeInfo(TextureInfo& info, const PakSpan* file = NULL)
+    {
+        info.valid = imageInfo(info.path, info.width, info.height, info.channels, file);
+        if (!info.valid)
+        {
+            std::cout << "ERROR::TEXTURE::PROBE_FAILED " << info.path << ": " << stbi_failure_reason() << std::endl;
+            return false;
+        }
+        info.uploadChannels = info.channels == 3 ? 4 : info.channels;
+        formatFor(info.uploadChannels, info.internalFormat, info.format);
+        info.levels = info.params.mipmaps ? mipLevels(info.width, info.height) : 1;
+        info.vramBytes = 0;
+        for (int level = 0; level < info.levels; level++)
+            info.vramBytes += (size_t)levelSize(info.width, level) * levelSize(info.height, level) * info.uploadChannels;
+        return true;
+    }
+
+    // Texture with storage for all its levels, contents undefined
+    static GLuint createTexture(const TextureInfo& info)
+    {
+        GLuint id;
+        glGenTextures(1, &id);
+        glBindTexture(GL_TEXTURE_2D, id);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, info.params.wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, info.params.wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, info.params.minFilter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, info.params.magFilter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, info.levels - 1);
+        setSwizzle(GL_TEXTURE_2D, info.uploadChannels);
+        if (glExt().textureStorage)
+            glExt().TexStorage2D(GL_TEXTURE_2D, info.levels, info.internalFormat, info.width, info.height);
+        else
+            for (int level = 0; level < info.levels; level++)
+                glTexImage2D(GL_TEXTURE_2D, level, info.internalFormat, levelSize(info.width, level), levelSize(info.height, level),
+                             0, info.format, GL_UNSIGNED_BYTE, NULL);
+        return id;
+    }
+
+    // 1 and 2 channel images are grey and grey + alpha, which GL_R8 and GL_RG8
+    // would sample as red and red + green
+    static void setSwizzle(GLenum target, int channels)
+    {
+        static const GLint grey[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+        static const GLint greyAlpha[4] = { GL_RED, GL_RED, GL_RED, GL_GREEN };
+        if (channels == 1 || channels == 2)
+            glTexParameteriv(target, GL_TEXTURE_SWIZZLE_RGBA, channels == 1 ? grey : greyAlpha);
+    }
+
+    // Uploads what decodeInto() left at 'offset' of the bound unpack buffer
+    static void uploadTexture(const TextureInfo& info, GLuint id, size_t offset)
+    {
+        glBindTexture(GL_TEXTURE_2D, id);
+        for (int level = 0; level < uploadLevels(info); level++)
+            glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, levelSize(info.width, level), levelSize(info.height, level),
+                            info.format, GL_UNSIGNED_BYTE, (const void*)(offset + levelOffset(info, level)));
+        if (uploadLevels(info) < info.levels)
+            glGenerateMipmap(GL_TEXTURE_2D);
+    }
+
+    // Decodes the non-NULL items on the job pool straight into one mapped
+    // pixel unpack buffer, then calls upload(index, offset of its first level)
+    // on this thread for each one that decoded, with that buffer bound.
+    // 'read' has the files the caller already read (readLooseFiles), per item.
+    // Returns false if any failed.
+    template <typename Upload>
+    static bool decodeAndUpload(const std::vector<const TextureInfo*>& items, Upload upload,
+                                const std::vector<std::vector<uint8_t>>* read = NULL)
+    {
+        std::vector<size_t> offsets(items.size(), 0);
+        size_t total = 0;
+        for (size_t i = 0; i < items.size(); i++)
+            if (items[i])
+            {
+                offsets[i] = total;
+                total += levelOffset(*items[i], uploadLevels(*items[i]));
+            }
+        if (!total)
+            return true;
+
+        GLuint pbo;
+        glGenBuffers(1, &pbo);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, total, NULL, GL_STREAM_DRAW);
+        unsigned char* mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, total, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        std::vector<char> decoded(items.size(), 0);
+        if (mapped)
+        {
+            std::vector<std::vector<uint8_t>> ownFiles;
+            if (!read)
+            {
+                std::vector<std::string> paths(items.size());
+                for (size_t i = 0; i < items.size(); i++)
+                    if (items[i])
+                        paths[i] = items[i]->path;
+                readLooseFiles(paths, ownFiles);
+            }
+            const std::vector<std::vector<uint8_t>>& files = read ? *read : ownFiles;
+            JobPool::shared().parallelFor((int)items.size(), [&](int i)
+            {
+                PakSpan file = { files[i].data(), files[i].size() };
+                if (items[i])
+                    decoded[i] = (char)decodeInto(*items[i], mapped + offsets[i], files[i].empty() ? NULL : &file);
+            });
+            // the mapping can be lost (e.g. display mode change), then nothing arrived
+            if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_FALSE)
+                decoded.assign(items.size(), 0);
+        }
+        else
+            std::cout << "ERROR::TEXTURE::UPLOAD_BUFFER_MAP_FAILED" << std::endl;
+
+        bool ok = true;
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);      // rowStride() pads to 4
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            if (!items[i])
+                continue;
+            if (!decoded[i])
+            {
+                std::cout << "ERROR::TEXTURE::LOAD_FAILED " << items[i]->path << std::endl;
+                ok = false;
+                continue;
+            }
+            upload(i, offsets[i]);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &pbo);   // GL keeps it alive until the uploads are done
+        return ok;
+    }
+
+    // bytes per row of a level in the upload buffer, padded to the default unpack alignment
+    static int rowStride(const TextureInfo& info, int level = 0)
+    {
+        return (levelSize(info.width, level) * info.uploadChannels + 3) & ~3;
+    }
+
+    // levels that go through the upload buffer, the rest come from glGenerateMipmap
+    static int uploadLevels(const TextureInfo& info)
+    {
+        return info.params.cpuMipmaps ? info.levels : 1;
+    }
+
+    // where a level starts within the texture's part of the upload buffer
+    static size_t levelOffset(const TextureInfo& info, int level)
+    {
+        size_t offset = 0;
+        for (int l = 0; l < level; l++)
+            offset += (size_t)rowStride(info, l) * levelSize(info.height, l);
+        return offset;
+    }
+
+    // stb on an image file: 'file' when the caller already has it in memory,
+    // else read in place from a mounted pak (pak.h) when it has the path,
+    // otherwise streamed from disk
+    static bool imageInfo(const std::string& path, int& width, int& height, int& channels, const PakSpan* file = NULL)
+    {
+        if (file)
+            return stbi_info_from_memory(file->data, (int)file->size, &width, &height, &channels) != 0;
+        PakSpan span;
+        std::vector<uint8_t> storage;
+        if (findAsset(path, span, storage))
+            return stbi_info_from_memory(span.data, (int)span.size, &width, &height, &channels) != 0;
+        return stbi_info(path.c_str(), &width, &height, &channels) != 0;
+    }
+
+    static bool imageLoadInto(const std::string& path, unsigned char* dest, int stride, int width, int height, int channels,
+                              const PakSpan* file = NULL)
+    {
+        if (file)
+            return stbi_load_from_memory_into(file->data, (int)file->size, dest, stride, width, height, channels) != 0;
+        PakSpan span;
+        std::vector<uint8_t> storage;
+        if (findAsset(path, span, storage))
+            return stbi_load_from_memory_into(span.data, (int)span.size, dest, stride, width, height, channels) != 0;
+        return stbi_load_into(path.c_str(), dest, stride, width, height, channels) != 0;
+    }
+
+    // Reads every path that isn't in a mounted pak in one AsyncIO batch, so
+    // decode jobs don't each block on the disk. files[i] stays empty for
+    // empty paths, packed ones and failed reads (decoding reports those).
+    static void readLooseFiles(const std::vector<std::string>& paths, std::vector<std::vector<uint8_t>>& files,
+                               IOPriority priority = IO_PRIORITY_NORMAL)
+    {
+        files.assign(paths.size(), std::vector<uint8_t>());
+        AsyncIO& io = AsyncIO::shared();
+        // waits for this batch only, not for the streamer's reads as well
+        std::shared_ptr<std::atomic<int>> remaining = std::make_shared<std::atomic<int>>(0);
+        for (size_t i = 0; i < paths.size(); i++)
+            if (!paths[i].empty() && !isPackedAsset(paths[i]))
+            {
+                remaining->fetch_add(1);
+                io.read(paths[i], [&files, i, remaining](bool ok, std::vector<uint8_t>& bytes)
+                {
+                    if (ok)
+                        files[i].swap(bytes);
+                    remaining->fetch_sub(1);
+                }, priority);
+            }
+        io.wait(*remaining);
+    }
+
+    // how generateMipChain() builds this texture's levels
+    static MipOptions mipOptions(const TextureInfo& info)
+    {
+        MipOptions options = info.params.mipOptions;
+        options.wrap = info.params.wrap == GL_REPEAT || info.params.wrap == GL_MIRRORED_REPEAT;
+        return options;
+    }
+
+    // Decodes into the texture's part of the mapped upload buffer, plus the
+    // smaller levels when they are built here
+    static bool decodeInto(const TextureInfo& info, unsigned char* dest, const PakSpan* file = NULL)
+    {
+        // a chain baked by asset_build (baked_texture.h) replaces decoding and filtering
+        PakSpan baked;
+        std::vector<uint8_t> bakedStorage;
+        if (findBakedTexture(info.path, info.width, info.height, info.uploadChannels, uploadLevels(info), mipOptions(info), baked, bakedStorage))
+        {
+            const unsigned char* source = baked.data;
+            for (int level = 0; level < uploadLevels(info); level++)
+            {
+                size_t rowBytes = (size_t)levelSize(info.width, level) * info.uploadChannels;
+                for (int y = 0; y < levelSize(info.height, level); y++, source += rowBytes)
+                    memcpy(dest + levelOffset(info, level) + (size_t)rowStride(info, level) * y, source, rowBytes);
+            }
+            return true;
+        }
+
+        bool mips = uploadLevels(info) > 1;
+        bool expand = info.uploadChannels != info.channels;
+        if (!mips && !expand)
+            return imageLoadInto(info.path, dest, rowStride(info), info.width, info.height, info.channels, file);
+
+        // stb's own RGB -> RGBA conversion is a scalar loop, so decode RGB and expand here.
+        // the mip chain reads the base level back, which is slow from write-combined
+        // mapped memory, so that gets decoded to scratch first as well. not thread_local:
+        // while generateMipChain waits, this thread may pick up another texture's decode
+        std::vector<unsigned char> decoded, expanded;
+        size_t decodedStride = (size_t)info.width * info.channels;
+        decoded.resize(decodedStride * info.height);
+        if (!imageLoadInto(info.path, decoded.data(), (int)decodedStride, info.width, info.height, info.channels, file))
+            return false;
+        if (!mips)
+        {
+            for (int y = 0; y < info.height; y++)
+                expandRGBToRGBA(decoded.data() + decodedStride * y, dest + (size_t)rowStride(info) * y, info.width);
+            return true;
+        }
+
+        unsigned char* base = decoded.data();
+        size_t baseStride = decodedStride;
+        if (expand)
+        {
+            baseStride = (size_t)info.width * info.uploadChannels;
+            expanded.resize(baseStride * info.height);
+            for (int y = 0; y < info.height; y++)
+                expandRGBToRGBA(decoded.data() + decodedStride * y, expanded.data() + baseStride * y, info.width);
+            base = expanded.data();
+        }
+        for (int y = 0; y < info.height; y++)
+            memcpy(dest + (size_t)rowStride(info) * y, base + baseStride * y, baseStride);
+
+        std::vector<MipLevel> levels(info.levels);
+        levels[0] = { base, info.width, info.height, baseStride };
+        for (int level = 1; level < info.levels; level++)
+            levels[level] = { dest + levelOffset(info, level), levelSize(info.width, level), levelSize(info.height, level),
+                              (size_t)rowStride(info, level) };
+        generateMipChain(levels.data(), info.levels, info.uploadChannels, mipOptions(info));
+        return true;
+    }
+
+private:
+    std::vector<TextureInfo> textures;
+    std::vector<GLuint> ids;
+    size_t totalBytes = 0;
+
+    static void formatFor(int channels, GLenum& internalFormat, GLenum& format)
+    {
+        switch (channels)
+        {
+        case 1:  internalFormat = GL_R8;    format = GL_RED;  break;
+        case 2:  internalFormat = GL_RG8;   format = GL_RG;   break;
+        case 3:  internalFormat = GL_RGB8;  format = GL_RGB;  break;
+        default: internalFormat = GL_RGBA8; format = GL_RGBA; break;
+        }
+    }
+};
+
+#endif
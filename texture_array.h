@@ -0,0 +1,29 @@
+#ifndef TEXTURE_ARRAY_H
+#define TEXTURE_ARRAY_H
+
+#include <glad/glad.h>
+
+// Picks the layer of a GL_TEXTURE_2D_ARRAY (TextureStreamer::addArray) a draw
+// samples. The shader samples a sampler2DArray with the layer as third
+// coordinate, and the layer reaches it as a vertex attribute: per instance
+// from a buffer (bindLayerAttribute), or as a constant for plain draws
+// (setDrawLayer).
+
+// Per-instance layers: one float per instance in 'buffer', read with divisor 1.
+// The VAO to set up must be bound.
+inline void bindLayerAttribute(GLuint location, GLuint buffer, GLsizei stride = sizeof(float), size_t offset = 0)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glVertexAttribPointer(location, 1, GL_FLOAT, GL_FALSE, stride, (void*)offset);
+    glVertexAttribDivisor(location, 1);
+    glEnableVertexAttribArray(location);
+}
+
+// Layer for draws without an instance buffer: with the attribute array disabled
+// the shader reads this current value instead, no buffer or rebind needed
+inline void setDrawLayer(GLuint location, int layer)
+{
+    glVertexAttrib1f(location, (float)layer);
+}
+
+#endif
@@ -0,0 +1,246 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <glad/glad.h>
+
+#include "texture.h"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+// Keeps textures resident within a VRAM budget. Textures are registered up
+// front (header only), loaded the first time they are used, and the least
+// recently used ones lose their top mip levels and then get evicted when the
+// budget is exceeded. Anything evicted is reloaded from its file on its next use.
+//
+//      TextureCache cache(256 * 1024 * 1024);
+//      int crate = cache.add("assets/container.jpeg");
+//      ...every frame:
+//      glBindTexture(GL_TEXTURE_2D, cache.use(crate));    // the id can change, don't keep it
+//      ...
+//      cache.endFrame();
+//
+// Textures used in the current frame are never evicted, so the budget can
+// be exceeded when one frame needs more than it. Sizes are estimates (all mip
+// levels, RGB counted as RGBA). Call destroy() while the GL context is alive.
+
+class TextureCache
+{
+public:
+    struct Stats
+    {
+        size_t loads = 0;
+        size_t evictions = 0;
+        size_t mipDrops = 0;        // top levels dropped instead of evicting
+    };
+
+    explicit TextureCache(size_t budgetBytes = 256u * 1024 * 1024)
+        : budgetBytes(budgetBytes)
+    {
+    }
+
+    // Reads only the file header, nothing is loaded yet
+    int add(const std::string& path, const TextureParams& params = TextureParams())
+    {
+        Entry entry;
+        entry.info.path = path;
+        entry.info.params = params;
+        entry.failed = !TextureLoader::probeInfo(entry.info);
+        entries.push_back(entry);
+        return (int)entries.size() - 1;
+    }
+
+    // GL texture for this frame, loaded at full resolution if it isn't.
+    // 0 if the file can't be loaded.
+    GLuint use(int handle)
+    {
+        Entry& entry = entries[handle];
+        entry.lastUsed = frame;
+        if (entry.failed)
+            return 0;
+        if (!entry.id || entry.dropped)
+            load(&handle, 1);
+        return entry.id;
+    }
+
+    // Loads several textures in one go (decoded in parallel), e.g. what a
+    // level is about to need. Counts as a use.
+    void preload(const int* handles, int count)
+    {
+        for (int i = 0; i < count; i++)
+            entries[handles[i]].lastUsed = frame;
+        load(handles, count);
+    }
+
+    // Call once per frame after the draws, applies the budget
+    void endFrame()
+    {
+        frame++;
+        makeRoom(0);
+    }
+
+    void setBudget(size_t bytes)
+    {
+        budgetBytes = bytes;
+        makeRoom(0);
+    }
+
+    void destroy()
+    {
+        for (Entry& entry : entries)
+            release(entry);
+        if (framebuffers[0])
+        {
+            glDeleteFramebuffers(2, framebuffers);
+            framebuffers[0] = framebuffers[1] = 0;
+        }
+    }
+
+    bool resident(int handle) const { return entries[handle].id != 0; }
+    // the texture as it is, without counting as a use or reloading dropped levels
+    GLuint id(int handle) const { return entries[handle].id; }
+    int droppedLevels(int handle) const { return entries[handle].dropped; }
+    size_t residentBytes() const { return usedBytes; }
+    size_t budget() const { return budgetBytes; }
+    const Stats& stats() const { return counters; }
+    const TextureInfo& info(int handle) const { return entries[handle].info; }
+
+    // Levels are dropped down to this size, then the texture is evicted
+    int minDropSize = 64;
+
+private:
+    struct Entry
+    {
+        TextureInfo info;
+        GLuint id = 0;
+        int dropped = 0;            // top levels dropped, resident size is that of level 'dropped'
+        size_t bytes = 0;
+        uint64_t lastUsed = 0;
+        bool failed = false;
+    };
+
+    std::vector<Entry> entries;
+    size_t budgetBytes;
+    size_t usedBytes = 0;
+    uint64_t frame = 1;
+    Stats counters;
+    GLuint framebuffers[2] = { 0, 0 };  // read / draw, for copying levels on the GPU
+
+    void load(const int* handles, int count)
+    {
+        std::vector<const TextureInfo*> items(entries.size(), NULL);
+        size_t incoming = 0;
+        for (int i = 0; i < count; i++)
+        {
+            Entry& entry = entries[handles[i]];
+            if (entry.failed || (entry.id && !entry.dropped) || items[handles[i]])
+                continue;
+            release(entry);
+            items[handles[i]] = &entry.info;
+            incoming += entry.info.vramBytes;
+        }
+        if (!incoming)
+            return;
+        makeRoom(incoming);
+
+        for (size_t i = 0; i < items.size(); i++)
+            if (items[i])
+                entries[i].id = TextureLoader::createTexture(entries[i].info);
+        TextureLoader::decodeAndUpload(items, [this](size_t i, size_t offset)
+        {
+            TextureLoader::uploadTexture(entries[i].info, entries[i].id, offset);
+            entries[i].bytes = entries[i].info.vramBytes;
+            usedBytes += entries[i].bytes;
+            counters.loads++;
+        });
+        // no point retrying a broken file every frame
+        for (size_t i = 0; i < items.size(); i++)
+            if (items[i] && !entries[i].bytes)
+            {
+                release(entries[i]);
+                entries[i].failed = true;
+            }
+    }
+
+    // Shrinks or evicts textures not used this frame, least recently used
+    // first, until 'incoming' more bytes fit
+    void makeRoom(size_t incoming)
+    {
+        while (usedBytes + incoming > budgetBytes)
+        {
+            Entry* victim = NULL;
+            for (Entry& entry : entries)
+                if (entry.id && entry.lastUsed != frame && (!victim || entry.lastUsed < victim->lastUsed))
+                    victim = &entry;
+            if (!victim)
+                return;     // everything left is in use this frame
+            if (!dropTopLevel(*victim))
+            {
+                release(*victim);
+                counters.evictions++;
+            }
+        }
+    }
+
+    // Replaces the texture with a copy of its levels below the top one
+    bool dropTopLevel(Entry& entry)
+    {
+        const TextureInfo& full = entry.info;
+        int levels = full.levels - entry.dropped;
+        int first = entry.dropped + 1;
+        int width = TextureLoader::levelSize(full.width, first), height = TextureLoader::levelSize(full.height, first);
+        if (levels <= 1 || std::max(width, height) < minDropSize)
+            return false;
+
+        TextureInfo smaller = full;
+        smaller.width = width;
+        smaller.height = height;
+        smaller.levels = levels - 1;
+        GLuint id = TextureLoader::createTexture(smaller);
+
+        // blit level by level, no CPU round trip
+        GLint readBinding, drawBinding;
+        glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readBinding);
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawBinding);
+        if (!framebuffers[0])
+            glGenFramebuffers(2, framebuffers);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[0]);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[1]);
+        for (int level = 0; level < smaller.levels; level++)
+        {
+            int w = TextureLoader::levelSize(width, level), h = TextureLoader::levelSize(height, level);
+            glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, entry.id, level + 1);
+            glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, id, level);
+            glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        }
+        glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, readBinding);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawBinding);
+
+        glDeleteTextures(1, &entry.id);
+        entry.id = id;
+        entry.dropped++;
+        usedBytes -= entry.bytes;
+        entry.bytes = 0;
+        for (int level = 0; level < smaller.levels; level++)
+            entry.bytes += (size_t)TextureLoader::levelSize(width, level) * TextureLoader::levelSize(height, level) * full.uploadChannels;
+        usedBytes += entry.bytes;
+        counters.mipDrops++;
+        return true;
+    }
+
+    void release(Entry& entry)
+    {
+        if (entry.id)
+            glDeleteTextures(1, &entry.id);
+        entry.id = 0;
+        entry.dropped = 0;
+        usedBytes -= entry.bytes;
+        entry.bytes = 0;
+    }
+};
+
+#endif
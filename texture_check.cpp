@@ -0,0 +1,202 @@
+// Exercises the texture residency code against a real GL context (a hidden
+// window): TextureCache's budget, LRU eviction, mip drops and reloads, and
+// TextureRegistry's sharing by path and contents, per-handle samplers and release.
+// Build with `make texture_check` and run from the project root; prints what
+// failed and exits non-zero if anything did.
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "job_pool.h"
+#include "gl_ext.h"
+#include "texture.h"
+#include "texture_cache.h"
+#include "texture_registry.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <vector>
+
+static int failures = 0;
+
+static void check(bool ok, const char* what)
+{
+    if (!ok)
+    {
+        std::printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+static int levelWidth(GLuint id, int level)
+{
+    GLint width = 0;
+    glBindTexture(GL_TEXTURE_2D, id);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+    return width;
+}
+
+static std::vector<unsigned char> levelPixels(GLuint id, int level, int channels)
+{
+    int width = levelWidth(id, level);
+    std::vector<unsigned char> pixels((size_t)width * width * channels);
+    glBindTexture(GL_TEXTURE_2D, id);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTexImage(GL_TEXTURE_2D, level, channels == 4 ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+    return pixels;
+}
+
+static void checkTextureCache()
+{
+    TextureCache cache;
+    int crate = cache.add("Assets/container.jpeg");
+    int wall = cache.add("Assets/wall.jpeg");
+    int mario = cache.add("Assets/mario.png");
+    int face = cache.add("Assets/awesomeface.png");
+    int missing = cache.add("Assets/missing.png");
+    size_t all = cache.info(crate).vramBytes + cache.info(wall).vramBytes + cache.info(mario).vramBytes + cache.info(face).vramBytes;
+
+    // everything fits the default budget
+    int handles[] = { crate, wall, mario, face };
+    cache.preload(handles, 4);
+    check(cache.stats().loads == 4, "cache: preload loads all four");
+    check(cache.residentBytes() == all, "cache: resident bytes are the sum of the estimates");
+    check(cache.use(missing) == 0 && cache.use(missing) == 0, "cache: a missing file gives 0");
+    check(levelWidth(cache.use(mario), 0) == 1024, "cache: mario is loaded at full size");
+    cache.endFrame();
+
+    // the top level of mario's chain, to compare with what a drop keeps
+    std::vector<unsigned char> marioLevel1 = levelPixels(cache.use(mario), 1, 4);
+    cache.endFrame();
+
+    // crate and wall used last, the PNGs are least recently used and shrink first
+    cache.use(crate);
+    cache.use(wall);
+    cache.endFrame();
+    cache.setBudget(all - cache.info(mario).vramBytes / 2);
+    check(cache.residentBytes() <= cache.budget(), "cache: shrinking the budget applies it");
+    check(cache.stats().mipDrops >= 1, "cache: over budget drops top levels first");
+    // face (last used first) shrinks to 64 and goes, then mario loses its top level
+    check(!cache.resident(face) && cache.stats().evictions == 1, "cache: the least recently used texture goes first");
+    check(cache.droppedLevels(mario) == 1, "cache: then the next one loses its top level");
+    check(cache.droppedLevels(crate) == 0 && cache.droppedLevels(wall) == 0, "cache: textures used last frame aren't touched");
+    check(cache.resident(crate) && cache.resident(wall), "cache: recently used textures keep their levels");
+    check(cache.use(face) != 0 && levelWidth(cache.id(face), 0) == 512, "cache: an evicted texture reloads on use");
+    cache.endFrame();
+
+    // a budget that only fits what this frame used: everything else goes
+    cache.use(crate);
+    cache.setBudget(cache.info(crate).vramBytes);
+    check(cache.residentBytes() == cache.info(crate).vramBytes, "cache: a tight budget keeps only this frame's texture");
+    check(cache.resident(crate) && cache.droppedLevels(crate) == 0, "cache: textures used this frame are never shrunk");
+    cache.endFrame();
+
+    // the drop copies levels on the GPU: the shrunk texture's level 0 is the old level 1
+    cache.setBudget(all);
+    cache.use(mario);
+    cache.endFrame();
+    cache.use(crate);
+    cache.use(wall);
+    cache.use(face);
+    cache.setBudget(all - cache.info(mario).vramBytes / 2);
+    check(cache.droppedLevels(mario) == 1, "cache: one drop is enough for half of mario");
+    if (cache.droppedLevels(mario) == 1)
+        check(levelPixels(cache.id(mario), 0, 4) == marioLevel1, "cache: the dropped texture keeps the lower levels' pixels");
+    cache.destroy();
+    check(cache.residentBytes() == 0, "cache: destroy releases everything");
+    check(glGetError() == GL_NO_ERROR, "cache: no GL errors");
+}
+
+static void checkTextureRegistry()
+{
+    // a copy under another name, only the content hash can tell it's the same
+    std::filesystem::path copy = std::filesystem::temp_directory_path() / "texture_check_wall.jpeg";
+    std::error_code error;
+    std::filesystem::copy_file("Assets/wall.jpeg", copy, std::filesystem::copy_options::overwrite_existing, error);
+    check(!error, "registry: copying wall.jpeg to the temp directory");
+
+    TextureRegistry registry;
+    TextureParams clamped;
+    clamped.wrap = GL_CLAMP_TO_EDGE;
+    TextureParams noMips;
+    noMips.mipmaps = false;
+    int wall = registry.acquire("Assets/wall.jpeg");
+    int samePath = registry.acquire("./Assets/../Assets/wall.jpeg", clamped);
+    int copied = registry.acquire(copy.string());
+    int flat = registry.acquire("Assets/wall.jpeg", noMips);
+    int crate = registry.acquire("Assets/container.jpeg");
+    int missing = registry.acquire("Assets/missing.png");
+    check(registry.sameTexture(wall, samePath), "registry: another path to the same file shares the image");
+    check(registry.stats().pathHits == 1, "registry: that counts as a path hit");
+    check(!registry.sameTexture(wall, flat), "registry: params that change the pixels don't share");
+
+    check(!registry.load(), "registry: load() reports the missing file");
+    check(registry.failed(missing) && registry.id(missing) == 0, "registry: the missing file's handle stays, with id 0");
+    check(registry.sameTexture(wall, copied), "registry: a copy under another name shares by content");
+    check(registry.stats().contentHits == 1, "registry: that counts as a content hit");
+    check(registry.stats().loads == 3, "registry: wall, wall without mips and crate load once each");
+    check(registry.textureCount() == 4, "registry: three textures and the failed one");
+    check(registry.id(wall) && registry.id(wall) == registry.id(copied) && registry.id(crate) != registry.id(wall),
+          "registry: shared handles have one GL texture");
+    check(registry.savedBytes() == 2 * registry.info(wall).vramBytes, "registry: saved bytes count the two shared handles");
+    check(levelWidth(registry.id(flat), 0) == 512 && registry.info(flat).levels == 1, "registry: the no-mips texture has one level");
+
+    // one texture, each handle keeps its own sampler
+    check(registry.sampler(wall).wrapS != registry.sampler(samePath).wrapS, "registry: handles keep their own sampler state");
+    registry.bind(samePath, 0);
+    GLint sampler = 0;
+    glActiveTexture(GL_TEXTURE0);
+    glGetIntegerv(GL_SAMPLER_BINDING, &sampler);
+    check((GLuint)sampler == SamplerCache::shared().get(registry.sampler(samePath)), "registry: bind() binds the handle's sampler");
+
+    // the texture goes with the last handle
+    GLuint shared = registry.id(wall);
+    registry.release(wall);
+    registry.release(samePath);
+    check(glIsTexture(shared), "registry: released handles leave the texture to the others");
+    registry.release(copied);
+    check(!glIsTexture(shared), "registry: the last release deletes the texture");
+    int again = registry.acquire("Assets/wall.jpeg");
+    check(registry.id(again) == 0, "registry: acquiring after the last release starts over");
+    check(registry.load() && registry.id(again) != 0, "registry: and loads again");
+
+    registry.destroy();
+    SamplerCache::shared().destroy();
+    std::filesystem::remove(copy, error);
+    check(glGetError() == GL_NO_ERROR, "registry: no GL errors");
+}
+
+int main()
+{
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(64, 64, "texture_check", NULL, NULL);
+    if (window == NULL)
+    {
+        std::printf("ERROR::TEXTURE_CHECK::NO_CONTEXT\n");
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::printf("ERROR::TEXTURE_CHECK::NO_GLAD\n");
+        glfwTerminate();
+        return 1;
+    }
+    loadGLExtensions((GLADloadproc)glfwGetProcAddress);
+
+    checkTextureCache();
+    checkTextureRegistry();
+
+    glfwTerminate();
+    std::printf(failures ? "texture_check: %d failed\n" : "texture_check: ok\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,380 @@
+#ifndef TEXTURE_REGISTRY_H
+#define TEXTURE_REGISTRY_H
+
+#include <glad/glad.h>
+
+#include "texture.h"
+#include "job_pool.h"
+#include "hash.h"
+#include "sampler_cache.h"
+#include "gl_state_cache.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdlib>
+#include <cstdio>
+#include <climits>
+#include <iostream>
+
+// Shares one GL texture between everything that asks for the same image:
+//
+//      TextureRegistry registry;
+//      int a = registry.acquire("assets/wall.jpeg");
+//      int b = registry.acquire("./assets/../assets/wall.jpeg", clampParams);     // same texture
+//      registry.load();        // decodes whatever is new, in parallel
+//      registry.bind(a, 0);    // texture unit 0, with a's sampler
+//      ...
+//      registry.release(a);    // the texture goes when the last handle does
+//
+// Images are matched by canonical path (symlinks, "..", "./" resolved) and,
+// with hashContents, also by an xxHash of the file, so copies under other
+// names load once too. Parameters that change the pixels (mipmaps and how
+// they are built) are part of the match; wrap and filters are not, every
+// handle keeps its own SamplerDesc and bind() binds the shared sampler object
+// for it (sampler_cache.h), the texture is never changed. The first handle's
+// wrap decides how CPU mips treat edges.
+// Call destroy() while the GL context is still alive.
+
+class TextureRegistry
+{
+public:
+    struct Stats
+    {
+        size_t acquires = 0;
+        size_t pathHits = 0;        // same canonical path as a live image
+        size_t contentHits = 0;     // other path, same file contents
+        size_t loads = 0;
+
+        float hitRate() const { return acquires ? (float)(pathHits + contentHits) / acquires : 0.0f; }
+    };
+
+    explicit TextureRegistry(bool hashContents = true)
+        : hashContents(hashContents)
+    {
+    }
+
+    // Handle to the image at 'path', nothing is read until load()
+    int acquire(const std::string& path, const TextureParams& params = TextureParams())
+    {
+        counters.acquires++;
+        std::string key = canonicalPath(path) + '|' + contentParams(params);
+        int image;
+        auto found = byPath.find(key);
+        if (found != byPath.end())
+        {
+            image = found->second;
+            counters.pathHits++;
+        }
+        else
+        {
+            image = newImage();
+            Image& entry = images[image];
+            entry.info.path = path;
+            entry.info.params = params;
+            entry.pathKeys.push_back(key);
+            byPath[key] = image;
+            pending.push_back(image);
+        }
+        images[image].refs++;
+
+        int handle;
+        if (!freeHandles.empty())
+        {
+            handle = freeHandles.back();
+            freeHandles.pop_back();
+        }
+        else
+        {
+            handle = (int)handles.size();
+            handles.push_back(Handle());
+        }
+        handles[handle].image = image;
+        handles[handle].sampler = SamplerDesc(params.wrap, params.minFilter, params.magFilter);
+        return handle;
+    }
+
+    // Another reference to the same handle, release() it separately
+    int acquire(int handle)
+    {
+        const TextureInfo info = images[handles[handle].image].info;
+        int copy = acquire(info.path, info.params);
+        handles[copy].sampler = handles[handle].sampler;
+        return copy;
+    }
+
+    // e.g. anisotropy or LOD bias, which TextureParams doesn't have
+    void setSampler(int handle, const SamplerDesc& sampler) { handles[handle].sampler = sampler; }
+    const SamplerDesc& sampler(int handle) const { return handles[handle].sampler; }
+
+    void release(int handle)
+    {
+        int image = handles[handle].image;
+        handles[handle].image = -1;
+        freeHandles.push_back(handle);
+        if (--images[image].refs == 0)
+            freeImage(image);
+    }
+
+    // Loads every image acquired since the last call: headers, content hashes
+    // and decodes all on the job pool. Returns false if any failed; their
+    // handles stay valid with id 0.
+    bool load()
+    {
+        if (pending.empty())
+            return true;
+        std::vector<int> batch;
+        batch.swap(pending);
+
+        // loose files are read once, then probed, hashed and decoded from memory
+        std::vector<std::string> paths(batch.size());
+        for (size_t i = 0; i < batch.size(); i++)
+            paths[i] = images[batch[i]].info.path;
+        std::vector<std::vector<uint8_t>> files;
+        TextureLoader::readLooseFiles(paths, files);
+
+        // header and hash of each new file, on the job pool
+        std::vector<char> probed(batch.size(), 0), hashed(batch.size(), 0);
+        JobPool::shared().parallelFor((int)batch.size(), [&](int i)
+        {
+            Image& image = images[batch[i]];
+            PakSpan file = { files[i].data(), files[i].size() };
+            const PakSpan* loose = files[i].empty() ? NULL : &file;
+            probed[i] = (char)TextureLoader::probeInfo(image.info, loose);
+            if (probed[i] && hashContents)
+                hashed[i] = (char)hashAsset(image, loose);
+        });
+
+        std::vector<const TextureInfo*> items;
+        std::vector<int> itemImages;
+        std::vector<std::vector<uint8_t>> itemFiles;
+        bool ok = true;
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            int image = batch[i];
+            if (!probed[i])
+            {
+                images[image].failed = true;
+                ok = false;
+                continue;
+            }
+            if (hashed[i])
+            {
+                std::string key = contentKey(images[image]);
+                auto found = byContent.find(key);
+                if (found != byContent.end())
+                {
+                    merge(image, found->second);
+                    continue;
+                }
+                byContent[key] = image;
+                images[image].contentKey = key;
+            }
+            Image& entry = images[image];
+            entry.id = TextureLoader::createTexture(entry.info);
+            items.push_back(&entry.info);
+            itemImages.push_back(image);
+            itemFiles.push_back(std::vector<uint8_t>());
+            itemFiles.back().swap(files[i]);
+        }
+
+        std::vector<char> uploaded(items.size(), 0);
+        TextureLoader::decodeAndUpload(items, [&](size_t i, size_t offset)
+        {
+            TextureLoader::uploadTexture(*items[i], images[itemImages[i]].id, offset);
+            uploaded[i] = 1;
+            counters.loads++;
+        }, &itemFiles);
+        // keep the broken ones around so acquiring them again doesn't retry every time
+        for (size_t i = 0; i < items.size(); i++)
+            if (!uploaded[i])
+            {
+                Image& image = images[itemImages[i]];
+                glState().forgetTexture(image.id);
+                glDeleteTextures(1, &image.id);
+                image.id = 0;
+                image.failed = true;
+                ok = false;
+            }
+        glState().invalidate();     // the loader bound textures behind its back
+        return ok;
+    }
+
+    // Binds the texture and this handle's sampler to 'unit'
+    void bind(int handle, int unit)
+    {
+        const Handle& h = handles[handle];
+        glState().bindTexture(unit, GL_TEXTURE_2D, images[h.image].id);
+        glState().bindSampler(unit, SamplerCache::shared().get(h.sampler));
+    }
+
+    void destroy()
+    {
+        for (Image& image : images)
+            if (image.id)
+            {
+                glState().forgetTexture(image.id);
+                glDeleteTextures(1, &image.id);
+                image.id = 0;
+            }
+    }
+
+    // 0 until loaded or if loading failed. Shared, sample it with sampler()
+    GLuint id(int handle) const { return images[handles[handle].image].id; }
+    bool failed(int handle) const { return images[handles[handle].image].failed; }
+    const TextureInfo& info(int handle) const { return images[handles[handle].image].info; }
+    bool sameTexture(int a, int b) const { return handles[a].image == handles[b].image; }
+    const Stats& stats() const { return counters; }
+
+    size_t textureCount() const
+    {
+        size_t count = 0;
+        for (const Image& image : images)
+            count += image.refs > 0;
+        return count;
+    }
+
+    // GPU memory of the loaded textures, and what loading each handle on its own would have added
+    size_t residentBytes() const
+    {
+        size_t bytes = 0;
+        for (const Image& image : images)
+            if (image.id)
+                bytes += image.info.vramBytes;
+        return bytes;
+    }
+
+    size_t savedBytes() const
+    {
+        size_t bytes = 0;
+        for (const Image& image : images)
+            if (image.id)
+                bytes += image.info.vramBytes * (image.refs - 1);
+        return bytes;
+    }
+
+private:
+    struct Image
+    {
+        TextureInfo info;
+        GLuint id = 0;
+        int refs = 0;
+        bool failed = false;
+        uint64_t hash = 0;
+        size_t fileSize = 0;
+        std::vector<std::string> pathKeys;  // every path that led here
+        std::string contentKey;
+    };
+    struct Handle
+    {
+        int image = -1;
+        SamplerDesc sampler;
+    };
+
+    bool hashContents;
+    std::vector<Image> images;
+    std::vector<int> freeImages;
+    std::vector<Handle> handles;
+    std::vector<int> freeHandles;
+    std::vector<int> pending;
+    std::unordered_map<std::string, int> byPath, byContent;
+    Stats counters;
+
+    int newImage()
+    {
+        if (!freeImages.empty())
+        {
+            int image = freeImages.back();
+            freeImages.pop_back();
+            return image;
+        }
+        images.push_back(Image());
+        return (int)images.size() - 1;
+    }
+
+    void freeImage(int image)
+    {
+        Image& entry = images[image];
+        if (entry.id)
+        {
+            glState().forgetTexture(entry.id);
+            glDeleteTextures(1, &entry.id);
+        }
+        for (const std::string& key : entry.pathKeys)
+            byPath.erase(key);
+        if (!entry.contentKey.empty())
+            byContent.erase(entry.contentKey);
+        for (size_t i = 0; i < pending.size(); i++)
+            if (pending[i] == image)
+            {
+                pending.erase(pending.begin() + i);
+                break;
+            }
+        entry = Image();
+        freeImages.push_back(image);
+    }
+
+    // 'from' turned out to hold the same file as 'into': its handles and path
+    // move over. only its first acquire missed, the rest already counted as path hits
+    void merge(int from, int into)
+    {
+        Image& source = images[from];
+        Image& target = images[into];
+        counters.contentHits++;
+        for (Handle& handle : handles)
+            if (handle.image == from)
+            {
+                handle.image = into;
+                source.refs--;
+                target.refs++;
+            }
+        for (const std::string& key : source.pathKeys)
+        {
+            byPath[key] = into;
+            target.pathKeys.push_back(key);
+        }
+        source.pathKeys.clear();
+        freeImage(from);
+    }
+
+    static std::string canonicalPath(const std::string& path)
+    {
+        char resolved[PATH_MAX];
+        if (realpath(path.c_str(), resolved))
+            return resolved;
+        // not on disk: in a mounted pak, or missing and fails at load()
+        return "pak:" + PakArchive::normalizeName(path);
+    }
+
+    // the loose file load() read, otherwise the file in a mounted pak
+    static bool hashAsset(Image& image, const PakSpan* loose)
+    {
+        PakSpan span;
+        std::vector<uint8_t> storage;
+        if (loose)
+            span = *loose;
+        else if (!findAsset(image.info.path, span, storage))
+            return false;
+        image.hash = xxhash64(span.data, span.size);
+        image.fileSize = span.size;
+        return true;
+    }
+
+    // the params that change what ends up in the texture
+    static std::string contentParams(const TextureParams& params)
+    {
+        char key[64];
+        snprintf(key, sizeof(key), "%d%d%d%d%d", params.mipmaps, params.cpuMipmaps, (int)params.mipOptions.filter,
+                 params.mipOptions.srgb, params.mipOptions.premultiply);
+        return key;
+    }
+
+    static std::string contentKey(const Image& image)
+    {
+        char key[64];
+        snprintf(key, sizeof(key), "%016llx:%zu|", (unsigned long long)image.hash, image.fileSize);
+        return key + contentParams(image.info.params);
+    }
+};
+
+#endif
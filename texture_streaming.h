@@ -0,0 +1,442 @@
+#ifndef TEXTURE_STREAMING_H
+#define TEXTURE_STREAMING_H
+
+#include <glad/glad.h>
+
+#include "texture.h"
+#include "job_pool.h"
+#include "async_io.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// Streams textures in mip level by mip level, finest last and only as fine as
+// what is on screen needs:
+//
+//      TextureStreamer streamer;
+//      int crate = streamer.add("assets/container.jpeg");
+//      streamer.start();       // headers only, then files are read (AsyncIO) and decoded on the job pool
+//      ...every frame, per visible object:
+//      streamer.request(crate, TextureStreamer::mipLevelFor(512, 1.0f, distance, projectionScale));
+//      ...after the draws:
+//      streamer.update();      // uploads the next levels within the per-frame byte budget
+//
+// Until a texture's decode finishes it shows a 1x1 grey level. Levels are
+// allocated only when they are uploaded (mutable storage), and
+// GL_TEXTURE_BASE_LEVEL is moved down as they arrive, so levels nothing asked
+// for never take up memory. Only BASE_LEVEL: lambda is clamped by MIN_LOD and
+// then added to the base level, so setting both would sample twice as far
+// down the chain as what's resident.
+// The decoded chain only stays in CPU memory until it's needed: a level is
+// freed once it's uploaded, and levels more than one finer than what's asked
+// for are dropped. Asking for those later reads and decodes the file again.
+// Call destroy() while the GL context is still alive.
+
+class TextureStreamer
+{
+public:
+    explicit TextureStreamer(size_t uploadBytesPerFrame = 4 * 1024 * 1024)
+        : uploadBudget(uploadBytesPerFrame)
+    {
+    }
+
+    ~TextureStreamer()
+    {
+        waitForDecodes();
+    }
+
+    int add(const std::string& path, const TextureParams& params = TextureParams())
+    {
+        return addTexture(GL_TEXTURE_2D, std::vector<std::string>(1, path), params);
+    }
+
+    // One GL_TEXTURE_2D_ARRAY, layer i from paths[i]; all need the same size and format
+    int addArray(const std::vector<std::string>& paths, const TextureParams& params = TextureParams())
+    {
+        return addTexture(GL_TEXTURE_2D_ARRAY, paths, params);
+    }
+
+    // Reads the headers, creates the textures with their placeholder level and
+    // starts decoding. Returns false if a texture can't be streamed.
+    bool start()
+    {
+        bool ok = true;
+        for (std::unique_ptr<Texture>& texture : textures)
+        {
+            if (texture->id)
+                continue;
+            Texture& t = *texture;
+            for (std::unique_ptr<Layer>& layer : t.layers)
+            {
+                layer->info.params = t.params;
+                if (!TextureLoader::probeInfo(layer->info))
+                    t.failed = true;
+                else if (layer->info.width != t.layers[0]->info.width || layer->info.height != t.layers[0]->info.height ||
+                         layer->info.uploadChannels != t.layers[0]->info.uploadChannels)
+                {
+                    std::cout << "ERROR::TEXTURE_STREAMER::LAYER_MISMATCH " << layer->info.path << std::endl;
+                    t.failed = true;
+                }
+            }
+            if (t.failed)
+            {
+                ok = false;
+                continue;
+            }
+            t.info = t.layers[0]->info;
+            createWithPlaceholder(t);
+            for (std::unique_ptr<Layer>& layer : t.layers)
+                queueRead(*layer);
+        }
+        AsyncIO::shared().submit();
+        return ok;
+    }
+
+    // This frame an object shows the texture at 'level' (0 = full size). The
+    // finest level asked for during a frame is what update() streams towards.
+    void request(int handle, float level)
+    {
+        Texture& t = *textures[handle];
+        int wanted = (int)std::floor(level);
+        wanted = wanted < 0 ? 0 : wanted;
+        if (t.requested < 0 || wanted < t.requested)
+            t.requested = wanted;
+    }
+
+    // Call once per frame: uploads finer levels of the requested textures,
+    // coarse to fine, until the next one would go over the frame's byte budget
+    void update()
+    {
+        AsyncIO::shared().poll();   // finished reads go on to decoding
+        decodeInline();
+        size_t spent = 0;
+        bool reread = false;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);      // decoded rows are tightly packed
+        for (std::unique_ptr<Texture>& texture : textures)
+        {
+            Texture& t = *texture;
+            int target = t.requested;
+            t.requested = -1;
+            if (t.failed || !t.id || target < 0 || !decoded(t))
+                continue;   // a layer that failed to decode leaves the placeholder
+            if (target > t.info.levels - 1)
+                target = t.info.levels - 1;
+            if (target < t.resident && t.layers[0]->levels[t.resident - 1].empty())
+            {
+                // dropped while it was further away, decode again
+                for (std::unique_ptr<Layer>& layer : t.layers)
+                    queueRead(*layer);
+                reread = true;
+                continue;
+            }
+            while (t.resident > target)
+            {
+                // the first upload of a frame always goes, or a level bigger than the budget never would
+                size_t bytes = levelBytes(t, t.resident - 1);
+                if (spent > 0 && spent + bytes > uploadBudget)
+                    break;
+                uploadLevel(t, t.resident - 1);
+                spent += bytes;
+            }
+            // one level finer than asked for stays, for an object coming closer
+            dropLevels(t, target > 0 ? target - 1 : 0);
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        uploadedBytes += spent;
+        if (reread)
+            AsyncIO::shared().submit();
+    }
+
+    void destroy()
+    {
+        waitForDecodes();
+        for (std::unique_ptr<Texture>& texture : textures)
+            if (texture->id)
+            {
+                glDeleteTextures(1, &texture->id);
+                texture->id = 0;
+            }
+    }
+
+    // Level that fits an object 'worldSize' units across, showing 'texels' of
+    // the texture over that size, at 'distance' from the camera.
+    // projectionScale is pixels per world unit at distance 1.
+    static float mipLevelFor(int texels, float worldSize, float distance, float projectionScale)
+    {
+        float pixels = worldSize * projectionScale / (distance > 1e-4f ? distance : 1e-4f);
+        return pixels > 0.0f ? std::log2((float)texels / pixels) : 1e9f;
+    }
+
+    GLuint id(int handle) const { return textures[handle]->id; }
+    // finest level uploaded so far, levels() while only the placeholder is there
+    int residentLevel(int handle) const { return textures[handle]->resident; }
+    const TextureInfo& info(int handle) const { return textures[handle]->info; }
+    size_t totalUploadedBytes() const { return uploadedBytes; }
+
+    // decoded levels still held in CPU memory, waiting to be uploaded
+    size_t cpuBytes() const
+    {
+        size_t bytes = 0;
+        for (const std::unique_ptr<Texture>& texture : textures)
+            for (const std::unique_ptr<Layer>& layer : texture->layers)
+                if (layer->state.load(std::memory_order_acquire) == DECODED)
+                    for (const std::vector<unsigned char>& level : layer->levels)
+                        bytes += level.size();
+        return bytes;
+    }
+
+    // still reading or decoding, streaming isn't settled (and allocates) until this is false
+    bool busy() const
+    {
+        for (const std::unique_ptr<Texture>& texture : textures)
+            if (texture->id)
+                for (const std::unique_ptr<Layer>& layer : texture->layers)
+                {
+                    int state = layer->state.load(std::memory_order_acquire);
+                    if (state == READING || state == QUEUED || state == DECODING)
+                        return true;
+                }
+        return false;
+    }
+
+private:
+    struct Layer
+    {
+        TextureInfo info;
+        std::vector<uint8_t> file;                          // the encoded image, until it's decoded
+        std::vector<std::vector<unsigned char>> levels;     // CPU mip chain, tightly packed; uploaded and unwanted levels are empty
+        std::atomic<int> state{ READING };
+    };
+    struct Texture
+    {
+        GLenum target = GL_TEXTURE_2D;
+        TextureParams params;
+        TextureInfo info;                   // of layer 0, all layers match
+        std::vector<std::unique_ptr<Layer>> layers;
+        GLuint id = 0;
+        int resident = 0;                   // finest level on the GPU
+        int requested = -1;                 // finest level asked for this frame
+        bool failed = false;
+    };
+    enum { READING, QUEUED, DECODING, DECODED, FAILED };
+
+    std::vector<std::unique_ptr<Texture>> textures;
+    size_t uploadBudget;
+    size_t uploadedBytes = 0;
+
+    int addTexture(GLenum target, const std::vector<std::string>& paths, const TextureParams& params)
+    {
+        std::unique_ptr<Texture> texture(new Texture());
+        texture->target = target;
+        texture->params = params;
+        for (const std::string& path : paths)
+        {
+            texture->layers.emplace_back(new Layer());
+            texture->layers.back()->info.path = path;
+        }
+        textures.push_back(std::move(texture));
+        return (int)textures.size() - 1;
+    }
+
+    static bool decoded(const Texture& t)
+    {
+        for (const std::unique_ptr<Layer>& layer : t.layers)
+            if (layer->state.load(std::memory_order_acquire) != DECODED)
+                return false;
+        return true;
+    }
+
+    void createWithPlaceholder(Texture& t)
+    {
+        const TextureInfo& info = t.info;
+        int last = info.levels - 1;
+        glGenTextures(1, &t.id);
+        glBindTexture(t.target, t.id);
+        glTexParameteri(t.target, GL_TEXTURE_WRAP_S, info.params.wrap);
+        glTexParameteri(t.target, GL_TEXTURE_WRAP_T, info.params.wrap);
+        glTexParameteri(t.target, GL_TEXTURE_MIN_FILTER, info.params.minFilter);
+        glTexParameteri(t.target, GL_TEXTURE_MAG_FILTER, info.params.magFilter);
+        glTexParameteri(t.target, GL_TEXTURE_MAX_LEVEL, last);
+        glTexParameteri(t.target, GL_TEXTURE_BASE_LEVEL, last);
+        TextureLoader::setSwizzle(t.target, info.uploadChannels);
+        t.resident = info.levels;
+
+        // the coarsest level as plain grey until the real one is uploaded. with
+        // mipmaps that level is 1x1, without it is the only one and a full upload replaces it
+        int w = TextureLoader::levelSize(info.width, last), h = TextureLoader::levelSize(info.height, last);
+        std::vector<unsigned char> grey((size_t)w * h * info.uploadChannels * t.layers.size(), 128);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        if (t.target == GL_TEXTURE_2D_ARRAY)
+            glTexImage3D(t.target, last, info.internalFormat, w, h, (GLsizei)t.layers.size(), 0, info.format, GL_UNSIGNED_BYTE, grey.data());
+        else
+            glTexImage2D(t.target, last, info.internalFormat, w, h, 0, info.format, GL_UNSIGNED_BYTE, grey.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+
+    static size_t levelBytes(const Texture& t, int level)
+    {
+        const TextureInfo& info = t.info;
+        return (size_t)TextureLoader::levelSize(info.width, level) * TextureLoader::levelSize(info.height, level) *
+               info.uploadChannels * t.layers.size();
+    }
+
+    // the CPU copy of 'level' goes once it's on the GPU
+    void uploadLevel(Texture& t, int level)
+    {
+        const TextureInfo& info = t.info;
+        int w = TextureLoader::levelSize(info.width, level), h = TextureLoader::levelSize(info.height, level);
+        glBindTexture(t.target, t.id);
+        if (t.target == GL_TEXTURE_2D_ARRAY)
+        {
+            GLsizei layers = (GLsizei)t.layers.size();
+            glTexImage3D(t.target, level, info.internalFormat, w, h, layers, 0, info.format, GL_UNSIGNED_BYTE, NULL);
+            for (GLsizei layer = 0; layer < layers; layer++)
+                glTexSubImage3D(t.target, level, 0, 0, layer, w, h, 1, info.format, GL_UNSIGNED_BYTE, t.layers[layer]->levels[level].data());
+        }
+        else
+            glTexImage2D(t.target, level, info.internalFormat, w, h, 0, info.format, GL_UNSIGNED_BYTE, t.layers[0]->levels[level].data());
+        // the new level is complete, start sampling from it
+        glTexParameteri(t.target, GL_TEXTURE_BASE_LEVEL, level);
+        t.resident = level;
+        for (std::unique_ptr<Layer>& layer : t.layers)
+            std::vector<unsigned char>().swap(layer->levels[level]);
+    }
+
+    // frees the CPU levels finer than 'keep' and the ones already on the GPU
+    static void dropLevels(Texture& t, int keep)
+    {
+        for (std::unique_ptr<Layer>& layer : t.layers)
+            for (int level = 0; level < (int)layer->levels.size(); level++)
+                if (level < keep || level >= t.resident)
+                    std::vector<unsigned char>().swap(layer->levels[level]);
+    }
+
+    // full mip chain of one layer in CPU memory, runs on the job pool
+    static void decodeLayer(Layer& layer)
+    {
+        const TextureInfo& info = layer.info;
+        int channels = info.uploadChannels;
+        layer.levels.resize(info.levels);
+        for (int level = 0; level < info.levels; level++)
+            layer.levels[level].resize((size_t)TextureLoader::levelSize(info.width, level) * TextureLoader::levelSize(info.height, level) * channels);
+
+        // a chain baked by asset_build is copied as is
+        PakSpan baked;
+        std::vector<uint8_t> bakedStorage;
+        if (findBakedTexture(info.path, info.width, info.height, channels, info.levels, TextureLoader::mipOptions(info), baked, bakedStorage))
+        {
+            const unsigned char* source = baked.data;
+            for (std::vector<unsigned char>& level : layer.levels)
+            {
+                memcpy(level.data(), source, level.size());
+                source += level.size();
+            }
+            layer.state.store(DECODED, std::memory_order_release);
+            return;
+        }
+
+        bool ok;
+        PakSpan file = { layer.file.data(), layer.file.size() };
+        const PakSpan* encoded = layer.file.empty() ? NULL : &file;
+        if (info.channels == channels)
+            ok = TextureLoader::imageLoadInto(info.path, layer.levels[0].data(), info.width * channels, info.width, info.height, channels, encoded);
+        else
+        {
+            std::vector<unsigned char> rgb((size_t)info.width * info.height * 3);
+            ok = TextureLoader::imageLoadInto(info.path, rgb.data(), info.width * 3, info.width, info.height, 3, encoded);
+            if (ok)
+                expandRGBToRGBA(rgb.data(), layer.levels[0].data(), (size_t)info.width * info.height);
+        }
+        std::vector<uint8_t>().swap(layer.file);
+        if (!ok)
+        {
+            std::cout << "ERROR::TEXTURE_STREAMER::LOAD_FAILED " << info.path << std::endl;
+            layer.state.store(FAILED, std::memory_order_release);
+            return;
+        }
+
+        if (info.levels > 1)
+        {
+            std::vector<MipLevel> mips(info.levels);
+            for (int level = 0; level < info.levels; level++)
+            {
+                int w = TextureLoader::levelSize(info.width, level);
+                mips[level] = { layer.levels[level].data(), w, TextureLoader::levelSize(info.height, level), (size_t)w * channels };
+            }
+            generateMipChain(mips.data(), info.levels, channels, TextureLoader::mipOptions(info));
+        }
+        layer.state.store(DECODED, std::memory_order_release);
+    }
+
+    // Loose files are read in the background first, at low priority so loads
+    // that wait on their reads go ahead. Packed ones are in memory already.
+    void queueRead(Layer& layer)
+    {
+        if (isPackedAsset(layer.info.path))
+        {
+            layer.state.store(QUEUED);
+            queueDecode(layer);
+            return;
+        }
+        layer.state.store(READING);
+        AsyncIO::shared().read(layer.info.path, [this, &layer](bool ok, std::vector<uint8_t>& bytes)
+        {
+            if (ok)
+                layer.file.swap(bytes);     // otherwise decoding tries the path and reports it
+            layer.state.store(QUEUED);
+            queueDecode(layer);
+        }, IO_PRIORITY_LOW);
+    }
+
+    void queueDecode(Layer& layer)
+    {
+        // with no worker threads a submitted job would only run when someone
+        // waits for the pool, so update() decodes those itself
+        if (JobPool::shared().threadCount() == 0)
+            return;
+        layer.state.store(DECODING);
+        JobPool::shared().submit([&layer] { decodeLayer(layer); });
+    }
+
+    // one layer per frame when nothing decodes in the background
+    void decodeInline()
+    {
+        for (std::unique_ptr<Texture>& texture : textures)
+            if (texture->id)
+                for (std::unique_ptr<Layer>& layer : texture->layers)
+                    if (layer->state.load() == QUEUED)
+                    {
+                        layer->state.store(DECODING);
+                        decodeLayer(*layer);
+                        return;
+                    }
+    }
+
+    void waitForDecodes()
+    {
+        // reads still hold on to their layers, and turn into decodes when done
+        for (std::unique_ptr<Texture>& texture : textures)
+            for (std::unique_ptr<Layer>& layer : texture->layers)
+                if (texture->id && layer->state.load() == READING)
+                {
+                    AsyncIO::shared().wait();
+                    break;
+                }
+        for (std::unique_ptr<Texture>& texture : textures)
+            for (std::unique_ptr<Layer>& layer : texture->layers)
+                if (layer->state.load() == DECODING)
+                {
+                    JobPool::shared().waitIdle();
+                    return;
+                }
+    }
+};
+
+#endif
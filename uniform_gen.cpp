@@ -0,0 +1,102 @@
+// Generates typed uniform structs from a shader's linked program:
+//
+//      ./uniform_gen Box shader_uniforms.h Shaders/shader.vs Shaders/shader.fs [KEYWORD...]
+//
+// compiles the shader (with the keywords enabled) on a hidden window's
+// context, reflects it (shader_reflect.h) and writes "<Name>Uniforms" for
+// the default block and "<Block>Block" for each uniform block. The file is
+// only rewritten when it changes. Build with `make uniform_gen`, or run
+// `make uniforms` to regenerate main.cpp's after a shader edit; the
+// static_asserts in the header catch blocks that changed without it.
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "shader_s.h"
+#include "shader_reflect.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+    if (argc < 5)
+    {
+        std::printf("usage: %s Name out.h shader.vs shader.fs [KEYWORD...]\n", argv[0]);
+        return 1;
+    }
+    std::string name = argv[1];
+    const char* output = argv[2];
+    ShaderDefines defines;
+    for (int arg = 5; arg < argc; arg++)
+        defines.enable(argv[arg]);
+
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(64, 64, "uniform_gen", NULL, NULL);
+    if (window == NULL)
+    {
+        std::printf("ERROR::UNIFORM_GEN::NO_CONTEXT\n");
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::printf("ERROR::UNIFORM_GEN::NO_GLAD\n");
+        glfwTerminate();
+        return 1;
+    }
+
+    // the shader prints its own compile errors
+    Shader shader(argv[3], argv[4], defines);
+    GLint linked = 0;
+    glGetProgramiv(shader.ID, GL_LINK_STATUS, &linked);
+    if (!linked)
+    {
+        glfwTerminate();
+        return 1;
+    }
+    ProgramReflection reflection = reflectProgram(shader.ID);
+    glDeleteProgram(shader.ID);
+    glfwTerminate();
+
+    std::string guard;
+    for (const char* c = output; *c; c++)
+        guard += isalnum((unsigned char)*c) ? (char)toupper((unsigned char)*c) : '_';
+    std::string text = "// Generated by uniform_gen from " + std::string(argv[3]) + " and " + argv[4];
+    for (const std::string& keyword : defines.keywords)
+        text += " " + keyword;
+    text += ", don't edit.\n// Regenerate with uniform_gen (`make uniforms`) after changing the shader's uniforms.\n";
+    text += "#ifndef " + guard + "\n#define " + guard + "\n\n";
+    text += "#include <glad/glad.h>\n#include <glm/glm.hpp>\n\n#include \"shader_s.h\"\n#include \"uniform_id.h\"\n\n";
+    text += "#include <cstddef>\n#include <cstdint>\n\n";
+    std::string error;
+    if (!writeUniformStructs(reflection, name, text, error))
+    {
+        std::printf("ERROR::UNIFORM_GEN::%s %s\n", name.c_str(), error.c_str());
+        return 1;
+    }
+    text += "\n#endif\n";
+
+    std::string previous;
+    if (readTextAsset(output, previous) && previous == text)
+        return 0;
+    FILE* file = std::fopen(output, "wb");
+    if (!file || std::fwrite(text.data(), 1, text.size(), file) != text.size())
+    {
+        std::printf("ERROR::UNIFORM_GEN::WRITE_FAILED %s\n", output);
+        if (file)
+            std::fclose(file);
+        return 1;
+    }
+    std::fclose(file);
+    std::printf("%s: %zu uniforms, %zu blocks\n", output, reflection.uniforms.size(), reflection.blocks.size());
+    return 0;
+}
@@ -0,0 +1,56 @@
+#ifndef UNIFORM_ID_H
+#define UNIFORM_ID_H
+
+#include <cstdint>
+#include <cstddef>
+
+// A uniform name as its 64-bit FNV-1a hash, which Shader looks up in the
+// location table it builds at link time:
+//
+//      constexpr UniformId model = "model"_u;      // hashed by the compiler
+//      shader.setMat4(model, transform);
+//
+// "model"_u written at the call site folds to a constant in optimized builds;
+// a constexpr variable makes sure of it in debug builds too.
+
+struct UniformId
+{
+    uint64_t hash;
+
+    constexpr UniformId(const char* name, size_t length)
+        : hash(hashOf(name, length))
+    {
+    }
+
+    // for names only known at run time
+    constexpr explicit UniformId(const char* name)
+        : hash(hashOf(name, length(name)))
+    {
+    }
+
+    constexpr bool operator==(const UniformId& other) const { return hash == other.hash; }
+
+    // 0 marks an empty slot in the location table, no name gets it
+    static constexpr uint64_t hashOf(const char* name, size_t length)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < length; i++)
+            hash = (hash ^ (uint8_t)name[i]) * 1099511628211ull;
+        return hash ? hash : 1;
+    }
+
+    static constexpr size_t length(const char* name)
+    {
+        size_t length = 0;
+        while (name[length])
+            length++;
+        return length;
+    }
+};
+
+constexpr UniformId operator""_u(const char* name, size_t length)
+{
+    return UniformId(name, length);
+}
+
+#endif